@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for a Binary Search Tree whose nodes live in
+ * one array and link to each other by 32 bit indices.
+ *
+ * Based in part on Introduction to Algorithms, 3rd Ed. by Cormen et al.
+ *
+ */
+
+#ifndef _COMPACTTREE_H_
+#define _COMPACTTREE_H_
+
+#include <cstdlib>
+#include <cassert>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * The node of a CompactTree. Links are indices into the tree's node
+ * array; CompactNode<T, U, true>::nil marks a missing node.
+ */
+template <class T, class U, bool ParentLinks>
+struct CompactNode{
+  static const uint32_t nil = 0xffffffffu;
+  T key;
+  U value;
+  uint32_t left;
+  uint32_t right;
+
+  uint32_t parent( ) const{
+    return( nil );
+  }
+
+  void setParent( uint32_t ){ }
+};
+
+template <class T, class U>
+struct CompactNode<T, U, true>{
+  static const uint32_t nil = 0xffffffffu;
+  T key;
+  U value;
+  uint32_t left;
+  uint32_t right;
+  uint32_t _parent;
+
+  uint32_t parent( ) const{
+    return( _parent );
+  }
+
+  void setParent( uint32_t p ){
+    _parent = p;
+  }
+};
+
+template <class T, class U, bool ParentLinks>
+const uint32_t CompactNode<T, U, ParentLinks>::nil;
+
+template <class T, class U>
+const uint32_t CompactNode<T, U, true>::nil;
+
+/**
+ * A templated binary search tree with the same insert, remove and
+ * hasKey operations as Tree, laid out for density.
+ *
+ * Nodes are kept in one array and linked by 32 bit indices instead of
+ * pointers, so a Tree<unsigned, unsigned> node of 32 bytes (40 once
+ * malloc has rounded it) becomes 20 bytes, or 16 when ParentLinks is
+ * false. The tree holds at most 2^32 - 1 keys. Removed nodes go on a
+ * free list and are reused by later inserts.
+ *
+ * Without parent links nothing walks up the tree; the in-order walks
+ * keep a stack of the nodes they descended through instead.
+ */
+template <class T, class U, bool ParentLinks = true>
+class CompactTree{
+public:
+  typedef CompactNode<T, U, ParentLinks> Node;
+  static const uint32_t nil = Node::nil;
+
+ /**
+  * CompactTree constructor.
+  * Initializes an empty tree.
+  */
+  CompactTree( ) : _root( nil ), _free( nil ), _count( 0 ) { }
+
+ /**
+  * Remove all the tree's keys and release the node array.
+  */
+  void clear( ){
+    std::vector<Node>( ).swap( _nodes );
+    _root = nil;
+    _free = nil;
+    _count = 0;
+  }
+
+ /**
+  * Make room for n nodes so that inserting them does not grow the array.
+  * @param n The number of nodes.
+  */
+  void reserve( size_t n ){
+    _nodes.reserve( n );
+  }
+
+ /**
+  * Check if the tree is empty.
+  * @return True if empty, False otherwise.
+  */
+  bool isEmpty( ) const{
+    return( _root == nil );
+  }
+
+ /**
+  * The number of keys in the tree.
+  * @return The number of keys.
+  */
+  size_t size( ) const{
+    return( _count );
+  }
+
+ /**
+  * The bytes held by the node array, including free and spare slots.
+  */
+  size_t memoryBytes( ) const{
+    return( _nodes.capacity( ) * sizeof(Node) );
+  }
+
+ /**
+  * Insert data into the tree.
+  * @param key The key to be inserted into the tree.
+  * @param value The value paired with key.
+  * @return True if inserted, false if key was already present.
+  */
+  bool insert( const T& key, const U& value ){
+    uint32_t x = _root;
+    uint32_t y = nil;
+    bool left = false;
+    while( x != nil ){
+      y = x;
+      const Node& n = _nodes[x];
+      if( key < n.key ){
+        x = n.left;
+        left = true;
+      }else if( n.key < key ){
+        x = n.right;
+        left = false;
+      }else{
+        return( false );
+      }
+    }
+    uint32_t i = allocate( key, value, y );
+    if( y == nil ){
+      _root = i;
+    }else if( left ){
+      _nodes[y].left = i;
+    }else{
+      _nodes[y].right = i;
+    }
+    _count++;
+    return( true );
+  }
+
+ /**
+  * Delete the specified key from the tree.
+  * The parent of every node moved is known from the descent, so this
+  * works the same with or without parent links.
+  * @param key The key to be removed from the tree.
+  * @return True if key exists and was removed, false otherwise.
+  */
+  bool remove( const T& key ){
+    uint32_t z = _root;
+    uint32_t zp = nil;
+    while( z != nil ){
+      const Node& n = _nodes[z];
+      if( key < n.key ){
+        zp = z;
+        z = n.left;
+      }else if( n.key < key ){
+        zp = z;
+        z = n.right;
+      }else{
+        break;
+      }
+    }
+    if( z == nil ){
+      return( false );
+    }
+    uint32_t l = _nodes[z].left;
+    uint32_t r = _nodes[z].right;
+    if( l == nil ){
+      replaceChild( zp, z, r );
+    }else if( r == nil ){
+      replaceChild( zp, z, l );
+    }else{
+      // Splice out the successor y and put it in z's place.
+      uint32_t y = r;
+      uint32_t yp = z;
+      while( _nodes[y].left != nil ){
+        yp = y;
+        y = _nodes[y].left;
+      }
+      if( yp != z ){
+        replaceChild( yp, y, _nodes[y].right );
+        _nodes[y].right = r;
+        _nodes[r].setParent( y );
+      }
+      replaceChild( zp, z, y );
+      _nodes[y].left = l;
+      _nodes[l].setParent( y );
+    }
+    release( z );
+    _count--;
+    return( true );
+  }
+
+ /**
+  * Check if key is in the tree.
+  * @param key The key to search for.
+  * @return True if found, False otherwise.
+  */
+  bool hasKey( const T& key ) const{
+    return( findIndex( key ) != nil );
+  }
+
+ /**
+  * Look up the value paired with key.
+  * @param key The key to search for.
+  * @param value Receives the value if key is found.
+  * @return True if found, False otherwise.
+  */
+  bool find( const T& key, U& value ) const{
+    uint32_t i = findIndex( key );
+    if( i == nil ){
+      return( false );
+    }
+    value = _nodes[i].value;
+    return( true );
+  }
+
+ /**
+  * Replace the contents of the tree with a perfectly balanced tree
+  * built from sorted input in linear time; the nodes are stored in key
+  * order with no spare capacity.
+  * @param keyBegin Random access iterator to the first key; the keys
+  *                 must be in strictly ascending order.
+  * @param keyEnd Iterator one past the last key.
+  * @param valueBegin Random access iterator to the value of the first key.
+  */
+  template <class KeyIter, class ValueIter>
+  void build_from_sorted( KeyIter keyBegin, KeyIter keyEnd, ValueIter valueBegin ){
+    clear( );
+    size_t n = static_cast<size_t>( keyEnd - keyBegin );
+    assert( n < nil );
+    _nodes.reserve( n );
+    for( size_t i = 0; i < n; i++ ){
+      assert( i == 0 || keyBegin[i - 1] < keyBegin[i] );
+      Node node;
+      node.key = keyBegin[i];
+      node.value = valueBegin[i];
+      _nodes.push_back( node );
+    }
+    _root = link( 0, static_cast<uint32_t>( n ), nil );
+    _count = n;
+  }
+
+ /**
+  * Call f( key, value ) for every key in [lo, hi] in ascending order.
+  * @param lo The smallest key to visit.
+  * @param hi The largest key to visit.
+  * @param f The function object to call.
+  */
+  template <class F>
+  void for_each_in_range( const T& lo, const T& hi, F f ) const{
+    // The nodes still to visit, each with its right subtree, nearest
+    // last; only the nodes not less than lo are pushed.
+    std::vector<uint32_t> stack;
+    uint32_t x = _root;
+    for( ;; ){
+      while( x != nil ){
+        if( _nodes[x].key < lo ){
+          x = _nodes[x].right;
+        }else{
+          stack.push_back( x );
+          x = _nodes[x].left;
+        }
+      }
+      if( stack.empty( ) ){
+        return;
+      }
+      x = stack.back( );
+      stack.pop_back( );
+      if( hi < _nodes[x].key ){
+        return;
+      }
+      f( _nodes[x].key, _nodes[x].value );
+      x = _nodes[x].right;
+    }
+  }
+
+ /**
+  * Call f( key, value ) for every key in ascending order.
+  * @param f The function object to call.
+  */
+  template <class F>
+  void for_each( F f ) const{
+    if( ParentLinks ){
+      // Walk the parent links; no extra storage.
+      uint32_t x = _root;
+      while( x != nil && _nodes[x].left != nil ){
+        x = _nodes[x].left;
+      }
+      while( x != nil ){
+        f( _nodes[x].key, _nodes[x].value );
+        x = successor( x );
+      }
+    }else if( _root != nil ){
+      const Node& m = _nodes[minimumIndex( )];
+      const Node& M = _nodes[maximumIndex( )];
+      for_each_in_range( m.key, M.key, f );
+    }
+  }
+
+ /**
+  * Find the smallest key.
+  * @param key Receives the smallest key.
+  * @param value Receives its value.
+  * @return False if the tree is empty.
+  */
+  bool minimum( T& key, U& value ) const{
+    if( _root == nil ){
+      return( false );
+    }
+    const Node& n = _nodes[minimumIndex( )];
+    key = n.key;
+    value = n.value;
+    return( true );
+  }
+
+ /**
+  * Find the largest key.
+  * @param key Receives the largest key.
+  * @param value Receives its value.
+  * @return False if the tree is empty.
+  */
+  bool maximum( T& key, U& value ) const{
+    if( _root == nil ){
+      return( false );
+    }
+    const Node& n = _nodes[maximumIndex( )];
+    key = n.key;
+    value = n.value;
+    return( true );
+  }
+
+private:
+  std::vector<Node> _nodes;
+  uint32_t _root;
+  // Free slots are chained through their left links.
+  uint32_t _free;
+  size_t _count;
+
+  uint32_t findIndex( const T& key ) const{
+    uint32_t x = _root;
+    while( x != nil ){
+      const Node& n = _nodes[x];
+      if( key < n.key ){
+        x = n.left;
+      }else if( n.key < key ){
+        x = n.right;
+      }else{
+        break;
+      }
+    }
+    return( x );
+  }
+
+  uint32_t minimumIndex( ) const{
+    uint32_t x = _root;
+    while( _nodes[x].left != nil ){
+      x = _nodes[x].left;
+    }
+    return( x );
+  }
+
+  uint32_t maximumIndex( ) const{
+    uint32_t x = _root;
+    while( _nodes[x].right != nil ){
+      x = _nodes[x].right;
+    }
+    return( x );
+  }
+
+  /**
+   * The next node in key order by way of the parent links.
+   * @return The successor of x, nil if x holds the largest key.
+   */
+  uint32_t successor( uint32_t x ) const{
+    if( _nodes[x].right != nil ){
+      x = _nodes[x].right;
+      while( _nodes[x].left != nil ){
+        x = _nodes[x].left;
+      }
+      return( x );
+    }
+    uint32_t p = _nodes[x].parent( );
+    while( p != nil && x == _nodes[p].right ){
+      x = p;
+      p = _nodes[p].parent( );
+    }
+    return( p );
+  }
+
+  uint32_t allocate( const T& key, const U& value, uint32_t parent ){
+    uint32_t i;
+    if( _free != nil ){
+      i = _free;
+      _free = _nodes[i].left;
+    }else{
+      assert( _nodes.size( ) < nil );
+      i = static_cast<uint32_t>( _nodes.size( ) );
+      _nodes.push_back( Node( ) );
+    }
+    Node& n = _nodes[i];
+    n.key = key;
+    n.value = value;
+    n.left = nil;
+    n.right = nil;
+    n.setParent( parent );
+    return( i );
+  }
+
+  void release( uint32_t i ){
+    _nodes[i].key = T( );
+    _nodes[i].value = U( );
+    _nodes[i].left = _free;
+    _free = i;
+  }
+
+  /**
+   * Put v where the child u of p was; p is nil if u is the root.
+   */
+  void replaceChild( uint32_t p, uint32_t u, uint32_t v ){
+    if( p == nil ){
+      _root = v;
+    }else if( _nodes[p].left == u ){
+      _nodes[p].left = v;
+    }else{
+      _nodes[p].right = v;
+    }
+    if( v != nil ){
+      _nodes[v].setParent( p );
+    }
+  }
+
+  /**
+   * Link the nodes [lo, hi), which are in key order, into a balanced
+   * subtree.
+   * @return The index of the subtree's root.
+   */
+  uint32_t link( uint32_t lo, uint32_t hi, uint32_t parent ){
+    if( lo >= hi ){
+      return( nil );
+    }
+    uint32_t mid = lo + (hi - lo) / 2;
+    Node& n = _nodes[mid];
+    n.setParent( parent );
+    n.left = link( lo, mid, mid );
+    n.right = link( mid + 1, hi, mid );
+    return( mid );
+  }
+};
+
+template <class T, class U, bool ParentLinks>
+const uint32_t CompactTree<T, U, ParentLinks>::nil;
+
+#endif
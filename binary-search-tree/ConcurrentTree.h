@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for a Binary Search Tree that allows one
+ * writer and any number of lock free readers.
+ *
+ * Based in part on Introduction to Algorithms, 3rd Ed. by Cormen et al.
+ *
+ */
+
+#ifndef _CONCURRENTTREE_H_
+#define _CONCURRENTTREE_H_
+
+#include "EpochReclaimer.h"
+#include <cstdlib>
+#include <cassert>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/**
+ * A templated binary search tree with the same insert, remove and
+ * hasKey operations as Tree that may be used from many threads.
+ *
+ * Writers are serialized by a mutex. Readers never block: they walk
+ * the tree optimistically and check a version counter that the writer
+ * bumps whenever a key moves, retrying a miss that may have raced with
+ * a move. Removed nodes are reclaimed through an EpochReclaimer so a
+ * reader never touches freed memory.
+ */
+template <class T, class U>
+class ConcurrentTree{
+public:
+ /**
+  * ConcurrentTree constructor.
+  * Initializes an empty tree.
+  */
+  ConcurrentTree( ) : _root( NULL ), _version( 0 ), _count( 0 ) { }
+
+ /**
+  * ConcurrentTree deconstructor.
+  * No other thread may be using the tree.
+  */
+  ~ConcurrentTree( ){
+    std::vector<Node*> stack;
+    if( _root.load( ) ){
+      stack.push_back( _root.load( ) );
+    }
+    while( ! stack.empty( ) ){
+      Node* n = stack.back( );
+      stack.pop_back( );
+      if( n->left.load( ) ){
+        stack.push_back( n->left.load( ) );
+      }
+      if( n->right.load( ) ){
+        stack.push_back( n->right.load( ) );
+      }
+      delete n;
+    }
+  }
+
+ /**
+  * The number of keys in the tree.
+  * @return The number of keys; only exact while no writer is running.
+  */
+  size_t size( ) const{
+    return( _count.load( std::memory_order_relaxed ) );
+  }
+
+ /**
+  * Insert data into the tree.
+  * @param key The key to be inserted into the tree.
+  * @param value The value paired with key.
+  * @return True if inserted, false if key was already present.
+  */
+  bool insert( const T& key, const U& value ){
+    std::lock_guard<std::mutex> lock( _writer );
+    Node* x = _root.load( std::memory_order_relaxed );
+    Node* y = NULL;
+    while( x != NULL ){
+      y = x;
+      if( key < x->key ){
+        x = x->left.load( std::memory_order_relaxed );
+      }else if( x->key < key ){
+        x = x->right.load( std::memory_order_relaxed );
+      }else{
+        return( false );
+      }
+    }
+    // The node is complete before the release store publishes it.
+    Node* n = new Node( y, key, value );
+    if( y == NULL ){
+      _root.store( n, std::memory_order_release );
+    }else if( key < y->key ){
+      y->left.store( n, std::memory_order_release );
+    }else{
+      y->right.store( n, std::memory_order_release );
+    }
+    _count.fetch_add( 1, std::memory_order_relaxed );
+    return( true );
+  }
+
+ /**
+  * Delete the specified key from the tree.
+  * @param key The key to be removed from the tree.
+  * @return True if key exists and was removed, false otherwise.
+  */
+  bool remove( const T& key ){
+    std::lock_guard<std::mutex> lock( _writer );
+    Node* n = _root.load( std::memory_order_relaxed );
+    while( n != NULL && (key < n->key || n->key < key) ){
+      n = key < n->key ? n->left.load( std::memory_order_relaxed ) :
+                         n->right.load( std::memory_order_relaxed );
+    }
+    if( n == NULL ){
+      return( false );
+    }
+    Node* l = n->left.load( std::memory_order_relaxed );
+    Node* r = n->right.load( std::memory_order_relaxed );
+    if( l == NULL ){
+      transplant( n, r );
+    }else if( r == NULL ){
+      transplant( n, l );
+    }else{
+      // Splicing out a node with one child keeps every other key on the
+      // search path readers are following. Moving the successor up does
+      // not, so the readers are told through the version.
+      _version.fetch_add( 1, std::memory_order_relaxed );
+      std::atomic_thread_fence( std::memory_order_release );
+      Node* y = r;
+      while( y->left.load( std::memory_order_relaxed ) ){
+        y = y->left.load( std::memory_order_relaxed );
+      }
+      if( y->parent != n ){
+        transplant( y, y->right.load( std::memory_order_relaxed ) );
+        y->right.store( r, std::memory_order_release );
+        r->parent = y;
+      }
+      transplant( n, y );
+      y->left.store( l, std::memory_order_release );
+      l->parent = y;
+      _version.fetch_add( 1, std::memory_order_release );
+    }
+    _count.fetch_sub( 1, std::memory_order_relaxed );
+    _reclaimer.retire( n );
+    return( true );
+  }
+
+ /**
+  * Check if key is in the tree. Never blocks.
+  * @param key The key to search for.
+  * @return True if found, False otherwise.
+  */
+  bool hasKey( const T& key ){
+    U ignored;
+    return( find( key, ignored ) );
+  }
+
+ /**
+  * Look up the value paired with key. Never blocks.
+  * @param key The key to search for.
+  * @param value Receives the value if key is found.
+  * @return True if found, False otherwise.
+  */
+  bool find( const T& key, U& value ){
+    EpochReclaimer::Guard guard( _reclaimer );
+    for( ;; ){
+      unsigned long long v = _version.load( std::memory_order_acquire );
+      Node* n = _root.load( std::memory_order_acquire );
+      while( n != NULL ){
+        if( key < n->key ){
+          n = n->left.load( std::memory_order_acquire );
+        }else if( n->key < key ){
+          n = n->right.load( std::memory_order_acquire );
+        }else{
+          // A node is never reused, so a hit is always genuine.
+          value = n->value;
+          return( true );
+        }
+      }
+      std::atomic_thread_fence( std::memory_order_acquire );
+      if( (v & 1) == 0 && _version.load( std::memory_order_relaxed ) == v ){
+        return( false );
+      }
+    }
+  }
+
+private:
+  struct Node{
+    Node( Node* p, const T& k, const U& v ) :
+    key( k ), value( v ), left( NULL ), right( NULL ), parent( p ) { }
+    const T key;
+    const U value;
+    std::atomic<Node*> left;
+    std::atomic<Node*> right;
+    // Only the writer follows parent pointers.
+    Node* parent;
+  };
+
+  void transplant( Node* u, Node* v ){
+    Node* p = u->parent;
+    if( p == NULL ){
+      _root.store( v, std::memory_order_release );
+    }else if( u == p->left.load( std::memory_order_relaxed ) ){
+      p->left.store( v, std::memory_order_release );
+    }else{
+      p->right.store( v, std::memory_order_release );
+    }
+    if( v != NULL ){
+      v->parent = p;
+    }
+  }
+
+  std::atomic<Node*> _root;
+  std::atomic<unsigned long long> _version;
+  std::atomic<size_t> _count;
+  std::mutex _writer;
+  EpochReclaimer _reclaimer;
+
+  ConcurrentTree( const ConcurrentTree& );
+  ConcurrentTree& operator =( const ConcurrentTree& );
+};
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for an epoch based memory reclaimer used by
+ * the concurrent containers.
+ *
+ * Based in part on "Practical lock-freedom" by Keir Fraser.
+ *
+ */
+
+#ifndef _EPOCHRECLAIMER_H_
+#define _EPOCHRECLAIMER_H_
+
+#include <cstdlib>
+#include <cassert>
+#include <atomic>
+#include <vector>
+
+/**
+ * The most threads that may use reclaimers at the same time.
+ */
+#ifndef EPOCH_MAX_THREADS
+#define EPOCH_MAX_THREADS 256
+#endif
+
+/**
+ * Hands every live thread a small, unique index into the per thread
+ * arrays of the reclaimers. The index is given back when the thread
+ * exits so it can be reused.
+ */
+class ThreadIndex{
+public:
+ /**
+  * The calling thread's index.
+  * @return A number in [0, EPOCH_MAX_THREADS).
+  */
+  static unsigned get( ){
+    static thread_local ThreadIndex self;
+    return( self._index );
+  }
+
+private:
+  ThreadIndex( ){
+    _index = EPOCH_MAX_THREADS;
+    for( unsigned i = 0; i < EPOCH_MAX_THREADS; i++ ){
+      bool expected = false;
+      if( taken( )[i].compare_exchange_strong( expected, true ) ){
+        _index = i;
+        break;
+      }
+    }
+    assert( _index < EPOCH_MAX_THREADS );
+    if( _index >= EPOCH_MAX_THREADS ){
+      abort( );
+    }
+  }
+
+  ~ThreadIndex( ){
+    taken( )[_index].store( false );
+  }
+
+  static std::atomic<bool>* taken( ){
+    static std::atomic<bool> t[EPOCH_MAX_THREADS];
+    return( t );
+  }
+
+  unsigned _index;
+};
+
+/**
+ * An epoch based reclaimer.
+ * Readers bracket every access to shared nodes with a Guard. A node
+ * that has been unlinked is handed to retire( ) and is only deleted
+ * once every thread that might still hold a pointer to it has left its
+ * guarded section.
+ */
+class EpochReclaimer{
+public:
+ /**
+  * Marks the calling thread as active for its lifetime.
+  * Guards may nest.
+  */
+  class Guard{
+  public:
+    explicit Guard( EpochReclaimer& r ) : _r( r ){
+      _r.enter( );
+    }
+    ~Guard( ){
+      _r.leave( );
+    }
+  private:
+    Guard( const Guard& );
+    Guard& operator =( const Guard& );
+    EpochReclaimer& _r;
+  };
+
+ /**
+  * EpochReclaimer constructor.
+  */
+  EpochReclaimer( ) : _epoch( 1 ) { }
+
+ /**
+  * EpochReclaimer deconstructor.
+  * Deletes everything still waiting; no thread may be in a guarded
+  * section any more.
+  */
+  ~EpochReclaimer( ){
+    for( unsigned i = 0; i < EPOCH_MAX_THREADS; i++ ){
+      std::vector<Retired>& l = _slots[i].retired;
+      for( size_t j = 0; j < l.size( ); j++ ){
+        l[j].deleter( l[j].p );
+      }
+    }
+  }
+
+ /**
+  * Hand over an unlinked object; it is deleted when no guarded section
+  * that could have seen it is still running.
+  * @param p The object.
+  * @param deleter The function that deletes p.
+  */
+  void retire( void* p, void (*deleter)( void* ) ){
+    Slot& s = _slots[ThreadIndex::get( )];
+    Retired r = { p, deleter, _epoch.load( ) };
+    s.retired.push_back( r );
+    if( s.retired.size( ) % 64 == 0 ){
+      collect( s );
+    }
+  }
+
+ /**
+  * Typed convenience wrapper for retire( p, deleter ).
+  * @param p An object allocated with new.
+  */
+  template <class N>
+  void retire( N* p ){
+    retire( p, &deleteAs<N> );
+  }
+
+private:
+  struct Retired{
+    void* p;
+    void (*deleter)( void* );
+    unsigned long long epoch;
+  };
+
+  /**
+   * Per thread state, padded to a cache line so the readers do not
+   * share lines with each other.
+   */
+  struct Slot{
+    Slot( ) : active( 0 ), depth( 0 ) { }
+    std::atomic<unsigned long long> active;
+    unsigned depth;
+    std::vector<Retired> retired;
+    char pad[64];
+  };
+
+  template <class N>
+  static void deleteAs( void* p ){
+    delete static_cast<N*>( p );
+  }
+
+  void enter( ){
+    Slot& s = _slots[ThreadIndex::get( )];
+    if( s.depth++ == 0 ){
+      s.active.store( _epoch.load( ) );
+    }
+  }
+
+  void leave( ){
+    Slot& s = _slots[ThreadIndex::get( )];
+    assert( s.depth > 0 );
+    if( --s.depth == 0 ){
+      s.active.store( 0 );
+    }
+  }
+
+  /**
+   * Advance the epoch if every active thread has seen the current one,
+   * then delete what was retired two epochs ago.
+   */
+  void collect( Slot& mine ){
+    unsigned long long e = _epoch.load( );
+    bool advance = true;
+    for( unsigned i = 0; i < EPOCH_MAX_THREADS && advance; i++ ){
+      unsigned long long a = _slots[i].active.load( );
+      if( a != 0 && a != e ){
+        advance = false;
+      }
+    }
+    if( advance ){
+      _epoch.compare_exchange_strong( e, e + 1 );
+    }
+    unsigned long long safe = _epoch.load( );
+    size_t kept = 0;
+    for( size_t j = 0; j < mine.retired.size( ); j++ ){
+      if( mine.retired[j].epoch + 2 <= safe ){
+        mine.retired[j].deleter( mine.retired[j].p );
+      }else{
+        mine.retired[kept++] = mine.retired[j];
+      }
+    }
+    mine.retired.resize( kept );
+  }
+
+  std::atomic<unsigned long long> _epoch;
+  Slot _slots[EPOCH_MAX_THREADS];
+};
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for a read-only snapshot of a Binary Search
+ * Tree stored in Eytzinger (breadth first) order.
+ *
+ * Based in part on "Array Layouts for Comparison-Based Searching" by
+ * Khuong and Morin.
+ *
+ */
+
+#ifndef _FROZENTREE_H_
+#define _FROZENTREE_H_
+
+#include <cstdlib>
+#include <cassert>
+#include <vector>
+#include <functional>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FROZENTREE_PREFETCH( addr ) __builtin_prefetch( (addr) )
+#define FROZENTREE_FFS( x ) __builtin_ffsll( (x) )
+#else
+#define FROZENTREE_PREFETCH( addr )
+static inline int FROZENTREE_FFS( unsigned long long x ){
+  int i = 1;
+  if( x == 0 ){
+    return( 0 );
+  }
+  while( (x & 1) == 0 ){
+    x >>= 1;
+    i++;
+  }
+  return( i );
+}
+#endif
+
+/**
+ * An immutable, templated search structure built from the sorted
+ * contents of a Tree.
+ * Slot 1 holds the root, slot k has its children in slots 2k and 2k+1.
+ * Slot 0 is unused and stands for "no such key".
+ * Keys are ordered by Compare, as in the Tree they came from.
+ */
+template <class T, class U, class Compare = std::less<T> >
+class FrozenTree{
+public:
+ /**
+  * FrozenTree constructor.
+  * Initializes an empty snapshot.
+  */
+  FrozenTree( ) : _keys( 1 ), _values( 1 ), _n( 0 ), _levels( 0 ), _compare( ) { }
+
+ /**
+  * FrozenTree constructor.
+  * @param keys The keys of the snapshot in strictly ascending order.
+  * @param values The values paired with keys.
+  * @param n The number of keys.
+  * @param compare The function object that orders the keys.
+  */
+  FrozenTree( const T* keys, const U* values, size_t n,
+              const Compare& compare = Compare( ) ) :
+  _keys( n + 1 ), _values( n + 1 ), _n( n ), _levels( 0 ), _compare( compare ){
+    size_t i = 0;
+    if( n > 0 ){
+      layout( keys, values, i, 1 );
+    }
+    assert( i == n );
+    while( (size_t(2) << _levels) - 1 <= n ){
+      _levels++;
+    }
+  }
+
+ /**
+  * The number of keys in the snapshot.
+  * @return The number of keys.
+  */
+  size_t size( ) const{
+    return( _n );
+  }
+
+ /**
+  * Check if the snapshot is empty.
+  * @return True if empty, False otherwise.
+  */
+  bool isEmpty( ) const{
+    return( _n == 0 );
+  }
+
+ /**
+  * Find the first key that is not less than key.
+  * The descent has no data dependent branches; on every step the cache
+  * line holding the descendants a few levels down is prefetched: four
+  * levels down for keys of up to 4 bytes, three for up to 8 bytes and
+  * two for larger keys (see kPrefetchStride).
+  * @param key The key to search for.
+  * @return The slot of the key found, 0 if every key is less than key.
+  */
+  size_t lower_bound( const T& key ) const{
+    const T* k = &_keys[0];
+    size_t i = 1;
+    while( i <= _n ){
+      FROZENTREE_PREFETCH( k + prefetchSlot( i ) );
+      i = 2 * i + _compare( k[i], key );
+    }
+    return( i >> FROZENTREE_FFS( ~i ) );
+  }
+
+ /**
+  * Find key in the snapshot.
+  * @param key The key to search for.
+  * @return The slot of the key, 0 if key is not present.
+  */
+  size_t find( const T& key ) const{
+    size_t i = lower_bound( key );
+    if( i != 0 && _compare( key, _keys[i] ) ){
+      i = 0;
+    }
+    return( i );
+  }
+
+ /**
+  * Check if key is in the snapshot.
+  * @param key The key to search for.
+  * @return True if found, False otherwise.
+  */
+  bool hasKey( const T& key ) const{
+    return( find( key ) != 0 );
+  }
+
+ /**
+  * Look up a batch of independent keys.
+  * The lookups are advanced one level at a time in groups so the
+  * memory accesses of a group overlap instead of serializing.
+  * @param keys The keys to search for.
+  * @param count The number of keys.
+  * @param slots Receives the slot of each key, 0 if not present.
+  * @return The number of keys found.
+  */
+  size_t find_many( const T* keys, size_t count, size_t* slots ) const{
+    const size_t kGroup = 16;
+    const T* k = &_keys[0];
+    size_t found = 0;
+    for( size_t base = 0; base < count; base += kGroup ){
+      size_t m = count - base < kGroup ? count - base : kGroup;
+      const T* x = keys + base;
+      size_t* s = slots + base;
+      for( size_t j = 0; j < m; j++ ){
+        s[j] = 1;
+      }
+      // Every level above the last one is full, so all the searches
+      // take the same number of steps.
+      for( size_t level = 0; level < _levels; level++ ){
+        for( size_t j = 0; j < m; j++ ){
+          size_t i = s[j];
+          FROZENTREE_PREFETCH( k + prefetchSlot( i ) );
+          s[j] = 2 * i + _compare( k[i], x[j] );
+        }
+      }
+      for( size_t j = 0; j < m; j++ ){
+        size_t i = s[j];
+        if( i <= _n ){
+          i = 2 * i + _compare( k[i], x[j] );
+        }
+        i >>= FROZENTREE_FFS( ~i );
+        if( i != 0 && _compare( x[j], k[i] ) ){
+          i = 0;
+        }
+        found += (i != 0);
+        s[j] = i;
+      }
+    }
+    return( found );
+  }
+
+ /**
+  * Return the key stored in a slot.
+  * @param slot A slot returned by find or lower_bound; must not be 0.
+  * @return The key held in slot.
+  */
+  const T& keyAt( size_t slot ) const{
+    assert( slot > 0 && slot <= _n );
+    return( _keys[slot] );
+  }
+
+ /**
+  * Return the value stored in a slot.
+  * @param slot A slot returned by find or lower_bound; must not be 0.
+  * @return The value held in slot.
+  */
+  const U& valueAt( size_t slot ) const{
+    assert( slot > 0 && slot <= _n );
+    return( _values[slot] );
+  }
+
+private:
+ /**
+  * Keys in Eytzinger order; slot 0 is unused.
+  */
+  std::vector<T> _keys;
+
+ /**
+  * Values in Eytzinger order; slot 0 is unused.
+  */
+  std::vector<U> _values;
+
+ /**
+  * The number of keys.
+  */
+  size_t _n;
+
+ /**
+  * The number of completely filled levels.
+  */
+  size_t _levels;
+
+ /**
+  * The function object that orders the keys.
+  */
+  Compare _compare;
+
+  /**
+   * The slot of the leftmost descendant of slot i that shares a cache
+   * line with its siblings, clamped so the address stays in bounds.
+   */
+  size_t prefetchSlot( size_t i ) const{
+    size_t p = i * kPrefetchStride;
+    return( p <= _n ? p : 0 );
+  }
+
+  /**
+   * The descendants of slot i that many levels down start at slot
+   * i * kPrefetchStride: 16, 8 or 4 of them, as many keys as fit in a
+   * 64 byte line when T is 4 or 8 bytes.
+   */
+  static const size_t kPrefetchStride = sizeof(T) <= 4 ? 16 :
+                                        sizeof(T) <= 8 ? 8 : 4;
+
+  /**
+   * Copy the sorted keys into breadth first order with an in-order walk
+   * of the implicit tree.
+   */
+  void layout( const T* keys, const U* values, size_t& i, size_t k ){
+    if( k <= _n ){
+      layout( keys, values, i, 2 * k );
+      _keys[k] = keys[i];
+      _values[k] = values[i];
+      i++;
+      layout( keys, values, i, 2 * k + 1 );
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,443 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for an interval tree, a balanced Binary Search
+ * Tree of closed intervals that finds the intervals overlapping a query.
+ *
+ * Based in part on Introduction to Algorithms, 3rd Ed. by Cormen et al.
+ * (chapters 13 and 14.3).
+ *
+ */
+
+#ifndef _INTERVALTREE_H_
+#define _INTERVALTREE_H_
+
+#include <cstdlib>
+#include <cassert>
+#include <vector>
+
+/**
+ * A templated interval tree.
+ * Each entry is a closed interval [lo, hi] with a value. The entries
+ * are kept in a red-black tree ordered by lo, then hi, and every node
+ * also records the largest hi in its subtree. Insert, remove and the
+ * rotations that keep the tree balanced maintain that maximum along
+ * the O(log n) nodes they touch.
+ *
+ * A query skips every subtree whose largest hi is below the query and,
+ * since the tree is ordered by lo, everything right of a node whose lo
+ * is past it. Reporting k intervals then costs O(log n) for the first
+ * and at most O(log n) more for each of the others, and close to O(1)
+ * each when the overlapping intervals are near each other in the tree.
+ * Several entries may hold the same interval.
+ */
+template <class T, class U>
+class IntervalTree{
+public:
+ /**
+  * IntervalTree constructor.
+  * Initializes an empty tree.
+  */
+  IntervalTree( ) : _nil( new Node( ) ), _count( 0 ){
+    _nil->red = false;
+    _nil->left = _nil->right = _nil->parent = _nil;
+    _root = _nil;
+  }
+
+ /**
+  * IntervalTree deconstructor.
+  * Removes all the tree's nodes.
+  */
+  ~IntervalTree( ){
+    clear( );
+    delete _nil;
+  }
+
+ /**
+  * Remove all the tree's intervals.
+  */
+  void clear( ){
+    Node* n = _root;
+    while( n != _nil ){
+      if( n->left != _nil ){
+        n = n->left;
+      }else if( n->right != _nil ){
+        n = n->right;
+      }else{
+        Node* p = n->parent;
+        if( p != _nil && p->left == n ){
+          p->left = _nil;
+        }else if( p != _nil ){
+          p->right = _nil;
+        }
+        delete n;
+        n = p;
+      }
+    }
+    _root = _nil;
+    _count = 0;
+  }
+
+ /**
+  * Check if the tree is empty.
+  * @return True if empty, False otherwise.
+  */
+  bool isEmpty( ) const{
+    return( _root == _nil );
+  }
+
+ /**
+  * The number of intervals in the tree.
+  * @return The number of intervals.
+  */
+  size_t size( ) const{
+    return( _count );
+  }
+
+ /**
+  * Insert the interval [lo, hi].
+  * @param lo The start of the interval.
+  * @param hi The end of the interval, not less than lo.
+  * @param value The value paired with the interval.
+  */
+  void insert( const T& lo, const T& hi, const U& value ){
+    assert( !(hi < lo) );
+    Node* z = new Node( );
+    z->lo = lo;
+    z->hi = hi;
+    z->maxHi = hi;
+    z->value = value;
+    z->left = _nil;
+    z->right = _nil;
+    z->red = true;
+    Node* y = _nil;
+    Node* x = _root;
+    while( x != _nil ){
+      y = x;
+      if( x->maxHi < hi ){
+        x->maxHi = hi;
+      }
+      x = before( z, x ) ? x->left : x->right;
+    }
+    z->parent = y;
+    if( y == _nil ){
+      _root = z;
+    }else if( before( z, y ) ){
+      y->left = z;
+    }else{
+      y->right = z;
+    }
+    insertFixup( z );
+    _count++;
+  }
+
+ /**
+  * Delete one entry holding the interval [lo, hi].
+  * @param lo The start of the interval.
+  * @param hi The end of the interval.
+  * @return True if the interval was found and removed, false otherwise.
+  */
+  bool remove( const T& lo, const T& hi ){
+    Node* z = _root;
+    while( z != _nil ){
+      if( lo < z->lo || (!(z->lo < lo) && hi < z->hi) ){
+        z = z->left;
+      }else if( z->lo < lo || z->hi < hi ){
+        z = z->right;
+      }else{
+        break;
+      }
+    }
+    if( z == _nil ){
+      return( false );
+    }
+    deleteNode( z );
+    _count--;
+    return( true );
+  }
+
+ /**
+  * Call f( lo, hi, value ) for every interval that overlaps [lo, hi],
+  * that is every [l, h] with l <= hi and lo <= h, in ascending order.
+  * @param lo The start of the query.
+  * @param hi The end of the query.
+  * @param f The function object to call.
+  * @return The number of intervals reported.
+  */
+  template <class F>
+  size_t overlap( const T& lo, const T& hi, F f ) const{
+    size_t k = 0;
+    // Nodes whose left subtree has been searched, nearest last.
+    std::vector<const Node*> stack;
+    const Node* x = _root;
+    for( ;; ){
+      while( x != _nil && !(x->maxHi < lo) ){
+        stack.push_back( x );
+        x = x->left;
+      }
+      if( stack.empty( ) ){
+        return( k );
+      }
+      x = stack.back( );
+      stack.pop_back( );
+      if( hi < x->lo ){
+        // x and everything after it start past the query.
+        return( k );
+      }
+      if( !(x->hi < lo) ){
+        f( x->lo, x->hi, x->value );
+        k++;
+      }
+      x = x->right;
+    }
+  }
+
+ /**
+  * Call f( lo, hi, value ) for every interval that contains point.
+  * @param point The point to stab with.
+  * @param f The function object to call.
+  * @return The number of intervals reported.
+  */
+  template <class F>
+  size_t stab( const T& point, F f ) const{
+    return( overlap( point, point, f ) );
+  }
+
+private:
+  struct Node{
+    T lo;
+    T hi;
+    // The largest hi in the subtree rooted here.
+    T maxHi;
+    U value;
+    Node* left;
+    Node* right;
+    Node* parent;
+    bool red;
+  };
+
+ /**
+  * The sentinel standing for every missing child and the root's
+  * parent, as in Cormen et al.; it is always black.
+  */
+  Node* _nil;
+  Node* _root;
+  size_t _count;
+
+  /**
+   * True if a comes before b in the order of lo, then hi.
+   */
+  static bool before( const Node* a, const Node* b ){
+    return( a->lo < b->lo || (!(b->lo < a->lo) && a->hi < b->hi) );
+  }
+
+  /**
+   * Recompute n's maxHi from its interval and its children.
+   */
+  void update( Node* n ){
+    T m = n->hi;
+    if( n->left != _nil && m < n->left->maxHi ){
+      m = n->left->maxHi;
+    }
+    if( n->right != _nil && m < n->right->maxHi ){
+      m = n->right->maxHi;
+    }
+    n->maxHi = m;
+  }
+
+  void leftRotate( Node* x ){
+    Node* y = x->right;
+    x->right = y->left;
+    if( y->left != _nil ){
+      y->left->parent = x;
+    }
+    y->parent = x->parent;
+    if( x->parent == _nil ){
+      _root = y;
+    }else if( x == x->parent->left ){
+      x->parent->left = y;
+    }else{
+      x->parent->right = y;
+    }
+    y->left = x;
+    x->parent = y;
+    // y now covers what x covered.
+    y->maxHi = x->maxHi;
+    update( x );
+  }
+
+  void rightRotate( Node* x ){
+    Node* y = x->left;
+    x->left = y->right;
+    if( y->right != _nil ){
+      y->right->parent = x;
+    }
+    y->parent = x->parent;
+    if( x->parent == _nil ){
+      _root = y;
+    }else if( x == x->parent->right ){
+      x->parent->right = y;
+    }else{
+      x->parent->left = y;
+    }
+    y->right = x;
+    x->parent = y;
+    y->maxHi = x->maxHi;
+    update( x );
+  }
+
+  void insertFixup( Node* z ){
+    while( z->parent->red ){
+      Node* g = z->parent->parent;
+      if( z->parent == g->left ){
+        Node* y = g->right;
+        if( y->red ){
+          z->parent->red = false;
+          y->red = false;
+          g->red = true;
+          z = g;
+        }else{
+          if( z == z->parent->right ){
+            z = z->parent;
+            leftRotate( z );
+          }
+          z->parent->red = false;
+          g->red = true;
+          rightRotate( g );
+        }
+      }else{
+        Node* y = g->left;
+        if( y->red ){
+          z->parent->red = false;
+          y->red = false;
+          g->red = true;
+          z = g;
+        }else{
+          if( z == z->parent->left ){
+            z = z->parent;
+            rightRotate( z );
+          }
+          z->parent->red = false;
+          g->red = true;
+          leftRotate( g );
+        }
+      }
+    }
+    _root->red = false;
+  }
+
+  /**
+   * Put the subtree v where the subtree u was.
+   */
+  void transplant( Node* u, Node* v ){
+    if( u->parent == _nil ){
+      _root = v;
+    }else if( u == u->parent->left ){
+      u->parent->left = v;
+    }else{
+      u->parent->right = v;
+    }
+    v->parent = u->parent;
+  }
+
+  void deleteNode( Node* z ){
+    Node* y = z;
+    bool yWasRed = y->red;
+    Node* x;
+    if( z->left == _nil ){
+      x = z->right;
+      transplant( z, z->right );
+    }else if( z->right == _nil ){
+      x = z->left;
+      transplant( z, z->left );
+    }else{
+      y = z->right;
+      while( y->left != _nil ){
+        y = y->left;
+      }
+      yWasRed = y->red;
+      x = y->right;
+      if( y->parent == z ){
+        x->parent = y;
+      }else{
+        transplant( y, y->right );
+        y->right = z->right;
+        y->right->parent = y;
+      }
+      transplant( z, y );
+      y->left = z->left;
+      y->left->parent = y;
+      y->red = z->red;
+    }
+    // Every node whose subtree lost z, or had y moved out of it, is on
+    // the path from x's parent to the root.
+    for( Node* p = x->parent; p != _nil; p = p->parent ){
+      update( p );
+    }
+    if( ! yWasRed ){
+      deleteFixup( x );
+    }
+    delete z;
+  }
+
+  void deleteFixup( Node* x ){
+    while( x != _root && ! x->red ){
+      if( x == x->parent->left ){
+        Node* w = x->parent->right;
+        if( w->red ){
+          w->red = false;
+          x->parent->red = true;
+          leftRotate( x->parent );
+          w = x->parent->right;
+        }
+        if( ! w->left->red && ! w->right->red ){
+          w->red = true;
+          x = x->parent;
+        }else{
+          if( ! w->right->red ){
+            w->left->red = false;
+            w->red = true;
+            rightRotate( w );
+            w = x->parent->right;
+          }
+          w->red = x->parent->red;
+          x->parent->red = false;
+          w->right->red = false;
+          leftRotate( x->parent );
+          x = _root;
+        }
+      }else{
+        Node* w = x->parent->left;
+        if( w->red ){
+          w->red = false;
+          x->parent->red = true;
+          rightRotate( x->parent );
+          w = x->parent->left;
+        }
+        if( ! w->right->red && ! w->left->red ){
+          w->red = true;
+          x = x->parent;
+        }else{
+          if( ! w->left->red ){
+            w->right->red = false;
+            w->red = true;
+            leftRotate( w );
+            w = x->parent->left;
+          }
+          w->red = x->parent->red;
+          x->parent->red = false;
+          w->left->red = false;
+          rightRotate( x->parent );
+          x = _root;
+        }
+      }
+    }
+    x->red = false;
+  }
+
+  IntervalTree( const IntervalTree& );
+  IntervalTree& operator =( const IntervalTree& );
+};
+
+#endif
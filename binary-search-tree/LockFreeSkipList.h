@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for a lock free skip list with the same
+ * interface as the Binary Search Tree class.
+ *
+ * Based in part on The Art of Multiprocessor Programming by Herlihy and
+ * Shavit, chapter 14.
+ *
+ */
+
+#ifndef _LOCKFREESKIPLIST_H_
+#define _LOCKFREESKIPLIST_H_
+
+#include "EpochReclaimer.h"
+#include <cstdlib>
+#include <cassert>
+#include <new>
+#include <atomic>
+#include <stdint.h>
+
+/**
+ * A templated, lock free ordered map.
+ * Any number of threads may insert, remove and look up keys at once.
+ * A key is removed by marking the links out of its node, top level
+ * first; searches unlink marked nodes as they pass them. Unlinked nodes
+ * are reclaimed through an EpochReclaimer.
+ * find and hasKey neither change nor unlink nodes, but they are not
+ * free of writes: each call enters and leaves an epoch, a store to the
+ * calling thread's slot in the reclaimer on the way in and out, and a
+ * thread's first call claims a slot with a compare and swap.
+ */
+template <class T, class U>
+class LockFreeSkipList{
+public:
+ /**
+  * LockFreeSkipList constructor.
+  * Initializes an empty list.
+  */
+  LockFreeSkipList( ) : _head( newNode( kMaxLevel ) ), _count( 0 ) { }
+
+ /**
+  * LockFreeSkipList deconstructor.
+  * No other thread may be using the list.
+  */
+  ~LockFreeSkipList( ){
+    Node* n = ptr( _head->next[0].load( ) );
+    while( n != NULL ){
+      Node* next = ptr( n->next[0].load( ) );
+      destroyNode( n );
+      n = next;
+    }
+    ::operator delete( _head );
+  }
+
+ /**
+  * The number of keys in the list.
+  * @return The number of keys; only exact while no writer is running.
+  */
+  size_t size( ) const{
+    return( _count.load( std::memory_order_relaxed ) );
+  }
+
+ /**
+  * Check if the list is empty.
+  * @return True if empty, False otherwise.
+  */
+  bool isEmpty( ){
+    EpochReclaimer::Guard guard( _reclaimer );
+    return( first( ) == NULL );
+  }
+
+ /**
+  * Insert data into the list.
+  * @param key The key to be inserted into the list.
+  * @param value The value paired with key.
+  * @return True if inserted, false if key was already present.
+  */
+  bool insert( const T& key, const U& value ){
+    EpochReclaimer::Guard guard( _reclaimer );
+    Node* preds[kMaxLevel];
+    Node* succs[kMaxLevel];
+    int top = randomLevel( );
+    Node* n = NULL;
+    for( ;; ){
+      if( find( key, preds, succs ) ){
+        return( false );
+      }
+      n = newNode( top, key, value );
+      for( int level = 0; level < top; level++ ){
+        n->next[level].store( link( succs[level] ), std::memory_order_relaxed );
+      }
+      uintptr_t expected = link( succs[0] );
+      if( preds[0]->next[0].compare_exchange_strong( expected, link( n ) ) ){
+        break;
+      }
+      destroyNode( n );
+    }
+    _count.fetch_add( 1, std::memory_order_relaxed );
+    // The key is in; the upper levels only speed up searches. Stop as
+    // soon as a remover has started marking the node.
+    for( int level = 1; level < top; level++ ){
+      for( ;; ){
+        uintptr_t mine = n->next[level].load( );
+        if( marked( mine ) ){
+          goto linked;
+        }
+        if( mine != link( succs[level] ) &&
+            ! n->next[level].compare_exchange_strong( mine, link( succs[level] ) ) ){
+          goto linked;
+        }
+        uintptr_t expected = link( succs[level] );
+        if( preds[level]->next[level].compare_exchange_strong( expected, link( n ) ) ){
+          break;
+        }
+        find( key, preds, succs );
+      }
+    }
+  linked:
+    if( marked( n->next[0].load( ) ) ){
+      // Removed while the upper levels were being linked; make sure
+      // none of them is left behind.
+      find( key, preds, succs );
+    }
+    release( n );
+    return( true );
+  }
+
+ /**
+  * Delete the specified key from the list.
+  * @param key The key to be removed from the list.
+  * @return True if key exists and was removed by this call, false otherwise.
+  */
+  bool remove( const T& key ){
+    EpochReclaimer::Guard guard( _reclaimer );
+    Node* preds[kMaxLevel];
+    Node* succs[kMaxLevel];
+    if( ! find( key, preds, succs ) ){
+      return( false );
+    }
+    Node* n = succs[0];
+    for( int level = n->top - 1; level > 0; level-- ){
+      uintptr_t next = n->next[level].load( );
+      while( ! marked( next ) ){
+        n->next[level].compare_exchange_weak( next, next | 1 );
+      }
+    }
+    uintptr_t next = n->next[0].load( );
+    for( ;; ){
+      if( marked( next ) ){
+        // Another thread removed it first.
+        return( false );
+      }
+      if( n->next[0].compare_exchange_weak( next, next | 1 ) ){
+        break;
+      }
+    }
+    _count.fetch_sub( 1, std::memory_order_relaxed );
+    find( key, preds, succs );
+    release( n );
+    return( true );
+  }
+
+ /**
+  * Check if key is in the list. Leaves the nodes untouched; see the
+  * class comment for what a lookup does write.
+  * @param key The key to search for.
+  * @return True if found, False otherwise.
+  */
+  bool hasKey( const T& key ){
+    U ignored;
+    return( find( key, ignored ) );
+  }
+
+ /**
+  * Look up the value paired with key.
+  * @param key The key to search for.
+  * @param value Receives the value if key is found.
+  * @return True if found, False otherwise.
+  */
+  bool find( const T& key, U& value ){
+    EpochReclaimer::Guard guard( _reclaimer );
+    Node* pred = _head;
+    Node* curr = NULL;
+    for( int level = kMaxLevel - 1; level >= 0; level-- ){
+      curr = ptr( pred->next[level].load( ) );
+      while( curr != NULL ){
+        uintptr_t succ = curr->next[level].load( );
+        while( curr != NULL && marked( succ ) ){
+          curr = ptr( succ );
+          succ = curr ? curr->next[level].load( ) : 0;
+        }
+        if( curr != NULL && curr->key < key ){
+          pred = curr;
+          curr = ptr( succ );
+        }else{
+          break;
+        }
+      }
+    }
+    if( curr != NULL && !(key < curr->key) ){
+      value = curr->value;
+      return( true );
+    }
+    return( false );
+  }
+
+ /**
+  * Find the smallest key.
+  * @param key Receives the smallest key.
+  * @param value Receives its value.
+  * @return False if the list is empty.
+  */
+  bool minimum( T& key, U& value ){
+    EpochReclaimer::Guard guard( _reclaimer );
+    Node* n = first( );
+    if( n == NULL ){
+      return( false );
+    }
+    key = n->key;
+    value = n->value;
+    return( true );
+  }
+
+ /**
+  * Find the largest key.
+  * @param key Receives the largest key.
+  * @param value Receives its value.
+  * @return False if the list is empty.
+  */
+  bool maximum( T& key, U& value ){
+    EpochReclaimer::Guard guard( _reclaimer );
+    Node* pred = _head;
+    for( int level = kMaxLevel - 1; level >= 0; level-- ){
+      Node* curr = ptr( pred->next[level].load( ) );
+      while( curr != NULL ){
+        if( ! marked( curr->next[0].load( ) ) ){
+          pred = curr;
+        }
+        curr = ptr( curr->next[level].load( ) );
+      }
+    }
+    if( pred == _head ){
+      return( false );
+    }
+    key = pred->key;
+    value = pred->value;
+    return( true );
+  }
+
+ /**
+  * Call f( key, value ) for every key in ascending order.
+  * Keys inserted or removed during the walk may or may not be seen.
+  * @param f The function object to call.
+  */
+  template <class F>
+  void for_each( F f ){
+    EpochReclaimer::Guard guard( _reclaimer );
+    Node* n = ptr( _head->next[0].load( ) );
+    while( n != NULL ){
+      uintptr_t next = n->next[0].load( );
+      if( ! marked( next ) ){
+        f( n->key, n->value );
+      }
+      n = ptr( next );
+    }
+  }
+
+private:
+  static const int kMaxLevel = 32;
+
+  struct Node{
+    T key;
+    U value;
+    int top;
+    // Removing a node takes one reference for the inserter and one for
+    // the remover; the last one to finish retires the node.
+    std::atomic<int> refs;
+    // The low bit of a link marks the node holding it as removed.
+    std::atomic<uintptr_t> next[1];
+  };
+
+  static bool marked( uintptr_t l ){
+    return( (l & 1) != 0 );
+  }
+
+  static Node* ptr( uintptr_t l ){
+    return( reinterpret_cast<Node*>( l & ~uintptr_t( 1 ) ) );
+  }
+
+  static uintptr_t link( Node* n ){
+    return( reinterpret_cast<uintptr_t>( n ) );
+  }
+
+  static size_t nodeBytes( int top ){
+    return( sizeof(Node) + (top - 1) * sizeof(std::atomic<uintptr_t>) );
+  }
+
+  /**
+   * Allocate the head; its key and value are never constructed.
+   */
+  static Node* newNode( int top ){
+    Node* n = static_cast<Node*>( ::operator new( nodeBytes( top ) ) );
+    n->top = top;
+    for( int i = 0; i < top; i++ ){
+      new( &n->next[i] ) std::atomic<uintptr_t>( 0 );
+    }
+    return( n );
+  }
+
+  static Node* newNode( int top, const T& key, const U& value ){
+    Node* n = newNode( top );
+    new( &n->key ) T( key );
+    new( &n->value ) U( value );
+    new( &n->refs ) std::atomic<int>( 2 );
+    return( n );
+  }
+
+  static void destroyNode( void* p ){
+    Node* n = static_cast<Node*>( p );
+    n->key.~T( );
+    n->value.~U( );
+    ::operator delete( n );
+  }
+
+  void release( Node* n ){
+    if( n->refs.fetch_sub( 1 ) == 1 ){
+      _reclaimer.retire( n, &destroyNode );
+    }
+  }
+
+  /**
+   * A level between 1 and kMaxLevel, each level half as likely as the
+   * one below.
+   */
+  static int randomLevel( ){
+    static thread_local uint64_t state = 0x9E3779B97F4A7C15ull ^
+      reinterpret_cast<uintptr_t>( &state );
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    int level = 1;
+    uint64_t bits = state;
+    while( level < kMaxLevel && (bits & 1) ){
+      level++;
+      bits >>= 1;
+    }
+    return( level );
+  }
+
+  Node* first( ){
+    Node* n = ptr( _head->next[0].load( ) );
+    while( n != NULL && marked( n->next[0].load( ) ) ){
+      n = ptr( n->next[0].load( ) );
+    }
+    return( n );
+  }
+
+  /**
+   * Find the predecessor and successor of key at every level, unlinking
+   * the marked nodes on the way.
+   * @return True if succs[0] holds key.
+   */
+  bool find( const T& key, Node** preds, Node** succs ){
+  retry:
+    Node* pred = _head;
+    Node* curr = NULL;
+    for( int level = kMaxLevel - 1; level >= 0; level-- ){
+      curr = ptr( pred->next[level].load( ) );
+      while( curr != NULL ){
+        uintptr_t succ = curr->next[level].load( );
+        while( marked( succ ) ){
+          uintptr_t expected = link( curr );
+          if( ! pred->next[level].compare_exchange_strong( expected, link( ptr( succ ) ) ) ){
+            goto retry;
+          }
+          curr = ptr( succ );
+          if( curr == NULL ){
+            break;
+          }
+          succ = curr->next[level].load( );
+        }
+        if( curr != NULL && curr->key < key ){
+          pred = curr;
+          curr = ptr( succ );
+        }else{
+          break;
+        }
+      }
+      preds[level] = pred;
+      succs[level] = curr;
+    }
+    return( curr != NULL && !(key < curr->key) );
+  }
+
+  Node* _head;
+  std::atomic<size_t> _count;
+  EpochReclaimer _reclaimer;
+
+  LockFreeSkipList( const LockFreeSkipList& );
+  LockFreeSkipList& operator =( const LockFreeSkipList& );
+};
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for the binary image that Tree::save writes
+ * and for a read-only view of such an image mapped into memory.
+ *
+ */
+
+#ifndef _MAPPEDTREE_H_
+#define _MAPPEDTREE_H_
+
+#include "Tree.h"
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * The header at the start of a tree image. It is followed by the keys
+ * in ascending order and then by their values, each array starting on
+ * a multiple of 8 bytes. Everything is in the byte order of the machine
+ * that wrote it.
+ */
+struct TreeImageHeader{
+  char magic[8];
+  uint32_t version;
+  uint32_t keySize;
+  uint32_t valueSize;
+  uint32_t reserved;
+  uint64_t count;
+
+  static const char* expectedMagic( ){
+    return( "BSTIMAGE" );
+  }
+
+  static size_t roundUp( size_t n ){
+    return( (n + 7) & ~size_t( 7 ) );
+  }
+
+  /**
+   * The offset of the key array.
+   */
+  static size_t keysOffset( ){
+    return( roundUp( sizeof(TreeImageHeader) ) );
+  }
+
+  /**
+   * True if count keys and values of the recorded sizes fit in an image
+   * of length bytes. Checked by division, so a corrupt count can not
+   * overflow; valuesOffset( ) and imageSize( ) are only meaningful once
+   * this holds.
+   */
+  bool fits( size_t length ) const{
+    uint64_t item = uint64_t( keySize ) + valueSize;
+    return( length >= keysOffset( ) && item > 0 &&
+            count <= (length - keysOffset( )) / item );
+  }
+
+  /**
+   * The offset of the value array.
+   */
+  size_t valuesOffset( ) const{
+    return( keysOffset( ) + roundUp( count * keySize ) );
+  }
+
+  /**
+   * The size of the whole image.
+   */
+  size_t imageSize( ) const{
+    return( valuesOffset( ) + roundUp( count * valueSize ) );
+  }
+};
+
+/**
+ * A read-only view of a tree image. The keys and values are used in
+ * place, so opening an image costs one mmap regardless of its size and
+ * lookups are binary searches over the mapped keys.
+ * T and U must be trivially copyable.
+ */
+template <class T, class U>
+class MappedTree{
+public:
+ /**
+  * MappedTree constructor.
+  * Initializes a view of nothing; see open( ).
+  */
+  MappedTree( ) : _base( NULL ), _length( 0 ), _keys( NULL ), _values( NULL ), _n( 0 ) { }
+
+ /**
+  * MappedTree deconstructor.
+  * Unmaps the image.
+  */
+  ~MappedTree( ){
+    close( );
+  }
+
+ /**
+  * Map an image written by Tree::save.
+  * @param path The image's file name.
+  * @return False if the file can not be mapped or is not an image of
+  *         a Tree<T, U>.
+  */
+  bool open( const char* path ){
+    close( );
+    int fd = ::open( path, O_RDONLY );
+    if( fd < 0 ){
+      return( false );
+    }
+    struct stat st;
+    bool ok = fstat( fd, &st ) == 0 &&
+              size_t( st.st_size ) >= TreeImageHeader::keysOffset( );
+    void* base = MAP_FAILED;
+    if( ok ){
+      base = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    }
+    ::close( fd );
+    if( base == MAP_FAILED ){
+      return( false );
+    }
+    const TreeImageHeader* h = static_cast<const TreeImageHeader*>( base );
+    if( memcmp( h->magic, TreeImageHeader::expectedMagic( ), sizeof(h->magic) ) != 0 ||
+        h->version != 1 || h->keySize != sizeof(T) || h->valueSize != sizeof(U) ||
+        ! h->fits( st.st_size ) || h->imageSize( ) != size_t( st.st_size ) ){
+      munmap( base, st.st_size );
+      return( false );
+    }
+    _base = base;
+    _length = st.st_size;
+    _n = h->count;
+    _keys = reinterpret_cast<const T*>( static_cast<const char*>( base ) +
+                                        TreeImageHeader::keysOffset( ) );
+    _values = reinterpret_cast<const U*>( static_cast<const char*>( base ) +
+                                          h->valuesOffset( ) );
+    return( true );
+  }
+
+ /**
+  * Unmap the image, if any.
+  */
+  void close( ){
+    if( _base ){
+      munmap( _base, _length );
+    }
+    _base = NULL;
+    _length = 0;
+    _keys = NULL;
+    _values = NULL;
+    _n = 0;
+  }
+
+ /**
+  * The number of keys in the image.
+  */
+  size_t size( ) const{
+    return( _n );
+  }
+
+ /**
+  * The keys, in ascending order.
+  */
+  const T* keys( ) const{
+    return( _keys );
+  }
+
+ /**
+  * The values, in the order of their keys.
+  */
+  const U* values( ) const{
+    return( _values );
+  }
+
+ /**
+  * Find the value paired with key.
+  * @param key The key to search for.
+  * @return A pointer to the value in the mapping, NULL if key is absent.
+  */
+  const U* find( const T& key ) const{
+    const T* k = std::lower_bound( _keys, _keys + _n, key );
+    if( k == _keys + _n || key < *k ){
+      return( NULL );
+    }
+    return( _values + (k - _keys) );
+  }
+
+ /**
+  * Check if key is in the image.
+  * @param key The key to search for.
+  * @return True if found, False otherwise.
+  */
+  bool hasKey( const T& key ) const{
+    return( find( key ) != NULL );
+  }
+
+private:
+  void* _base;
+  size_t _length;
+  const T* _keys;
+  const U* _values;
+  size_t _n;
+
+  MappedTree( const MappedTree& );
+  MappedTree& operator =( const MappedTree& );
+};
+
+/**
+ * Tree::save and Tree::load, declared in Tree.h. They live here so that
+ * only the programs that use images need the POSIX mapping calls.
+ */
+template <class T, class U, class Compare, class Hash>
+bool Tree<T, U, Compare, Hash>::save( const char* path ){
+  static_assert( std::is_trivially_copyable<T>::value &&
+                 std::is_trivially_copyable<U>::value,
+                 "Tree::save needs trivially copyable keys and values" );
+  size_t n = size( );
+  TreeImageHeader h;
+  memcpy( h.magic, TreeImageHeader::expectedMagic( ), sizeof(h.magic) );
+  h.version = 1;
+  h.keySize = sizeof(T);
+  h.valueSize = sizeof(U);
+  h.reserved = 0;
+  h.count = n;
+  std::ofstream out( path, std::ios::out | std::ios::binary | std::ios::trunc );
+  const char zeros[8] = { 0 };
+  out.write( reinterpret_cast<const char*>( &h ), sizeof(h) );
+  out.write( zeros, TreeImageHeader::keysOffset( ) - sizeof(h) );
+  writeImageArray( out, KeyOf( ) );
+  out.write( zeros, h.valuesOffset( ) - TreeImageHeader::keysOffset( ) - n * sizeof(T) );
+  writeImageArray( out, ValueOf( ) );
+  out.write( zeros, h.imageSize( ) - h.valuesOffset( ) - n * sizeof(U) );
+  out.close( );
+  return( ! out.fail( ) );
+}
+
+template <class T, class U, class Compare, class Hash>
+bool Tree<T, U, Compare, Hash>::load( const char* path ){
+  static_assert( std::is_trivially_copyable<T>::value &&
+                 std::is_trivially_copyable<U>::value,
+                 "Tree::load needs trivially copyable keys and values" );
+  MappedTree<T, U> image;
+  if( ! image.open( path ) ){
+    return( false );
+  }
+  build_from_sorted( image.keys( ), image.keys( ) + image.size( ), image.values( ) );
+  return( true );
+}
+
+#endif
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for a persistent (immutable) Binary Search Tree
+ * whose versions share every subtree an update did not touch.
+ *
+ * Based in part on "Making Data Structures Persistent" by Driscoll et
+ * al. and "Randomized Search Trees" by Seidel and Aragon.
+ *
+ */
+
+#ifndef _PERSISTENTTREE_H_
+#define _PERSISTENTTREE_H_
+
+#include <cstdlib>
+#include <cassert>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * A templated, persistent binary search tree.
+ * A PersistentTree is a handle to one version of the tree. insert and
+ * remove leave it unchanged and return a new version that copies only
+ * the O(log n) nodes on the path to the key; everything else is shared
+ * with the old version. Copying a handle is O(1), so taking a snapshot
+ * costs nothing beyond the updates themselves.
+ *
+ * The tree is a treap whose priorities are a hash of the keys, as in
+ * Tree::join, so its shape does not depend on the order of the updates
+ * and its height is O(log n) expected. Nodes are reference counted and
+ * freed when the last version using them goes away. Nodes never change
+ * once a version holding them has been returned, so different threads
+ * may read, update and drop versions at the same time; a single handle
+ * must not be assigned to by one thread while another uses it.
+ */
+template <class T, class U>
+class PersistentTree{
+public:
+ /**
+  * PersistentTree constructor.
+  * Initializes an empty tree.
+  */
+  PersistentTree( ) : _root( NULL ), _count( 0 ) { }
+
+ /**
+  * PersistentTree copy constructor; shares all of other's nodes.
+  */
+  PersistentTree( const PersistentTree& other ) :
+  _root( retain( other._root ) ), _count( other._count ) { }
+
+ /**
+  * PersistentTree deconstructor.
+  * Frees the nodes no other version is using.
+  */
+  ~PersistentTree( ){
+    release( _root );
+  }
+
+  PersistentTree& operator =( const PersistentTree& other ){
+    Node* old = _root;
+    _root = retain( other._root );
+    _count = other._count;
+    release( old );
+    return( *this );
+  }
+
+ /**
+  * Check if the tree is empty.
+  * @return True if empty, False otherwise.
+  */
+  bool isEmpty( ) const{
+    return( _root == NULL );
+  }
+
+ /**
+  * The number of keys in this version.
+  * @return The number of keys.
+  */
+  size_t size( ) const{
+    return( _count );
+  }
+
+ /**
+  * A version with key added.
+  * @param key The key to be inserted into the tree.
+  * @param value The value paired with key.
+  * @return The new version; this version if key was already present.
+  */
+  PersistentTree insert( const T& key, const U& value ) const{
+    if( hasKey( key ) ){
+      return( *this );
+    }
+    return( PersistentTree( insertAt( _root, key, value, priority( key ) ), _count + 1 ) );
+  }
+
+ /**
+  * A version without key.
+  * @param key The key to be removed from the tree.
+  * @return The new version; this version if key was absent.
+  */
+  PersistentTree remove( const T& key ) const{
+    if( ! hasKey( key ) ){
+      return( *this );
+    }
+    return( PersistentTree( removeAt( _root, key ), _count - 1 ) );
+  }
+
+ /**
+  * Check if key is in this version.
+  * @param key The key to search for.
+  * @return True if found, False otherwise.
+  */
+  bool hasKey( const T& key ) const{
+    return( findNode( key ) != NULL );
+  }
+
+ /**
+  * Look up the value paired with key.
+  * @param key The key to search for.
+  * @param value Receives the value if key is found.
+  * @return True if found, False otherwise.
+  */
+  bool find( const T& key, U& value ) const{
+    const Node* n = findNode( key );
+    if( n == NULL ){
+      return( false );
+    }
+    value = n->value;
+    return( true );
+  }
+
+ /**
+  * Call f( key, value ) for every key in ascending order.
+  * @param f The function object to call.
+  */
+  template <class F>
+  void for_each( F f ) const{
+    std::vector<const Node*> stack;
+    const Node* x = _root;
+    while( x != NULL || ! stack.empty( ) ){
+      while( x != NULL ){
+        stack.push_back( x );
+        x = x->left;
+      }
+      x = stack.back( );
+      stack.pop_back( );
+      f( x->key, x->value );
+      x = x->right;
+    }
+  }
+
+private:
+  struct Node{
+    Node( const T& k, const U& v, uint64_t p, Node* l, Node* r ) :
+    key( k ), value( v ), priority( p ), left( l ), right( r ), refs( 1 ) { }
+    const T key;
+    const U value;
+    const uint64_t priority;
+    // Only written while the node is new and not yet in any version.
+    Node* left;
+    Node* right;
+    std::atomic<size_t> refs;
+  };
+
+  Node* _root;
+  size_t _count;
+
+  /**
+   * Take over root, which already carries a reference for this version.
+   */
+  PersistentTree( Node* root, size_t count ) : _root( root ), _count( count ) { }
+
+  static uint64_t priority( const T& key ){
+    uint64_t h = std::hash<T>( )( key );
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return( h );
+  }
+
+  static Node* retain( Node* n ){
+    if( n ){
+      n->refs.fetch_add( 1, std::memory_order_relaxed );
+    }
+    return( n );
+  }
+
+  /**
+   * Drop a reference to n and free every node no longer referenced.
+   */
+  static void release( Node* n ){
+    std::vector<Node*> dead;
+    if( n ){
+      dead.push_back( n );
+    }
+    while( ! dead.empty( ) ){
+      n = dead.back( );
+      dead.pop_back( );
+      if( n->refs.fetch_sub( 1, std::memory_order_acq_rel ) != 1 ){
+        continue;
+      }
+      if( n->left ){
+        dead.push_back( n->left );
+      }
+      if( n->right ){
+        dead.push_back( n->right );
+      }
+      delete n;
+    }
+  }
+
+  /**
+   * A new copy of n with the given children. The children's references
+   * are handed over by the caller.
+   */
+  static Node* copy( const Node* n, Node* l, Node* r ){
+    return( new Node( n->key, n->value, n->priority, l, r ) );
+  }
+
+  const Node* findNode( const T& key ) const{
+    const Node* x = _root;
+    while( x != NULL ){
+      if( key < x->key ){
+        x = x->left;
+      }else if( x->key < key ){
+        x = x->right;
+      }else{
+        break;
+      }
+    }
+    return( x );
+  }
+
+  /**
+   * The subtree n with key added; key must be absent.
+   * @return A new node holding a reference for the caller.
+   */
+  static Node* insertAt( Node* n, const T& key, const U& value, uint64_t p ){
+    if( n == NULL ){
+      return( new Node( key, value, p, NULL, NULL ) );
+    }
+    if( key < n->key ){
+      Node* l = insertAt( n->left, key, value, p );
+      Node* c = copy( n, l, retain( n->right ) );
+      if( c->priority < l->priority ){
+        // Rotate right; both nodes are new so they may be relinked.
+        c->left = l->right;
+        l->right = c;
+        return( l );
+      }
+      return( c );
+    }
+    Node* r = insertAt( n->right, key, value, p );
+    Node* c = copy( n, retain( n->left ), r );
+    if( c->priority < r->priority ){
+      c->right = r->left;
+      r->left = c;
+      return( r );
+    }
+    return( c );
+  }
+
+  /**
+   * The subtree n without key; key must be present.
+   * @return A node holding a reference for the caller.
+   */
+  static Node* removeAt( Node* n, const T& key ){
+    if( key < n->key ){
+      return( copy( n, removeAt( n->left, key ), retain( n->right ) ) );
+    }
+    if( n->key < key ){
+      return( copy( n, retain( n->left ), removeAt( n->right, key ) ) );
+    }
+    return( merge( n->left, n->right ) );
+  }
+
+  /**
+   * Join the subtrees l and r, whose keys are in that order, copying
+   * the nodes along the seam.
+   * @return A node holding a reference for the caller.
+   */
+  static Node* merge( Node* l, Node* r ){
+    if( l == NULL ){
+      return( retain( r ) );
+    }
+    if( r == NULL ){
+      return( retain( l ) );
+    }
+    if( r->priority < l->priority ){
+      return( copy( l, retain( l->left ), merge( l->right, r ) ) );
+    }
+    return( copy( r, merge( l, r->left ), retain( r->right ) ) );
+  }
+};
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for a self-adjusting (splay) Binary Search Tree
+ * with the same interface as the Tree class.
+ *
+ * Based in part on "Self-Adjusting Binary Search Trees" by Sleator and
+ * Tarjan.
+ *
+ */
+
+#ifndef _SPLAYTREE_H_
+#define _SPLAYTREE_H_
+
+#include "TreeNode.h"
+#include <cstdlib>
+#include <cassert>
+
+/**
+ * A templated splay tree.
+ * Every lookup, insert and remove moves the last node it visited to the
+ * root with a series of rotations, so keys that are used often stay
+ * near the root and a run of operations costs O(log n) amortized each.
+ *
+ * In semi-splay mode a zig-zig step rotates only the parent and carries
+ * on splaying from the parent. An access then roughly halves the depth
+ * of the nodes on its path instead of bringing the node to the root,
+ * which takes about half the rotations when the hot keys are already
+ * near the top.
+ */
+template <class T, class U>
+class SplayTree{
+public:
+ /**
+  * SplayTree constructor.
+  * Initializes an empty tree.
+  * @param semiSplay Use semi-splaying instead of full splaying.
+  */
+  explicit SplayTree( bool semiSplay = false ) :
+  _root( NULL ), _count( 0 ), _semi( semiSplay ) { }
+
+ /**
+  * SplayTree deconstructor.
+  * Removes all the tree's nodes.
+  */
+  ~SplayTree( ){
+    clear( );
+  }
+
+ /**
+  * Remove all the tree's nodes.
+  */
+  void clear( ){
+    TreeNode<T, U>* n = _root;
+    while( n ){
+      if( n->left( ) ){
+        n = n->left( );
+      }else if( n->right( ) ){
+        n = n->right( );
+      }else{
+        TreeNode<T, U>* p = n->parent( );
+        if( p && p->left( ) == n ){
+          p->setLeft( NULL );
+        }else if( p ){
+          p->setRight( NULL );
+        }
+        delete n;
+        n = p;
+      }
+    }
+    _root = NULL;
+    _count = 0;
+  }
+
+ /**
+  * Check if the tree is empty.
+  * @return True if empty, False otherwise.
+  */
+  bool isEmpty( ) const{
+    return( _root == NULL );
+  }
+
+ /**
+  * The number of keys in the tree.
+  * @return The number of keys.
+  */
+  size_t size( ) const{
+    return( _count );
+  }
+
+ /**
+  * Insert data into the tree and splay the new node.
+  * @param key The key to be inserted into the tree.
+  * @param value The value paired with key.
+  * @return True if inserted, false if key was already present, in
+  *         which case that key is splayed instead.
+  */
+  bool insert( const T& key, const U& value ){
+    TreeNode<T, U>* y = descend( key );
+    if( y != NULL && !(key < y->key( )) && !(y->key( ) < key) ){
+      splay( y, _semi );
+      return( false );
+    }
+    TreeNode<T, U>* n = new TreeNode<T, U>( y, key, value );
+    if( y == NULL ){
+      _root = n;
+    }else if( key < y->key( ) ){
+      y->setLeft( n );
+    }else{
+      y->setRight( n );
+    }
+    _count++;
+    splay( n, _semi );
+    return( true );
+  }
+
+ /**
+  * Delete the specified key from the tree.
+  * @param key The key to be removed from the tree.
+  * @return True if key exists and was removed, false otherwise.
+  */
+  bool remove( const T& key ){
+    TreeNode<T, U>* n = descend( key );
+    if( n == NULL ){
+      return( false );
+    }
+    // Removing takes full splays whatever the mode so that n, and then
+    // the largest key left of it, really reach the root.
+    splay( n, false );
+    if( key < n->key( ) || n->key( ) < key ){
+      return( false );
+    }
+    TreeNode<T, U>* l = n->left( );
+    TreeNode<T, U>* r = n->right( );
+    if( l == NULL ){
+      _root = r;
+      if( r ){
+        r->setParent( NULL );
+      }
+    }else{
+      // Join the subtrees under the largest key on the left.
+      l->setParent( NULL );
+      _root = l;
+      TreeNode<T, U>* m = l;
+      while( m->right( ) ){
+        m = m->right( );
+      }
+      splay( m, false );
+      m->setRight( r );
+      if( r ){
+        r->setParent( m );
+      }
+    }
+    delete n;
+    _count--;
+    return( true );
+  }
+
+ /**
+  * Check if key is in the tree.
+  * The node where the search stopped is splayed, hit or miss.
+  * @param key The key to search for.
+  * @return True if found, False otherwise.
+  */
+  bool hasKey( const T& key ){
+    return( find( key ) != NULL );
+  }
+
+ /**
+  * Find the node holding key and splay it.
+  * @param key The key to search for.
+  * @return The node, NULL if key is absent.
+  */
+  TreeNode<T, U>* find( const T& key ){
+    TreeNode<T, U>* n = descend( key );
+    if( n == NULL ){
+      return( NULL );
+    }
+    splay( n, _semi );
+    if( key < n->key( ) || n->key( ) < key ){
+      return( NULL );
+    }
+    return( n );
+  }
+
+  TreeNode<T, U>* minimum( ){
+    TreeNode<T, U>* n = _root;
+    while( n && n->left( ) ){
+      n = n->left( );
+    }
+    return( n );
+  }
+
+  TreeNode<T, U>* maximum( ){
+    TreeNode<T, U>* n = _root;
+    while( n && n->right( ) ){
+      n = n->right( );
+    }
+    return( n );
+  }
+
+private:
+  TreeNode<T, U>* _root;
+  size_t _count;
+  bool _semi;
+
+  /**
+   * Walk down towards key.
+   * @return The node holding key or, if there is none, the last node
+   *         visited; NULL if the tree is empty.
+   */
+  TreeNode<T, U>* descend( const T& key ){
+    TreeNode<T, U>* x = _root;
+    TreeNode<T, U>* y = NULL;
+    while( x != NULL ){
+      y = x;
+      if( key < x->key( ) ){
+        x = x->left( );
+      }else if( x->key( ) < key ){
+        x = x->right( );
+      }else{
+        break;
+      }
+    }
+    return( y );
+  }
+
+  /**
+   * Rotate x above its parent, keeping the key order.
+   */
+  void rotate( TreeNode<T, U>* x ){
+    TreeNode<T, U>* p = x->parent( );
+    TreeNode<T, U>* g = p->parent( );
+    if( x == p->left( ) ){
+      p->setLeft( x->right( ) );
+      if( x->right( ) ){
+        x->right( )->setParent( p );
+      }
+      x->setRight( p );
+    }else{
+      p->setRight( x->left( ) );
+      if( x->left( ) ){
+        x->left( )->setParent( p );
+      }
+      x->setLeft( p );
+    }
+    p->setParent( x );
+    x->setParent( g );
+    if( g == NULL ){
+      _root = x;
+    }else if( g->left( ) == p ){
+      g->setLeft( x );
+    }else{
+      g->setRight( x );
+    }
+  }
+
+  /**
+   * Move x to the root, or with semi set towards it.
+   */
+  void splay( TreeNode<T, U>* x, bool semi ){
+    while( x->parent( ) ){
+      TreeNode<T, U>* p = x->parent( );
+      TreeNode<T, U>* g = p->parent( );
+      if( g == NULL ){
+        // zig
+        rotate( x );
+      }else if( (x == p->left( )) == (p == g->left( )) ){
+        // zig-zig
+        rotate( p );
+        if( semi ){
+          x = p;
+        }else{
+          rotate( x );
+        }
+      }else{
+        // zig-zag
+        rotate( x );
+        rotate( x );
+      }
+    }
+  }
+
+  SplayTree( const SplayTree& );
+  SplayTree& operator =( const SplayTree& );
+};
+
+#endif
@@ -14,39 +14,256 @@
 #define _TREE_H_
 
 #include "TreeNode.h"
+#include "TreeCompare.h"
+#include "FrozenTree.h"
+#include "TreeFilter.h"
 #include <cstdlib>
+#include <cstring>
 #include <cassert>
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <iterator>
+#include <utility>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <type_traits>
+#include <stdint.h>
+
+/**
+ * Set TREE_VERBOSE to 0 before including this file to silence the
+ * diagnostics insert writes to cerr.
+ */
+#ifndef TREE_VERBOSE
+#define TREE_VERBOSE 1
+#endif
+
+// Tree::snapshot returns one; it is defined in TreeExport.h.
+template <class T> class TreeSnapshot;
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TREE_PREFETCH( addr ) __builtin_prefetch( (addr) )
+#else
+#define TREE_PREFETCH( addr )
+#endif
 
 /**
  * A naïve, templated binary search tree class.
  * Requires the TreeNode class.
+ * Keys are ordered by Compare, a "less than" function object. Searches
+ * compare each key they pass once, through TreeThreeWay; if Compare is
+ * transparent (see TreeLess) the lookups also take keys of other types.
+ * Hash hashes the keys for the filter (enableFilter) and for the treap
+ * priorities of split, join and the set operations. It defaults to
+ * std::hash<T> when that exists; otherwise to TreeNoHash, and a tree
+ * of such keys works as long as none of those are used.
  */
-template <class T, class U>
+template <class T, class U, class Compare = std::less<T>,
+          class Hash = typename TreeDefaultHash<T>::type>
 class Tree{
 public:
+ /**
+  * A bidirectional iterator that visits the tree's nodes in key order
+  * by following the parent pointers; it needs no extra storage.
+  * Inserting keeps iterators valid, removing invalidates the iterators
+  * to the removed node.
+  * The nodes are reached as const TreeNode: changing a key in place
+  * would break the order, so keys and values are changed through the
+  * tree. TreePtr is Tree* for iterator and const Tree* for
+  * const_iterator; an iterator converts to a const_iterator.
+  */
+  template <class TreePtr>
+  class basic_iterator{
+  public:
+    typedef std::bidirectional_iterator_tag iterator_category;
+    typedef TreeNode<T, U> value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const TreeNode<T, U>* pointer;
+    typedef const TreeNode<T, U>& reference;
+
+    basic_iterator( ) : _tree( NULL ), _node( NULL ) { }
+
+    template <class OtherPtr>
+    basic_iterator( const basic_iterator<OtherPtr>& other,
+                    typename std::enable_if<std::is_convertible<OtherPtr, TreePtr>::value>::type* = 0 ) :
+    _tree( other._tree ), _node( other._node ) { }
+
+    reference operator *( ) const{
+      return( *_node );
+    }
+
+    pointer operator ->( ) const{
+      return( _node );
+    }
+
+    basic_iterator& operator ++( ){
+      _node = _tree->successor( _node );
+      return( *this );
+    }
+
+    basic_iterator operator ++( int ){
+      basic_iterator rv = *this;
+      ++(*this);
+      return( rv );
+    }
+
+    basic_iterator& operator --( ){
+      if( _node == NULL ){
+        _node = _tree->_root ? _tree->local_maximum( _tree->_root ) : NULL;
+      }else{
+        _node = _tree->predecessor( _node );
+      }
+      return( *this );
+    }
+
+    basic_iterator operator --( int ){
+      basic_iterator rv = *this;
+      --(*this);
+      return( rv );
+    }
+
+    template <class OtherPtr>
+    bool operator ==( const basic_iterator<OtherPtr>& other ) const{
+      return( _node == other._node );
+    }
+
+    template <class OtherPtr>
+    bool operator !=( const basic_iterator<OtherPtr>& other ) const{
+      return( _node != other._node );
+    }
+
+  private:
+    friend class Tree;
+    template <class OtherPtr> friend class basic_iterator;
+    basic_iterator( TreePtr tree, TreeNode<T, U>* node ) : _tree( tree ), _node( node ) { }
+    TreePtr _tree;
+    TreeNode<T, U>* _node;
+  };
+
+  typedef basic_iterator<Tree*> iterator;
+  typedef basic_iterator<const Tree*> const_iterator;
+
  /**
   * Tree constructor.
   * Initializes an empty tree.
+  * @param compare The function object that orders the keys.
   */
-  explicit Tree( ) : _root( NULL ) { }
+  explicit Tree( const Compare& compare = Compare( ) ) :
+  _root( NULL ), _count( 0 ), _compare( compare ), _filter( NULL ),
+  _filterStale( false ) { }
+
+ /**
+  * Tree copy constructor.
+  * Copies other node for node, so the copy has the same shape; no keys
+  * are compared. Costs O(n).
+  * @param other The tree to copy.
+  */
+  Tree( const Tree& other ) :
+  _root( clone( other._root ) ), _count( other._count ), _compare( other._compare ),
+  _filter( other._filter ? new TreeBloomFilter<T, Hash>( *other._filter ) : NULL ),
+  _filterStale( other._filterStale ) { }
+
+ /**
+  * Tree move constructor.
+  * Takes over other's nodes in O(1), leaving other empty. It and the
+  * move assignment are noexcept, so containers of trees move them
+  * when they grow instead of copying every node; copying Compare and
+  * Hash must not throw.
+  * @param other The tree to move from.
+  */
+  Tree( Tree&& other ) noexcept :
+  _root( other._root ), _count( other._count ), _compare( other._compare ),
+  _filter( other._filter ), _filterStale( other._filterStale ){
+    other._root = NULL;
+    other._count = 0;
+    other._filter = NULL;
+  }
+
+  Tree& operator =( const Tree& other ){
+    if( &other != this ){
+      Tree copy( other );
+      swap( copy );
+    }
+    return( *this );
+  }
+
+  Tree& operator =( Tree&& other ) noexcept{
+    if( &other != this ){
+      Tree moved( std::move( other ) );
+      swap( moved );
+    }
+    return( *this );
+  }
+
+ /**
+  * Exchange the contents of the tree with other's in O(1).
+  * @param other The tree to swap with.
+  */
+  void swap( Tree& other ) noexcept{
+    std::swap( _root, other._root );
+    std::swap( _count, other._count );
+    std::swap( _compare, other._compare );
+    std::swap( _filter, other._filter );
+    std::swap( _filterStale, other._filterStale );
+  }
 
  /**
   * Tree deconstructor.
   * If the tree is not empty, it removes all the tree's nodes.
   */
   ~Tree( ){
+    clear( );
+    delete _filter;
+  }
+
+ /**
+  * Remove all the tree's nodes.
+  */
+  void clear( ){
     if( _root ){
-      TreeNode<T, U>* n = _root->left( );
-      if( n ){
-        trim( n );
-      }
-      n = _root->right( );
-      if( n ){
-        trim( n );
-      }
-      delete _root;
+      trim( _root );
+      _root = NULL;
     }
+    _count = 0;
+    filterStale( );
+  }
+
+ /**
+  * Put a blocked Bloom filter (TreeBloomFilter) in front of hasKey and
+  * find so that most lookups of absent keys return without visiting a
+  * node. Inserts add to the filter; after many removes, or once the
+  * tree has outgrown it, the filter is rebuilt from the tree by the
+  * next lookup. Operations that relink whole subtrees (build_from_sorted,
+  * load, split, join and the set operations) also leave the rebuild to
+  * the next lookup. Keys that compare equal must have equal Hash
+  * values. Lookups of keys of another type through a transparent
+  * comparator do not use the filter.
+  * @param bitsPerKey The filter bits to spend on each key; 10 gives
+  *                   about a 1% false positive rate.
+  */
+  void enableFilter( unsigned bitsPerKey = 10 ){
+    static_assert( ! std::is_same<Hash, TreeNoHash<T> >::value,
+                   "Tree::enableFilter needs a Hash for the keys" );
+    delete _filter;
+    _filter = new TreeBloomFilter<T, Hash>( bitsPerKey );
+    _filterStale = true;
+  }
+
+ /**
+  * Drop the filter set up by enableFilter.
+  */
+  void disableFilter( ){
+    delete _filter;
+    _filter = NULL;
+  }
+
+ /**
+  * The bytes held by the filter, 0 if there is none.
+  */
+  size_t filterBytes( ) const{
+    return( _filter ? _filter->memoryBytes( ) : 0 );
   }
 
  /**
@@ -61,21 +278,40 @@ public:
     }
     return( rv );
   }
+
+ /**
+  * The number of keys in the tree.
+  * @return The number of keys.
+  */
+  size_t size( ) const{
+    if( _count == kUncounted ){
+      // Only split leaves the count unknown.
+      _count = countNodes( _root );
+    }
+    return( _count );
+  }
  
   /**
    * Insert data into the tree.
    * @param key The key to be inserted into the tree.
    */
-   void insert( T& key, U& value ){
-     if( find_iterative( _root, key ) ){
-       std::cerr << "key already inserted - ignored." << std::endl;
+   void insert( const T& key, const U& value ){
+     if( lookup( key ) ){
+       if( TREE_VERBOSE ){
+         std::cerr << "key already inserted - ignored." << std::endl;
+       }
      }else{
-       std::cerr << "inserting " << key << std::endl;
+       if( TREE_VERBOSE ){
+         std::cerr << "inserting " << key << std::endl;
+       }
        TreeNode<T, U>* x = _root;
        TreeNode<T, U>* y = NULL;
        while( x != NULL ){
          y = x;
-         if( x->key( ) > key ){
+#ifdef TREE_ORDER_STATISTICS
+         x->setSubtreeSize( x->subtreeSize( ) + 1 );
+#endif
+         if( less( key, x->key( ) ) ){
            x = x->left( );
          }else{
            x = x->right( );
@@ -84,49 +320,132 @@ public:
        TreeNode<T, U>* n = new TreeNode<T, U>( y, key, value );
        if( y == NULL ){
          _root = n;
-       }else if( y->key( ) > key ){
+       }else if( less( key, y->key( ) ) ){
          y->setLeft( n );
        }else{
          y->setRight( n );
        }
+       adjustCount( 1 );
+       filterAdd( key );
      }
    }
 
-   void insert_recursive( T& key, U& value ){
-     if( find_iterative( _root, key ) ){
-       std::cerr << "key already inserted - ignored." << std::endl;
+   void insert_recursive( const T& key, const U& value ){
+     if( lookup( key ) ){
+       if( TREE_VERBOSE ){
+         std::cerr << "key already inserted - ignored." << std::endl;
+       }
      }else{
+       adjustCount( 1 );
        if( ! _root ){
-	 _root = new TreeNode<T, U>( key );
-       }else if( _root->key( ) <= key ){
-	 if( _root->right( ) ){
-	   insertHelper( _root->right( ), key );
-	 }else{
-	   _root->setRight( new TreeNode<T, U>( _root, key, value ) );
-	 }
+	 _root = new TreeNode<T, U>( key, value );
        }else{
-	 if( _root->left( ) ){
-	   insertHelper( _root->left( ), key );
-	 }else{
-	   _root->setLeft( new TreeNode<T, U>( _root, key, value ) );
-	 }
+	 insertHelper( _root, key, value );
        }
+       filterAdd( key );
      }
    }
 
+  /**
+   * Replace the contents of the tree with a perfectly balanced tree
+   * built from sorted input in linear time.
+   * @param begin Random access iterator to the first (key, value) pair;
+   *              the keys must be in strictly ascending order.
+   * @param end Iterator one past the last pair.
+   */
+   template <class PairIter>
+   void build_from_sorted( PairIter begin, PairIter end ){
+     PairSource<PairIter> src( begin );
+     build( src, static_cast<size_t>( end - begin ), 1 );
+   }
+
+  /**
+   * Replace the contents of the tree with a perfectly balanced tree
+   * built from sorted input in linear time.
+   * @param keyBegin Random access iterator to the first key; the keys
+   *                 must be in strictly ascending order.
+   * @param keyEnd Iterator one past the last key.
+   * @param valueBegin Random access iterator to the value of the first key.
+   */
+   template <class KeyIter, class ValueIter>
+   void build_from_sorted( KeyIter keyBegin, KeyIter keyEnd, ValueIter valueBegin ){
+     SplitSource<KeyIter, ValueIter> src( keyBegin, valueBegin );
+     build( src, static_cast<size_t>( keyEnd - keyBegin ), 1 );
+   }
+
+  /**
+   * Same as build_from_sorted( begin, end ) except that the subtrees
+   * near the root are linked on separate threads.
+   * @param threads The number of threads to use; 0 picks one per core.
+   */
+   template <class PairIter>
+   void build_from_sorted_parallel( PairIter begin, PairIter end,
+                                    unsigned threads = 0 ){
+     PairSource<PairIter> src( begin );
+     build( src, static_cast<size_t>( end - begin ), threads );
+   }
+
+  /**
+   * Same as build_from_sorted( keyBegin, keyEnd, valueBegin ) except
+   * that the subtrees near the root are linked on separate threads.
+   * @param threads The number of threads to use; 0 picks one per core.
+   */
+   template <class KeyIter, class ValueIter>
+   void build_from_sorted_parallel( KeyIter keyBegin, KeyIter keyEnd,
+                                    ValueIter valueBegin, unsigned threads ){
+     SplitSource<KeyIter, ValueIter> src( keyBegin, valueBegin );
+     build( src, static_cast<size_t>( keyEnd - keyBegin ), threads );
+   }
+
+  /**
+   * Replace the contents of the tree with a perfectly balanced tree
+   * built from (key, value) pairs in any order. The pairs are copied
+   * and sorted on several threads, with a radix sort if T is an
+   * integer type ordered by std::less and a merge sort otherwise; a key
+   * that appears more than once keeps its first value, as with insert.
+   * The tree is then linked as by build_from_sorted_parallel. Costs
+   * O(n) for integer keys, O(n log n) otherwise, and memory for two
+   * copies of the input.
+   * @param begin Random access iterator to the first (key, value) pair.
+   * @param end Iterator one past the last pair.
+   * @param threads The number of threads to use; 0 picks one per core.
+   */
+   template <class PairIter>
+   void build_from_unsorted( PairIter begin, PairIter end, unsigned threads = 0 ){
+     PairSource<PairIter> src( begin );
+     buildUnsorted( src, static_cast<size_t>( end - begin ), threads );
+   }
+
+  /**
+   * Same as build_from_unsorted( begin, end, threads ) for keys and
+   * values in separate sequences.
+   * @param keyBegin Random access iterator to the first key.
+   * @param keyEnd Iterator one past the last key.
+   * @param valueBegin Random access iterator to the value of the first key.
+   * @param threads The number of threads to use; 0 picks one per core.
+   */
+   template <class KeyIter, class ValueIter>
+   void build_from_unsorted( KeyIter keyBegin, KeyIter keyEnd,
+                             ValueIter valueBegin, unsigned threads ){
+     SplitSource<KeyIter, ValueIter> src( keyBegin, valueBegin );
+     buildUnsorted( src, static_cast<size_t>( keyEnd - keyBegin ), threads );
+   }
+
   /**
    * Delete the specified key from the tree.
    * @param key The key to be removed from the tree.
    * @return True if key exists and was removed, false otherwise.
    */
-   bool remove( T key ){
+   bool remove( const T& key ){
      bool ret = false;
-     TreeNode<T, U>* n = find_iterative( _root, key );     
+     TreeNode<T, U>* n = lookup( key );
      if( !n ){
        ret = false;
      }else{
        ret = true;
        deleteNode( n );
+       adjustCount( -1 );
+       filterRemoved( );
      }
      return( ret );
    }
@@ -149,6 +468,18 @@ public:
     return(out);
   }
   
+  /**
+   * Copy the shape of the tree for TreeExporter, breadth first, so that
+   * the limits keep the part of the tree nearest the root. Subtrees cut
+   * off by the limits are recorded as truncated stubs. Defined in
+   * TreeExport.h, which must be included to use it.
+   * @param maxDepth The deepest level to copy; the root is level 0.
+   * @param maxNodes The most nodes to copy.
+   * @return The snapshot.
+   */
+  TreeSnapshot<T> snapshot( size_t maxDepth = size_t( -1 ),
+                            size_t maxNodes = size_t( -1 ) );
+
   std::ostream& writeLinks( std::ostream& out ){
     if( _root ){
       out << _root << std::endl;
@@ -168,165 +499,1800 @@ public:
     return( local_maximum( _root ) );
   }
 
-  bool hasKey( T key ){
-    return(find_iterative( _root, key ));
+  /**
+   * An iterator to the node with the smallest key.
+   * @return begin( ) equals end( ) if the tree is empty.
+   */
+  iterator begin( ){
+    return( iterator( this, _root ? local_minimum( _root ) : NULL ) );
   }
 
-  T inorderSuccessorTest( T key ){
-    TreeNode<T, U>* x = find_iterative( _root, key );
-    TreeNode<T, U>* y = inorderSuccessor( x );
-    return(y->key( ));
+  /**
+   * An iterator one past the node with the largest key.
+   */
+  iterator end( ){
+    return( iterator( this, NULL ) );
   }
 
-private:
- /**
-  * Private pointer to the root of the tree.
-  */
-  TreeNode<T, U>* _root;
-  
-  TreeNode<T, U>* find_recursive( TreeNode<T, U>* t, T key ){
-    TreeNode<T, U>* ret = NULL;
-    T k;
-    if( t == NULL || (k = t->key( )) == key ){
-      ret = t;
-    }else if( key < k ){
-      ret = find_recursive( t->left( ), key );
-    }else{
-      // if key > k
-      ret = find_recursive( t->right( ), key );
-    }
-    return( ret );
+  const_iterator begin( ) const{
+    return( const_iterator( this, _root ? local_minimum( _root ) : NULL ) );
   }
-  
-  TreeNode<T, U>* find_iterative( TreeNode<T, U>* t, T key ){
-    while( t != NULL && t->key( ) != key ){
-      if( key > t->key( ) ){
-        t = t->right( );
-      }else{
-        t = t->left( );
-      }
-    }
-    return( t );
+
+  const_iterator end( ) const{
+    return( const_iterator( this, NULL ) );
   }
-  
-  TreeNode<T, U>* inorderSuccessor( TreeNode<T, U>* n ){
-    TreeNode<T, U>* ios = NULL;
-    TreeNode<T, U>* tmp = NULL;
-    if( n->right( ) != NULL ){
-      ios = local_minimum( n->right( ) );
-      assert( ios );
-    }else{
-      ios = n->parent( );
-      tmp = n;
-      while( ios != NULL && tmp == ios->right( ) ){
-        tmp = ios;
-        ios = ios->parent( );
-      }
-      if( ios == NULL ){
-	// if ios is null then ios is the tree's max.
-	// return (the original) n as the ios.
-        ios = n;
-      }
-    }
-    return( ios );
+
+  const_iterator cbegin( ) const{
+    return( begin( ) );
   }
-  
-  void transplant( TreeNode<T, U>* u, TreeNode<T, U>* v ){
-    if( u->parent( ) == NULL ){
-      _root = v;
-    }else if( u == u->parent()->left() ){
-      u->parent()->setLeft( v );
-    }else{
-      u->parent()->setRight(v);
-    }
-    if( v != NULL ){
-      v->setParent( u->parent( ) );
-    }
+
+  const_iterator cend( ) const{
+    return( end( ) );
   }
 
-  void deleteNode( TreeNode<T, U>* n ){
-    if( n->left( ) == NULL ){
-      transplant( n, n->right() );
-    }else if( n->right( ) == NULL ){
-      transplant( n, n->left( ) );
-    }else{
-      TreeNode<T, U>* y = local_minimum( n->right( ) );
-      if( y->parent( ) != n ){
-        transplant( y, y->right( ) );
-        y->setRight( n->right( ) );
-        y->right( )->setParent( y );
-      }
-      transplant( n, y );
-      y->setLeft( n->left( ) );
-      y->left( )->setParent( y );
-    }
-    delete n;
+  /**
+   * Find the node holding key.
+   * @param key The key to search for.
+   * @return The iterator to the node, end( ) if key is absent.
+   */
+  iterator find( const T& key ){
+    return( iterator( this, lookup( key ) ) );
   }
 
- // BROKEN!!! try to remove the inorder predessecor
- // of the root node and it breaks
- // and it doesn't free the memory!!
-  void deleteNodeX( TreeNode<T, U>* n ){
-    TreeNode<T, U>* x;
-    TreeNode<T, U>* y;
-    if( n->isLeafNode( ) ){
-      y = n;
-    }else{
-      y = inorderSuccessor( n );
-    }
-    if( y->left( ) != NULL ){
-      x = y->left( );
-    }else{
-      x = y->right( );
-    }
-    if( x != NULL ){
-      x->setParent( y->parent( ) );
-    }
-    if( y->parent( ) == NULL ){
-      _root = x;
-    }else if( y->isLeftChildOfParent( ) ){
-      y->parent( )->setLeft( x );
-    }else{
-      y->parent( )->setRight( x );
-    }
-    if( y != n ){
-      n->setKey( y->key( ) );
-    }
+  /**
+   * Same as find( key ) on a const tree. The filter is not consulted,
+   * since rebuilding a stale one would change the tree.
+   */
+  const_iterator find( const T& key ) const{
+    return( const_iterator( this, find_iterative( _root, key ) ) );
   }
-  
-  void writeLinksHelper( std::ostream& out, TreeNode<T, U>* n ){
-    if( n ){
-      out << n << std::endl;
-      writeLinksHelper( out, n->left( ) );
-      writeLinksHelper( out, n->right( ) );
-    }
+
+  /**
+   * Same as find( key ) for a key of another type; only available if
+   * Compare is transparent.
+   */
+  template <class K>
+  typename TreeIfTransparent<Compare, K, iterator>::type find( const K& key ){
+    return( iterator( this, find_iterative( _root, key ) ) );
   }
 
-  void trim( TreeNode<T, U>* n ){
-    TreeNode<T, U>* l = n->left( );
-    TreeNode<T, U>* r = n->right( );
-    if( l ){
-      trim( l );
-      delete l;
+  /**
+   * Find the first node whose key is not less than key.
+   * @param key The key to search for.
+   * @return The iterator to the node, end( ) if there is none.
+   */
+  iterator lower_bound( const T& key ){
+    return( iterator( this, lowerBound( key ) ) );
+  }
+
+  const_iterator lower_bound( const T& key ) const{
+    return( const_iterator( this, lowerBound( key ) ) );
+  }
+
+  /**
+   * Same as lower_bound( key ) for a key of another type; only
+   * available if Compare is transparent.
+   */
+  template <class K>
+  typename TreeIfTransparent<Compare, K, iterator>::type lower_bound( const K& key ){
+    return( iterator( this, lowerBound( key ) ) );
+  }
+
+  /**
+   * Find the first node whose key is greater than key.
+   * @param key The key to search for.
+   * @return The iterator to the node, end( ) if there is none.
+   */
+  iterator upper_bound( const T& key ){
+    return( iterator( this, upperBound( key ) ) );
+  }
+
+  const_iterator upper_bound( const T& key ) const{
+    return( const_iterator( this, upperBound( key ) ) );
+  }
+
+  /**
+   * Same as upper_bound( key ) for a key of another type; only
+   * available if Compare is transparent.
+   */
+  template <class K>
+  typename TreeIfTransparent<Compare, K, iterator>::type upper_bound( const K& key ){
+    return( iterator( this, upperBound( key ) ) );
+  }
+
+  /**
+   * The range of nodes whose key equals key; it holds at most one node.
+   * @param key The key to search for.
+   * @return The pair ( lower_bound( key ), upper_bound( key ) ).
+   */
+  std::pair<iterator, iterator> equal_range( const T& key ){
+    iterator lo = lower_bound( key );
+    iterator hi = lo;
+    if( hi != end( ) && ! less( key, hi->key( ) ) ){
+      ++hi;
     }
-    if( r ){
-      trim( r );
-      delete r;
+    return( std::make_pair( lo, hi ) );
+  }
+
+  /**
+   * Call f( key, value ) for every key in [lo, hi] in ascending order.
+   * This costs O(h + k) where h is the height of the tree and k the
+   * number of keys visited.
+   * @param lo The smallest key to visit.
+   * @param hi The largest key to visit.
+   * @param f The function object to call.
+   */
+  template <class F>
+  void for_each_in_range( const T& lo, const T& hi, F f ){
+    iterator i = lower_bound( lo );
+    iterator e = end( );
+    while( i != e && ! less( hi, i->key( ) ) ){
+      f( i->key( ), i->value( ) );
+      ++i;
     }
   }
 
-  void insertHelper( TreeNode<T, U>* n, T key ){
-    if( n->key( ) <= key ){
-      if( n->right( ) ){
-        insertHelper( n->right( ), key );
-      }else{
-        n->setRight( new TreeNode<T, U>( n, key ) );
-      }
-    }else{
-      if( n->left( ) ){
-        insertHelper( n->left( ), key );
+#ifdef TREE_ORDER_STATISTICS
+  /**
+   * The number of keys less than key; this is the position key has, or
+   * would have, in sorted order.
+   * @param key The key to rank.
+   * @return The number of keys less than key.
+   */
+  size_t rank( const T& key ){
+    size_t r = 0;
+    TreeNode<T, U>* x = _root;
+    while( x != NULL ){
+      if( less( x->key( ), key ) ){
+        r += subtreeSize( x->left( ) ) + 1;
+        x = x->right( );
       }else{
-        n->setLeft( new TreeNode<T, U>( n, key ) );
+        x = x->left( );
+      }
+    }
+    return( r );
+  }
+
+  /**
+   * Find the node holding the k-th smallest key, counting from 0.
+   * @param k The position in sorted order.
+   * @return The iterator to the node, end( ) if k is not less than size( ).
+   */
+  iterator select( size_t k ){
+    TreeNode<T, U>* x = _root;
+    while( x != NULL ){
+      size_t l = subtreeSize( x->left( ) );
+      if( k < l ){
+        x = x->left( );
+      }else if( k == l ){
+        break;
+      }else{
+        k -= l + 1;
+        x = x->right( );
+      }
+    }
+    return( iterator( this, x ) );
+  }
+
+  /**
+   * The number of keys in [lo, hi].
+   * @param lo The smallest key to count.
+   * @param hi The largest key to count.
+   * @return The number of keys k with lo <= k <= hi.
+   */
+  size_t count_range( const T& lo, const T& hi ){
+    if( less( hi, lo ) ){
+      return( 0 );
+    }
+    // Keys not greater than hi, less the keys less than lo.
+    size_t r = 0;
+    TreeNode<T, U>* x = _root;
+    while( x != NULL ){
+      if( less( hi, x->key( ) ) ){
+        x = x->left( );
+      }else{
+        r += subtreeSize( x->left( ) ) + 1;
+        x = x->right( );
+      }
+    }
+    return( r - rank( lo ) );
+  }
+#endif
+
+  bool hasKey( const T& key ){
+    return(lookup( key ));
+  }
+
+  /**
+   * Same as hasKey( key ) for a key of another type, such as a const
+   * char* in a tree of strings; only available if Compare is
+   * transparent, and no key of type T is built.
+   */
+  template <class K>
+  typename TreeIfTransparent<Compare, K, bool>::type hasKey( const K& key ){
+    return(find_iterative( _root, key ));
+  }
+
+  /**
+   * Look up a batch of keys.
+   * The batch is put in ascending order (by index, the keys are not
+   * moved) and each key's search starts from the last node of the
+   * previous search rather than from the root. Eight such finger
+   * searches run interleaved over stripes of the batch so that their
+   * cache misses overlap.
+   * @param keys The keys to search for.
+   * @param count The number of keys.
+   * @param found Receives true for each key in the tree, false otherwise.
+   * @return The number of keys found.
+   */
+  size_t find_many( const T* keys, size_t count, bool* found ){
+    std::vector<size_t> order;
+    std::vector<TreeNode<T, U>*> ends;
+    sortedOrder( keys, count, order );
+    descendMany( keys, order, ends );
+    size_t hits = 0;
+    for( size_t i = 0; i < count; i++ ){
+      TreeNode<T, U>* x = ends[i];
+      found[order[i]] = x != NULL && compare( keys[order[i]], x->key( ) ) == 0;
+      hits += found[order[i]];
+    }
+    return( hits );
+  }
+
+  /**
+   * Insert a batch of keys.
+   * The batch is put in ascending order and located with the same
+   * interleaved finger searches as find_many; each key is then linked
+   * below where its search ended. An empty tree is bulk loaded instead.
+   * As with insert, a key that is already in the tree, or repeated in
+   * the batch, keeps its first value.
+   * @param keys The keys to insert.
+   * @param values The value for each key.
+   * @param count The number of keys.
+   * @return The number of keys inserted.
+   */
+  size_t insert_many( const T* keys, const U* values, size_t count ){
+    std::vector<size_t> order;
+    sortedOrder( keys, count, order );
+    if( _root == NULL ){
+      std::vector<T> k;
+      std::vector<U> v;
+      k.reserve( count );
+      v.reserve( count );
+      for( size_t i = 0; i < count; i++ ){
+        if( i == 0 || less( k.back( ), keys[order[i]] ) ){
+          k.push_back( keys[order[i]] );
+          v.push_back( values[order[i]] );
+        }
+      }
+      build_from_sorted( k.begin( ), k.end( ), v.begin( ) );
+      return( k.size( ) );
+    }
+    std::vector<TreeNode<T, U>*> ends;
+    descendMany( keys, order, ends );
+    size_t inserted = 0;
+    TreeNode<T, U>* last = NULL;
+    bool lastLeft = false;
+    for( size_t i = 0; i < count; i++ ){
+      // Keys inserted earlier in the batch can only have filled the
+      // empty slot below ends[i], so the descent resumes there. If the
+      // key before this one filled the same slot, this key is greater
+      // than everything hung there and goes right of that key's node,
+      // so a sorted run into one gap is linked in linear time.
+      const T& k = keys[order[i]];
+      TreeNode<T, U>* x = ends[i];
+      bool left = less( k, x->key( ) );
+      if( last != NULL && i > 0 && ends[i - 1] == x && lastLeft == left ){
+        x = last;
+      }
+      last = NULL;
+      lastLeft = left;
+      for( ;; ){
+        int c = compare( k, x->key( ) );
+        if( c < 0 ){
+          if( ! x->left( ) ){
+            last = new TreeNode<T, U>( x, k, values[order[i]] );
+            x->setLeft( last );
+            break;
+          }
+          x = x->left( );
+        }else if( c > 0 ){
+          if( ! x->right( ) ){
+            last = new TreeNode<T, U>( x, k, values[order[i]] );
+            x->setRight( last );
+            break;
+          }
+          x = x->right( );
+        }else{
+          x = NULL;
+          break;
+        }
+      }
+      if( x != NULL ){
+#ifdef TREE_ORDER_STATISTICS
+        resizeUp( x );
+#endif
+        filterAdd( k );
+        inserted++;
+      }
+    }
+    adjustCount( inserted );
+    return( inserted );
+  }
+
+  /**
+   * Write the tree's contents to a compact binary image, the keys in
+   * ascending order followed by their values (see TreeImageHeader).
+   * T and U must be trivially copyable. Defined in MappedTree.h, which
+   * must be included to use it.
+   * @param path The file to write.
+   * @return True on success, false if the file could not be written.
+   */
+  bool save( const char* path );
+
+  /**
+   * Replace the contents of the tree with an image written by save.
+   * The image is mapped rather than read and the tree is bulk loaded
+   * from it. To query an image without building any nodes use
+   * MappedTree directly. T and U must be trivially copyable. Defined in
+   * MappedTree.h, which must be included to use it.
+   * @param path The file to read.
+   * @return True on success, false if path is not an image of a
+   *         Tree<T, U>; the tree is unchanged in that case.
+   */
+  bool load( const char* path );
+
+  /**
+   * Move the keys less than key into less and the keys greater than key
+   * into greater, leaving the tree empty. Nodes are relinked rather than
+   * copied, so this costs O(h) where h is the height of the tree.
+   * The old contents of less and greater are deleted.
+   * @param key The key to split at.
+   * @param less Receives the keys less than key.
+   * @param greater Receives the keys greater than key.
+   * @param value If not NULL, receives key's value when key is found.
+   * @return True if key was in the tree; its node is deleted.
+   */
+  bool split( const T& key, Tree& less, Tree& greater, U* value = NULL ){
+    assert( &less != this && &greater != this && &less != &greater );
+    less.clear( );
+    greater.clear( );
+    TreeNode<T, U>* l = NULL;
+    TreeNode<T, U>* r = NULL;
+    TreeNode<T, U>* hit = NULL;
+    splitAt( _root, key, l, r, hit );
+    less._root = detach( l );
+    greater._root = detach( r );
+#ifdef TREE_ORDER_STATISTICS
+    less._count = subtreeSize( l );
+    greater._count = subtreeSize( r );
+#else
+    less._count = l ? kUncounted : 0;
+    greater._count = r ? kUncounted : 0;
+#endif
+    _root = NULL;
+    _count = 0;
+    filterStale( );
+    if( hit == NULL ){
+      return( false );
+    }
+    if( value ){
+      *value = hit->value( );
+    }
+    delete hit;
+    return( true );
+  }
+
+  /**
+   * Replace the contents of the tree with the keys of less, key and the
+   * keys of greater, leaving less and greater empty. Every key in less
+   * must be less than key and every key in greater greater than it.
+   * This costs O(h). Split, join and the set operations below shape
+   * the trees they build as treaps whose priorities are a hash of the
+   * keys, so trees made only by them have O(log n) expected height
+   * whatever order the keys came in. Either argument may be the tree
+   * itself.
+   * @param less The keys less than key.
+   * @param key The key joining the two trees.
+   * @param value The value paired with key.
+   * @param greater The keys greater than key.
+   */
+  void join( Tree& less, const T& key, const U& value, Tree& greater ){
+    assert( less._root == NULL || _compare( less.local_maximum( less._root )->key( ), key ) );
+    assert( greater._root == NULL || _compare( key, greater.local_minimum( greater._root )->key( ) ) );
+    TreeNode<T, U>* l = less._root;
+    TreeNode<T, U>* r = greater._root;
+    size_t n = less._count == kUncounted || greater._count == kUncounted ?
+               kUncounted : less._count + greater._count + 1;
+    less._root = NULL;
+    less._count = 0;
+    greater._root = NULL;
+    greater._count = 0;
+    less.filterStale( );
+    greater.filterStale( );
+    clear( );
+    _root = detach( joinAt( l, new TreeNode<T, U>( key, value ), r ) );
+    _count = n;
+  }
+
+  /**
+   * Add the keys of other to the tree, leaving other empty. A key in
+   * both trees keeps the tree's value. The nodes of other are moved,
+   * not copied; the halves of the recursion near the root run on
+   * separate threads.
+   * For balanced trees of m and n keys, m <= n, the work is
+   * O(m log(n/m + 1)).
+   * @param other The keys to add; it must not be the tree itself.
+   * @param threads The number of threads to use; 0 picks one per core.
+   */
+  void unite( Tree& other, unsigned threads = 0 ){
+    assert( &other != this );
+    std::atomic<size_t> common( 0 );
+    size_t n = _count == kUncounted || other._count == kUncounted ?
+               kUncounted : _count + other._count;
+    _root = detach( uniteAt( _root, other._root, forkDepth( threads ), 0, common ) );
+    other._root = NULL;
+    other._count = 0;
+    other.filterStale( );
+    filterStale( );
+    _count = n == kUncounted ? n : n - common.load( );
+  }
+
+  /**
+   * Add the keys of other to the tree, leaving other empty, and rebuild
+   * the result perfectly balanced. Both trees are flattened into sorted
+   * lists of their nodes, the lists are merged and the nodes relinked,
+   * so this costs O(m + n) whatever the shapes of the trees and moves
+   * no keys or values. A key in both trees keeps the tree's value.
+   * Prefer unite when other is much smaller than the tree.
+   * @param other The keys to add; it must not be the tree itself.
+   */
+  void merge( Tree& other ){
+    assert( &other != this );
+    std::vector<TreeNode<T, U>*> a;
+    std::vector<TreeNode<T, U>*> b;
+    flatten( _root, a );
+    flatten( other._root, b );
+    std::vector<TreeNode<T, U>*> m;
+    m.reserve( a.size( ) + b.size( ) );
+    size_t i = 0;
+    size_t j = 0;
+    while( i < a.size( ) && j < b.size( ) ){
+      int c = compare( a[i]->key( ), b[j]->key( ) );
+      if( c < 0 ){
+        m.push_back( a[i++] );
+      }else if( c > 0 ){
+        m.push_back( b[j++] );
+      }else{
+        m.push_back( a[i++] );
+        delete b[j++];
+      }
+    }
+    m.insert( m.end( ), a.begin( ) + i, a.end( ) );
+    m.insert( m.end( ), b.begin( ) + j, b.end( ) );
+    _root = relink( m, 0, m.size( ), NULL );
+    _count = m.size( );
+    other._root = NULL;
+    other._count = 0;
+    other.filterStale( );
+    filterStale( );
+  }
+
+  /**
+   * Keep only the keys that are also in other, leaving other empty.
+   * Runs like unite.
+   * @param other The keys to keep; it must not be the tree itself.
+   * @param threads The number of threads to use; 0 picks one per core.
+   */
+  void intersect( Tree& other, unsigned threads = 0 ){
+    assert( &other != this );
+    std::atomic<size_t> common( 0 );
+    _root = detach( intersectAt( _root, other._root, forkDepth( threads ), 0, common ) );
+    other._root = NULL;
+    other._count = 0;
+    other.filterStale( );
+    filterStale( );
+    _count = common.load( );
+  }
+
+  /**
+   * Remove the keys that are in other, leaving other empty.
+   * Runs like unite.
+   * @param other The keys to remove; it must not be the tree itself.
+   * @param threads The number of threads to use; 0 picks one per core.
+   */
+  void subtract( Tree& other, unsigned threads = 0 ){
+    assert( &other != this );
+    std::atomic<size_t> common( 0 );
+    _root = detach( subtractAt( _root, other._root, forkDepth( threads ), 0, common ) );
+    other._root = NULL;
+    other._count = 0;
+    other.filterStale( );
+    filterStale( );
+    _count = _count == kUncounted ? _count : _count - common.load( );
+  }
+
+  T inorderSuccessorTest( T key ){
+    TreeNode<T, U>* x = find_iterative( _root, key );
+    TreeNode<T, U>* y = inorderSuccessor( x );
+    return(y->key( ));
+  }
+
+  /**
+   * Take a read-only snapshot of the tree in Eytzinger order.
+   * The snapshot does not share any storage with the tree, so the
+   * tree may be changed or destroyed afterwards.
+   * @return The snapshot.
+   */
+  FrozenTree<T, U, Compare> freeze( ){
+    std::vector<T> keys;
+    std::vector<U> values;
+    keys.reserve( size( ) );
+    values.reserve( size( ) );
+    TreeNode<T, U>* n = _root ? local_minimum( _root ) : NULL;
+    while( n != NULL ){
+      keys.push_back( n->key( ) );
+      values.push_back( n->value( ) );
+      n = successor( n );
+    }
+    assert( keys.size( ) == size( ) );
+    return( FrozenTree<T, U, Compare>( keys.empty( ) ? NULL : &keys[0],
+                                       values.empty( ) ? NULL : &values[0],
+                                       keys.size( ), _compare ) );
+  }
+
+private:
+ /**
+  * Private pointer to the root of the tree.
+  */
+  TreeNode<T, U>* _root;
+
+ /**
+  * The number of keys in the tree, kUncounted if it is not known.
+  */
+  mutable size_t _count;
+
+ /**
+  * The function object that orders the keys.
+  */
+  Compare _compare;
+
+  static const size_t kUncounted = size_t( -1 );
+
+  /**
+   * The filter in front of the lookups, NULL if there is none.
+   */
+  TreeBloomFilter<T, Hash>* _filter;
+
+  /**
+   * True if the filter no longer covers every key and must be rebuilt
+   * before it is used.
+   */
+  bool _filterStale;
+
+  /**
+   * find_iterative from the root, answering from the filter when it
+   * rules key out.
+   */
+  TreeNode<T, U>* lookup( const T& key ){
+    if( _filter != NULL ){
+      if( _filterStale || _filter->worn( ) ){
+        rebuildFilter( );
+      }
+      if( ! _filter->mayContain( key ) ){
+        return( NULL );
+      }
+    }
+    return( find_iterative( _root, key ) );
+  }
+
+  /**
+   * Size the filter for twice the keys in the tree and add them all.
+   */
+  void rebuildFilter( ){
+    size_t n = size( );
+    _filter->reset( 2 * n > 1024 ? 2 * n : 1024 );
+    for( iterator i = begin( ); i != end( ); ++i ){
+      _filter->add( i->key( ) );
+    }
+    _filterStale = false;
+  }
+
+  void filterAdd( const T& key ){
+    if( _filter != NULL && ! _filterStale ){
+      _filter->add( key );
+    }
+  }
+
+  void filterRemoved( ){
+    if( _filter != NULL ){
+      _filter->removed( );
+    }
+  }
+
+  void filterStale( ){
+    _filterStale = true;
+  }
+
+  template <class A, class B>
+  bool less( const A& a, const B& b ) const{
+    return( _compare( a, b ) );
+  }
+
+  /**
+   * Negative if a comes before b, positive if after and 0 if neither.
+   */
+  template <class A, class B>
+  int compare( const A& a, const B& b ) const{
+    return( TreeThreeWay<Compare>::compare( _compare, a, b ) );
+  }
+
+  void adjustCount( long delta ){
+    if( _count != kUncounted ){
+      _count += delta;
+    }
+  }
+  
+  // The recursion in find_recursive is a tail call; it is written as
+  // a loop so that a degenerate tree cannot overflow the stack.
+  template <class K>
+  TreeNode<T, U>* find_recursive( TreeNode<T, U>* t, const K& key ){
+    int c;
+    while( t != NULL && (c = compare( key, t->key( ) )) != 0 ){
+      if( c < 0 ){
+        t = t->left( );
+      }else{
+        // if key > k
+        t = t->right( );
+      }
+    }
+    return( t );
+  }
+  
+  // One three way comparison per level, so a string key is scanned
+  // once per node rather than once for == and again for >.
+  template <class K>
+  TreeNode<T, U>* find_iterative( TreeNode<T, U>* t, const K& key ) const{
+    int c;
+    while( t != NULL && (c = compare( key, t->key( ) )) != 0 ){
+      if( c > 0 ){
+        t = t->right( );
+      }else{
+        t = t->left( );
+      }
+    }
+    return( t );
+  }
+
+  template <class K>
+  TreeNode<T, U>* lowerBound( const K& key ) const{
+    TreeNode<T, U>* x = _root;
+    TreeNode<T, U>* y = NULL;
+    while( x != NULL ){
+      if( less( x->key( ), key ) ){
+        x = x->right( );
+      }else{
+        y = x;
+        x = x->left( );
+      }
+    }
+    return( y );
+  }
+
+  template <class K>
+  TreeNode<T, U>* upperBound( const K& key ) const{
+    TreeNode<T, U>* x = _root;
+    TreeNode<T, U>* y = NULL;
+    while( x != NULL ){
+      if( less( key, x->key( ) ) ){
+        y = x;
+        x = x->left( );
+      }else{
+        x = x->right( );
+      }
+    }
+    return( y );
+  }
+  
+  TreeNode<T, U>* inorderSuccessor( TreeNode<T, U>* n ){
+    TreeNode<T, U>* ios = NULL;
+    TreeNode<T, U>* tmp = NULL;
+    if( n->right( ) != NULL ){
+      ios = local_minimum( n->right( ) );
+      assert( ios );
+    }else{
+      ios = n->parent( );
+      tmp = n;
+      while( ios != NULL && tmp == ios->right( ) ){
+        tmp = ios;
+        ios = ios->parent( );
+      }
+      if( ios == NULL ){
+	// if ios is null then ios is the tree's max.
+	// return (the original) n as the ios.
+        ios = n;
+      }
+    }
+    return( ios );
+  }
+  
+  /**
+   * Adapts a sequence of (key, value) pairs for build( ).
+   */
+  template <class PairIter>
+  struct PairSource{
+    PairIter _begin;
+    explicit PairSource( PairIter begin ) : _begin( begin ) { }
+    const T& key( size_t i ) const{ return( _begin[i].first ); }
+    const U& value( size_t i ) const{ return( _begin[i].second ); }
+  };
+
+  /**
+   * Adapts parallel key and value sequences for build( ).
+   */
+  template <class KeyIter, class ValueIter>
+  struct SplitSource{
+    KeyIter _keys;
+    ValueIter _values;
+    SplitSource( KeyIter keys, ValueIter values ) :
+    _keys( keys ), _values( values ) { }
+    const T& key( size_t i ) const{ return( _keys[i] ); }
+    const U& value( size_t i ) const{ return( _values[i] ); }
+  };
+
+  template <class Source>
+  void build( const Source& src, size_t n, unsigned threads ){
+    clear( );
+    _root = link( src, 0, n, NULL, forkDepth( threads ) );
+    _count = n;
+  }
+
+  typedef std::pair<T, U> Item;
+
+  /**
+   * Sort and deduplicate the items of src, then link them as build does.
+   */
+  template <class Source>
+  void buildUnsorted( const Source& src, size_t n, unsigned threads ){
+    // Below this many items per thread the threads cost more than they save.
+    const size_t kMinChunk = 65536;
+    unsigned workers = threads ? threads : std::thread::hardware_concurrency( );
+    if( workers == 0 ){
+      workers = 1;
+    }
+    if( workers > n / kMinChunk + 1 ){
+      workers = unsigned( n / kMinChunk + 1 );
+    }
+    std::vector<Item> items( n );
+    onThreads( workers, [&]( unsigned w ){
+      for( size_t i = n * w / workers; i < n * (w + 1) / workers; i++ ){
+        items[i].first = src.key( i );
+        items[i].second = src.value( i );
+      }
+    } );
+    sortItems( items, workers, std::integral_constant<bool,
+               std::is_integral<T>::value && ! std::is_same<T, bool>::value &&
+               std::is_same<Compare, std::less<T> >::value>( ) );
+    // The sorts are stable, so the first of a run of equal keys is the
+    // one that came first.
+    size_t m = 0;
+    for( size_t i = 0; i < n; i++ ){
+      if( m == 0 || less( items[m - 1].first, items[i].first ) ){
+        if( m != i ){
+          items[m] = std::move( items[i] );
+        }
+        m++;
+      }
+    }
+    PairSource<typename std::vector<Item>::const_iterator> sorted( items.begin( ) );
+    build( sorted, m, threads );
+  }
+
+  /**
+   * Call f( w ) for w = 0 .. workers - 1, each on its own thread; the
+   * last runs on this one.
+   */
+  template <class F>
+  static void onThreads( unsigned workers, F f ){
+    std::vector<std::thread> pool;
+    for( unsigned w = 0; w + 1 < workers; w++ ){
+      pool.push_back( std::thread( f, w ) );
+    }
+    f( workers - 1 );
+    for( size_t i = 0; i < pool.size( ); i++ ){
+      pool[i].join( );
+    }
+  }
+
+  /**
+   * Stable least significant digit radix sort of integer keys, a byte
+   * per pass. Each thread counts the digits of its share of the items
+   * and then scatters them to the places the counts give it, so the
+   * items of one thread stay in order behind those of the threads
+   * before it. A pass in which every key has the same digit is skipped.
+   */
+  void sortItems( std::vector<Item>& items, unsigned workers, std::true_type ){
+    typedef typename std::make_unsigned<T>::type Bits;
+    const Bits flip = std::is_signed<T>::value ? Bits( Bits( 1 ) << (8 * sizeof(T) - 1) ) : 0;
+    size_t n = items.size( );
+    std::vector<Item> other( n );
+    std::vector<size_t> at( size_t( workers ) * 256 );
+    for( unsigned shift = 0; shift < 8 * sizeof(T); shift += 8 ){
+      onThreads( workers, [&]( unsigned w ){
+        size_t* c = &at[w * 256];
+        std::fill( c, c + 256, 0 );
+        for( size_t i = n * w / workers; i < n * (w + 1) / workers; i++ ){
+          c[((Bits( items[i].first ) ^ flip) >> shift) & 0xff]++;
+        }
+      } );
+      size_t sum = 0;
+      bool skip = false;
+      for( unsigned d = 0; d < 256; d++ ){
+        size_t start = sum;
+        for( unsigned w = 0; w < workers; w++ ){
+          size_t c = at[w * 256 + d];
+          at[w * 256 + d] = sum;
+          sum += c;
+        }
+        skip = skip || sum - start == n;
+      }
+      if( skip ){
+        continue;
+      }
+      onThreads( workers, [&]( unsigned w ){
+        size_t* c = &at[w * 256];
+        for( size_t i = n * w / workers; i < n * (w + 1) / workers; i++ ){
+          other[c[((Bits( items[i].first ) ^ flip) >> shift) & 0xff]++] = std::move( items[i] );
+        }
+      } );
+      items.swap( other );
+    }
+  }
+
+  struct ItemLess{
+    const Compare& _compare;
+    explicit ItemLess( const Compare& compare ) : _compare( compare ) { }
+    bool operator ( )( const Item& a, const Item& b ) const{
+      return( _compare( a.first, b.first ) );
+    }
+  };
+
+  /**
+   * Stable merge sort: each thread sorts a share of the items, then
+   * the sorted runs are merged in pairs, the merges of a round running
+   * on separate threads, until one run is left.
+   */
+  void sortItems( std::vector<Item>& items, unsigned workers, std::false_type ){
+    size_t n = items.size( );
+    std::vector<size_t> bound( workers + 1 );
+    for( unsigned w = 0; w <= workers; w++ ){
+      bound[w] = n * w / workers;
+    }
+    ItemLess byKey( _compare );
+    onThreads( workers, [&]( unsigned w ){
+      std::stable_sort( items.begin( ) + bound[w], items.begin( ) + bound[w + 1], byKey );
+    } );
+    std::vector<Item> other( workers > 1 ? n : 0 );
+    for( unsigned width = 1; width < workers; width *= 2 ){
+      unsigned merges = (workers + 2 * width - 1) / (2 * width);
+      onThreads( merges, [&]( unsigned g ){
+        size_t lo = bound[2 * width * g];
+        size_t mid = bound[std::min( workers, 2 * width * g + width )];
+        size_t hi = bound[std::min( workers, 2 * width * (g + 1) )];
+        std::merge( std::make_move_iterator( items.begin( ) + lo ),
+                    std::make_move_iterator( items.begin( ) + mid ),
+                    std::make_move_iterator( items.begin( ) + mid ),
+                    std::make_move_iterator( items.begin( ) + hi ),
+                    other.begin( ) + lo, byKey );
+      } );
+      items.swap( other );
+    }
+  }
+
+  /**
+   * How many levels of a recursion to run on new threads so that there
+   * is a subtree for every thread.
+   * @param threads The number of threads; 0 means one per core.
+   */
+  static unsigned forkDepth( unsigned threads ){
+    if( threads == 0 ){
+      threads = std::thread::hardware_concurrency( );
+    }
+    unsigned depth = 0;
+    while( depth < 16 && (1u << depth) < threads ){
+      depth++;
+    }
+    return( depth );
+  }
+
+  /**
+   * Link the items [lo, hi) of src into a balanced subtree.
+   * The middle item becomes the subtree's root so the recursion is only
+   * log(n) deep. While forks is not zero the left half is linked on a
+   * new thread.
+   * @return The root of the subtree, NULL if the range is empty.
+   */
+  template <class Source>
+  TreeNode<T, U>* link( const Source& src, size_t lo, size_t hi,
+                        TreeNode<T, U>* parent, unsigned forks ){
+    if( lo >= hi ){
+      return( NULL );
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    assert( lo == mid || less( src.key( mid - 1 ), src.key( mid ) ) );
+    TreeNode<T, U>* n = new TreeNode<T, U>( parent, src.key( mid ), src.value( mid ) );
+    TreeNode<T, U>* l = NULL;
+    if( forks > 0 && mid - lo > 1024 ){
+      std::thread worker( [&]( ){ l = link( src, lo, mid, n, forks - 1 ); } );
+      n->setRight( link( src, mid + 1, hi, n, forks - 1 ) );
+      worker.join( );
+    }else{
+      l = link( src, lo, mid, n, 0 );
+      n->setRight( link( src, mid + 1, hi, n, 0 ) );
+    }
+    n->setLeft( l );
+#ifdef TREE_ORDER_STATISTICS
+    n->setSubtreeSize( hi - lo );
+#endif
+    return( n );
+  }
+
+  /**
+   * The priority of n's key in the treaps built by join; a 64 bit mix
+   * of its hash so that nearby keys get unrelated priorities.
+   */
+  static uint64_t priority( TreeNode<T, U>* n ){
+    static_assert( ! std::is_same<Hash, TreeNoHash<T> >::value,
+                   "split, join and the set operations need a Hash for the keys" );
+    uint64_t h = Hash( )( n->key( ) );
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return( h );
+  }
+
+  /**
+   * Make l and r the children of n.
+   * @return n.
+   */
+  static TreeNode<T, U>* attach( TreeNode<T, U>* n, TreeNode<T, U>* l, TreeNode<T, U>* r ){
+    n->setLeft( l );
+    n->setRight( r );
+    if( l ){
+      l->setParent( n );
+    }
+    if( r ){
+      r->setParent( n );
+    }
+#ifdef TREE_ORDER_STATISTICS
+    n->setSubtreeSize( 1 + subtreeSize( l ) + subtreeSize( r ) );
+#endif
+    return( n );
+  }
+
+  /**
+   * Make n a root.
+   * @return n.
+   */
+  static TreeNode<T, U>* detach( TreeNode<T, U>* n ){
+    if( n ){
+      n->setParent( NULL );
+    }
+    return( n );
+  }
+
+  /**
+   * Split the subtree t into the keys less than key, l, and the keys
+   * greater than key, r. The node holding key, if any, is put in hit
+   * and left out of both. The parent links of l and r are stale.
+   * The search path is walked once from the top: each node on it is
+   * hung from the open right slot of the last node given to l, or the
+   * open left slot of the last node given to r, so a chain of any
+   * length is split without recursion.
+   */
+  void splitAt( TreeNode<T, U>* t, const T& key, TreeNode<T, U>*& l,
+                TreeNode<T, U>*& r, TreeNode<T, U>*& hit ){
+    TreeNode<T, U>* lHook = NULL;
+    TreeNode<T, U>* rHook = NULL;
+    TreeNode<T, U>* lRest = NULL;
+    TreeNode<T, U>* rRest = NULL;
+    l = NULL;
+    r = NULL;
+    while( t != NULL ){
+      int c = compare( key, t->key( ) );
+      if( c < 0 ){
+        hang( r, rHook, false, t );
+        rHook = t;
+        t = t->left( );
+      }else if( c > 0 ){
+        hang( l, lHook, true, t );
+        lHook = t;
+        t = t->right( );
+      }else{
+        hit = t;
+        lRest = t->left( );
+        rRest = t->right( );
+        break;
+      }
+    }
+    hang( l, lHook, true, lRest );
+    hang( r, rHook, false, rRest );
+    resizePath( lHook, l );
+    resizePath( rHook, r );
+  }
+
+  /**
+   * Join l, the node m and r, whose keys are in that order. m goes
+   * down the spine of whichever side has the higher priority root until
+   * its own priority is the highest; the roots it passes keep their
+   * places, one step of the descent each, without recursion.
+   * @return The root of the joined subtree.
+   */
+  static TreeNode<T, U>* joinAt( TreeNode<T, U>* l, TreeNode<T, U>* m, TreeNode<T, U>* r ){
+    TreeNode<T, U>* root = NULL;
+    TreeNode<T, U>* hook = NULL;
+    bool right = false;
+    uint64_t pm = priority( m );
+    for( ;; ){
+      uint64_t pl = l ? priority( l ) : 0;
+      uint64_t pr = r ? priority( r ) : 0;
+      if( (l == NULL || pl < pm) && (r == NULL || pr < pm) ){
+        hang( root, hook, right, attach( m, l, r ) );
+        break;
+      }
+      if( r == NULL || (l != NULL && pr < pl) ){
+        hang( root, hook, right, l );
+        hook = l;
+        right = true;
+        l = l->right( );
+      }else{
+        hang( root, hook, right, r );
+        hook = r;
+        right = false;
+        r = r->left( );
+      }
+    }
+    resizePath( hook, root );
+    return( root );
+  }
+
+  /**
+   * Join l and r, whose keys are in that order, without a middle node.
+   * @return The root of the joined subtree.
+   */
+  static TreeNode<T, U>* joinAt( TreeNode<T, U>* l, TreeNode<T, U>* r ){
+    TreeNode<T, U>* root = NULL;
+    TreeNode<T, U>* hook = NULL;
+    bool right = false;
+    while( l != NULL && r != NULL ){
+      if( priority( r ) < priority( l ) ){
+        hang( root, hook, right, l );
+        hook = l;
+        right = true;
+        l = l->right( );
+      }else{
+        hang( root, hook, right, r );
+        hook = r;
+        right = false;
+        r = r->left( );
+      }
+    }
+    hang( root, hook, right, l ? l : r );
+    resizePath( hook, root );
+    return( root );
+  }
+
+  /**
+   * Put n in the right slot of hook if right, else in its left slot, or
+   * make it root if there is no hook yet.
+   */
+  static void hang( TreeNode<T, U>*& root, TreeNode<T, U>* hook, bool right,
+                    TreeNode<T, U>* n ){
+    if( hook == NULL ){
+      root = n;
+    }else if( right ){
+      hook->setRight( n );
+    }else{
+      hook->setLeft( n );
+    }
+    if( n && hook ){
+      n->setParent( hook );
+    }
+  }
+
+  /**
+   * Recount the subtree sizes from n up to root after splitAt or
+   * joinAt has changed the children along that path.
+   */
+#ifdef TREE_ORDER_STATISTICS
+  static void resizePath( TreeNode<T, U>* n, TreeNode<T, U>* root ){
+    while( n != NULL ){
+      n->setSubtreeSize( 1 + subtreeSize( n->left( ) ) + subtreeSize( n->right( ) ) );
+      n = n == root ? NULL : n->parent( );
+    }
+  }
+#else
+  static void resizePath( TreeNode<T, U>*, TreeNode<T, U>* ){ }
+#endif
+
+  /**
+   * Run left( ) on a new thread and right( ) on this one while forks
+   * is not zero, otherwise run both here.
+   */
+  template <class Left, class Right>
+  static void inParallel( unsigned forks, Left left, Right right ){
+    if( forks > 0 ){
+      std::thread worker( left );
+      right( );
+      worker.join( );
+    }else{
+      left( );
+      right( );
+    }
+  }
+
+  /**
+   * The union of the subtrees a and b; a's node wins a tie, b's is
+   * deleted. The root with the higher priority becomes the root of the
+   * result and the other tree is split around it.
+   */
+  TreeNode<T, U>* uniteAt( TreeNode<T, U>* a, TreeNode<T, U>* b, unsigned forks,
+                           unsigned depth, std::atomic<size_t>& common ){
+    if( a == NULL ){
+      return( b );
+    }
+    if( b == NULL ){
+      return( a );
+    }
+    if( depth >= kMaxSetDepth ){
+      return( combineFlat( a, b, kUnite, common ) );
+    }
+    TreeNode<T, U>* m;
+    TreeNode<T, U>* al;
+    TreeNode<T, U>* ar;
+    TreeNode<T, U>* bl;
+    TreeNode<T, U>* br;
+    if( priority( b ) < priority( a ) ){
+      m = a;
+      al = a->left( );
+      ar = a->right( );
+      TreeNode<T, U>* hit = NULL;
+      splitAt( b, a->key( ), bl, br, hit );
+      if( hit ){
+        delete hit;
+        common++;
+      }
+    }else{
+      m = b;
+      bl = b->left( );
+      br = b->right( );
+      TreeNode<T, U>* hit = NULL;
+      splitAt( a, b->key( ), al, ar, hit );
+      if( hit ){
+        // Keep a's node, and so a's value, in b's place.
+        delete m;
+        m = hit;
+        common++;
+      }
+    }
+    TreeNode<T, U>* l = NULL;
+    TreeNode<T, U>* r = NULL;
+    unsigned next = forks > 0 ? forks - 1 : 0;
+    inParallel( forks, [&]( ){ l = uniteAt( al, bl, next, depth + 1, common ); },
+                 [&]( ){ r = uniteAt( ar, br, next, depth + 1, common ); } );
+    return( joinAt( l, m, r ) );
+  }
+
+  /**
+   * The keys of the subtree a that are also in the subtree b, with a's
+   * nodes; every other node of a and b is deleted.
+   */
+  TreeNode<T, U>* intersectAt( TreeNode<T, U>* a, TreeNode<T, U>* b, unsigned forks,
+                               unsigned depth, std::atomic<size_t>& common ){
+    if( a == NULL || b == NULL ){
+      if( a ){
+        trim( a );
+      }
+      if( b ){
+        trim( b );
+      }
+      return( NULL );
+    }
+    if( depth >= kMaxSetDepth ){
+      return( combineFlat( a, b, kIntersect, common ) );
+    }
+    TreeNode<T, U>* bl;
+    TreeNode<T, U>* br;
+    TreeNode<T, U>* hit = NULL;
+    splitAt( b, a->key( ), bl, br, hit );
+    TreeNode<T, U>* al = a->left( );
+    TreeNode<T, U>* ar = a->right( );
+    TreeNode<T, U>* l = NULL;
+    TreeNode<T, U>* r = NULL;
+    unsigned next = forks > 0 ? forks - 1 : 0;
+    inParallel( forks, [&]( ){ l = intersectAt( al, bl, next, depth + 1, common ); },
+                 [&]( ){ r = intersectAt( ar, br, next, depth + 1, common ); } );
+    if( hit ){
+      delete hit;
+      common++;
+      return( joinAt( l, a, r ) );
+    }
+    delete a;
+    return( joinAt( l, r ) );
+  }
+
+  /**
+   * The keys of the subtree a that are not in the subtree b; every node
+   * of b and every node of a holding a key of b is deleted.
+   */
+  TreeNode<T, U>* subtractAt( TreeNode<T, U>* a, TreeNode<T, U>* b, unsigned forks,
+                              unsigned depth, std::atomic<size_t>& common ){
+    if( a == NULL || b == NULL ){
+      if( b ){
+        trim( b );
+      }
+      return( a );
+    }
+    if( depth >= kMaxSetDepth ){
+      return( combineFlat( a, b, kSubtract, common ) );
+    }
+    TreeNode<T, U>* bl;
+    TreeNode<T, U>* br;
+    TreeNode<T, U>* hit = NULL;
+    splitAt( b, a->key( ), bl, br, hit );
+    TreeNode<T, U>* al = a->left( );
+    TreeNode<T, U>* ar = a->right( );
+    TreeNode<T, U>* l = NULL;
+    TreeNode<T, U>* r = NULL;
+    unsigned next = forks > 0 ? forks - 1 : 0;
+    inParallel( forks, [&]( ){ l = subtractAt( al, bl, next, depth + 1, common ); },
+                 [&]( ){ r = subtractAt( ar, br, next, depth + 1, common ); } );
+    if( hit ){
+      delete hit;
+      delete a;
+      common++;
+      return( joinAt( l, r ) );
+    }
+    return( joinAt( l, a, r ) );
+  }
+
+  /**
+   * The set operations recurse once per level of their inputs, which is
+   * O(log n) for the treaps they build but O(n) for a tree grown by
+   * inserting sorted keys. Below this depth the inputs can not be
+   * treaps, and the rest of the operation is done by combineFlat.
+   */
+  static const unsigned kMaxSetDepth = 256;
+
+  enum SetOperation{ kUnite, kIntersect, kSubtract };
+
+  /**
+   * The same result as uniteAt, intersectAt or subtractAt, found by
+   * flattening a and b into sorted lists of their nodes and merging
+   * them, without recursion. The nodes kept are linked into a treap by
+   * treapify, so the result has the shape the recursive version would
+   * have given it. Costs O(m + n).
+   */
+  TreeNode<T, U>* combineFlat( TreeNode<T, U>* a, TreeNode<T, U>* b, SetOperation op,
+                               std::atomic<size_t>& common ){
+    std::vector<TreeNode<T, U>*> x;
+    std::vector<TreeNode<T, U>*> y;
+    std::vector<TreeNode<T, U>*> m;
+    flatten( detach( a ), x );
+    flatten( detach( b ), y );
+    m.reserve( op == kUnite ? x.size( ) + y.size( ) : x.size( ) );
+    size_t i = 0;
+    size_t j = 0;
+    size_t hits = 0;
+    while( i < x.size( ) && j < y.size( ) ){
+      int c = compare( x[i]->key( ), y[j]->key( ) );
+      if( c < 0 ){
+        if( op == kIntersect ){
+          delete x[i];
+        }else{
+          m.push_back( x[i] );
+        }
+        i++;
+      }else if( c > 0 ){
+        if( op == kUnite ){
+          m.push_back( y[j] );
+        }else{
+          delete y[j];
+        }
+        j++;
+      }else{
+        if( op == kSubtract ){
+          delete x[i];
+        }else{
+          m.push_back( x[i] );
+        }
+        delete y[j];
+        hits++;
+        i++;
+        j++;
+      }
+    }
+    for( ; i < x.size( ); i++ ){
+      if( op == kIntersect ){
+        delete x[i];
+      }else{
+        m.push_back( x[i] );
+      }
+    }
+    for( ; j < y.size( ); j++ ){
+      if( op == kUnite ){
+        m.push_back( y[j] );
+      }else{
+        delete y[j];
+      }
+    }
+    common += hits;
+    return( treapify( m ) );
+  }
+
+  /**
+   * Link nodes, which are in key order, into the treap with the
+   * priorities of priority( ). The right spine of the treap built so
+   * far is kept on a stack; each node pops the spine nodes of lower
+   * priority, which become its left subtree, and goes on the spine.
+   * A node popped off the spine is finished, since nothing more will
+   * go in its subtree.
+   * @return The root of the treap, NULL if nodes is empty.
+   */
+  static TreeNode<T, U>* treapify( const std::vector<TreeNode<T, U>*>& nodes ){
+    std::vector<TreeNode<T, U>*> spine;
+    std::vector<uint64_t> priorities;
+    for( size_t i = 0; i < nodes.size( ); i++ ){
+      TreeNode<T, U>* n = nodes[i];
+      uint64_t p = priority( n );
+      TreeNode<T, U>* last = NULL;
+      while( ! spine.empty( ) && priorities.back( ) < p ){
+        last = spine.back( );
+        attach( last, last->left( ), last->right( ) );
+        spine.pop_back( );
+        priorities.pop_back( );
+      }
+      n->setLeft( last );
+      n->setRight( NULL );
+      if( ! spine.empty( ) ){
+        spine.back( )->setRight( n );
+      }
+      spine.push_back( n );
+      priorities.push_back( p );
+    }
+    TreeNode<T, U>* root = spine.empty( ) ? NULL : spine.front( );
+    while( ! spine.empty( ) ){
+      TreeNode<T, U>* last = spine.back( );
+      attach( last, last->left( ), last->right( ) );
+      spine.pop_back( );
+    }
+    return( detach( root ) );
+  }
+
+  struct KeyOf{
+    typedef T type;
+    T operator ( )( const TreeNode<T, U>& n ) const{ return( n.key( ) ); }
+  };
+
+  struct ValueOf{
+    typedef U type;
+    U operator ( )( const TreeNode<T, U>& n ) const{ return( n.value( ) ); }
+  };
+
+  /**
+   * Write field( n ) for every node n in key order, in chunks.
+   */
+  template <class Field>
+  void writeImageArray( std::ostream& out, Field field ){
+    const size_t kChunk = 8192;
+    std::vector<typename Field::type> chunk;
+    chunk.reserve( kChunk );
+    for( iterator i = begin( ); i != end( ); ++i ){
+      chunk.push_back( field( *i ) );
+      if( chunk.size( ) == kChunk ){
+        out.write( reinterpret_cast<const char*>( &chunk[0] ),
+                   chunk.size( ) * sizeof(chunk[0]) );
+        chunk.clear( );
+      }
+    }
+    if( ! chunk.empty( ) ){
+      out.write( reinterpret_cast<const char*>( &chunk[0] ),
+                 chunk.size( ) * sizeof(chunk[0]) );
+    }
+  }
+
+  /**
+   * The state of one of find_many's interleaved finger searches.
+   */
+  struct Finger{
+    TreeNode<T, U>* x;
+    size_t i;
+    size_t end;
+  };
+
+  /**
+   * Run the searches for keys[order[0]], keys[order[1]], ... and
+   * record in ends[i] the node where the search for keys[order[i]]
+   * stopped: the node holding the key, or the node below which the key
+   * would be linked. All entries are NULL for an empty tree.
+   * Eight finger searches run over stripes of the batch and advance one
+   * level each in turn, so their cache misses overlap.
+   */
+  void descendMany( const T* keys, const std::vector<size_t>& order,
+                    std::vector<TreeNode<T, U>*>& ends ){
+    const size_t kStripes = 8;
+    size_t count = order.size( );
+    ends.assign( count, NULL );
+    if( _root == NULL ){
+      return;
+    }
+    Finger f[kStripes];
+    size_t active = 0;
+    for( size_t s = 0; s < kStripes; s++ ){
+      f[s].i = count * s / kStripes;
+      f[s].end = count * (s + 1) / kStripes;
+      f[s].x = _root;
+      active += f[s].i < f[s].end;
+    }
+    while( active > 0 ){
+      for( size_t s = 0; s < kStripes; s++ ){
+        Finger& g = f[s];
+        if( g.i >= g.end ){
+          continue;
+        }
+        const T& k = keys[order[g.i]];
+        TreeNode<T, U>* x = g.x;
+        TreeNode<T, U>* next = NULL;
+        int c = compare( k, x->key( ) );
+        if( c < 0 ){
+          next = x->left( );
+        }else if( c > 0 ){
+          next = x->right( );
+        }
+        if( next != NULL ){
+          TREE_PREFETCH( next );
+          g.x = next;
+          continue;
+        }
+        ends[g.i] = x;
+        if( ++g.i < g.end ){
+          g.x = fingerStart( x, keys[order[g.i]] );
+        }else{
+          active--;
+        }
+      }
+    }
+  }
+
+  /**
+   * Fill order with the indices of keys in ascending key order.
+   */
+  void sortedOrder( const T* keys, size_t count, std::vector<size_t>& order ){
+    order.resize( count );
+    bool sorted = true;
+    for( size_t i = 0; i < count; i++ ){
+      order[i] = i;
+      if( i > 0 && less( keys[i], keys[i - 1] ) ){
+        sorted = false;
+      }
+    }
+    if( ! sorted ){
+      std::stable_sort( order.begin( ), order.end( ), IndexLess( keys, _compare ) );
+    }
+  }
+
+  struct IndexLess{
+    const T* _keys;
+    const Compare& _compare;
+    IndexLess( const T* keys, const Compare& compare ) :
+    _keys( keys ), _compare( compare ) { }
+    bool operator ( )( size_t a, size_t b ) const{
+      return( _compare( _keys[a], _keys[b] ) );
+    }
+  };
+
+  /**
+   * Where a search for key should start, given that the previous search
+   * for a key not greater than key ended at f.
+   * Climbs from f until key falls inside the subtree of the node reached,
+   * which costs O(log d) for keys d positions apart.
+   * @return The node to descend from.
+   */
+  TreeNode<T, U>* fingerStart( TreeNode<T, U>* f, const T& key ){
+    TreeNode<T, U>* x = f;
+    for( ;; ){
+      // The nearest ancestor that has x in its left subtree bounds
+      // x's subtree from above.
+      TreeNode<T, U>* y = x;
+      while( y->parent( ) && y == y->parent( )->right( ) ){
+        y = y->parent( );
+      }
+      TreeNode<T, U>* p = y->parent( );
+      int c = p == NULL ? -1 : compare( key, p->key( ) );
+      if( c < 0 ){
+        return( x );
+      }
+      if( c == 0 ){
+        return( p );
+      }
+      x = p;
+    }
+  }
+
+  /**
+   * The next node in key order.
+   * @return The successor of n, NULL if n holds the largest key.
+   */
+  TreeNode<T, U>* successor( TreeNode<T, U>* n ) const{
+    if( n->right( ) != NULL ){
+      return( local_minimum( n->right( ) ) );
+    }
+    TreeNode<T, U>* p = n->parent( );
+    while( p != NULL && n == p->right( ) ){
+      n = p;
+      p = p->parent( );
+    }
+    return( p );
+  }
+
+  /**
+   * The previous node in key order.
+   * @return The predecessor of n, NULL if n holds the smallest key.
+   */
+  TreeNode<T, U>* predecessor( TreeNode<T, U>* n ) const{
+    if( n->left( ) != NULL ){
+      return( local_maximum( n->left( ) ) );
+    }
+    TreeNode<T, U>* p = n->parent( );
+    while( p != NULL && n == p->left( ) ){
+      n = p;
+      p = p->parent( );
+    }
+    return( p );
+  }
+
+  void transplant( TreeNode<T, U>* u, TreeNode<T, U>* v ){
+    if( u->parent( ) == NULL ){
+      _root = v;
+    }else if( u == u->parent()->left() ){
+      u->parent()->setLeft( v );
+    }else{
+      u->parent()->setRight(v);
+    }
+    if( v != NULL ){
+      v->setParent( u->parent( ) );
+    }
+  }
+
+  void deleteNode( TreeNode<T, U>* n ){
+    // The lowest node whose subtree loses a node.
+    TreeNode<T, U>* lowest = n->parent( );
+    if( n->left( ) == NULL ){
+      transplant( n, n->right() );
+    }else if( n->right( ) == NULL ){
+      transplant( n, n->left( ) );
+    }else{
+      TreeNode<T, U>* y = local_minimum( n->right( ) );
+      lowest = y->parent( ) != n ? y->parent( ) : y;
+      if( y->parent( ) != n ){
+        transplant( y, y->right( ) );
+        y->setRight( n->right( ) );
+        y->right( )->setParent( y );
+      }
+      transplant( n, y );
+      y->setLeft( n->left( ) );
+      y->left( )->setParent( y );
+    }
+#ifdef TREE_ORDER_STATISTICS
+    resizeUp( lowest );
+#else
+    (void)lowest;
+#endif
+    delete n;
+  }
+
+#ifdef TREE_ORDER_STATISTICS
+  static size_t subtreeSize( TreeNode<T, U>* n ){
+    return( n ? n->subtreeSize( ) : 0 );
+  }
+
+  /**
+   * Recompute the subtree sizes from n up to the root.
+   */
+  void resizeUp( TreeNode<T, U>* n ){
+    while( n != NULL ){
+      n->setSubtreeSize( 1 + subtreeSize( n->left( ) ) + subtreeSize( n->right( ) ) );
+      n = n->parent( );
+    }
+  }
+#endif
+
+ // BROKEN!!! try to remove the inorder predessecor
+ // of the root node and it breaks
+ // and it doesn't free the memory!!
+  void deleteNodeX( TreeNode<T, U>* n ){
+    TreeNode<T, U>* x;
+    TreeNode<T, U>* y;
+    if( n->isLeafNode( ) ){
+      y = n;
+    }else{
+      y = inorderSuccessor( n );
+    }
+    if( y->left( ) != NULL ){
+      x = y->left( );
+    }else{
+      x = y->right( );
+    }
+    if( x != NULL ){
+      x->setParent( y->parent( ) );
+    }
+    if( y->parent( ) == NULL ){
+      _root = x;
+    }else if( y->isLeftChildOfParent( ) ){
+      y->parent( )->setLeft( x );
+    }else{
+      y->parent( )->setRight( x );
+    }
+    if( y != n ){
+      n->setKey( y->key( ) );
+    }
+  }
+  
+  // The traversals below walk the parent pointers instead of
+  // recursing so they use O(1) space however tall the tree is.
+
+  /**
+   * The node after n in a preorder walk of the subtree rooted at top.
+   * @return The next node, NULL when the walk of top is done.
+   */
+  static TreeNode<T, U>* nextPreorder( TreeNode<T, U>* n, TreeNode<T, U>* top ){
+    if( n->left( ) ){
+      return( n->left( ) );
+    }
+    if( n->right( ) ){
+      return( n->right( ) );
+    }
+    while( n != top ){
+      TreeNode<T, U>* p = n->parent( );
+      if( n == p->left( ) && p->right( ) ){
+        return( p->right( ) );
+      }
+      n = p;
+    }
+    return( NULL );
+  }
+
+  void writeLinksHelper( std::ostream& out, TreeNode<T, U>* n ){
+    TreeNode<T, U>* top = n;
+    while( n ){
+      out << n << std::endl;
+      n = nextPreorder( n, top );
+    }
+  }
+
+  /**
+   * A copy of the subtree t with the same shape, made by walking it
+   * and the copy side by side along the parent links.
+   * @return The root of the copy, whose parent is NULL.
+   */
+  static TreeNode<T, U>* clone( TreeNode<T, U>* t ){
+    if( t == NULL ){
+      return( NULL );
+    }
+    TreeNode<T, U>* c = copyNode( t, NULL );
+    TreeNode<T, U>* s = t;
+    TreeNode<T, U>* d = c;
+    for( ;; ){
+      if( s->left( ) && ! d->left( ) ){
+        d->setLeft( copyNode( s->left( ), d ) );
+        s = s->left( );
+        d = d->left( );
+      }else if( s->right( ) && ! d->right( ) ){
+        d->setRight( copyNode( s->right( ), d ) );
+        s = s->right( );
+        d = d->right( );
+      }else if( s == t ){
+        return( c );
+      }else{
+        s = s->parent( );
+        d = d->parent( );
+      }
+    }
+  }
+
+  static TreeNode<T, U>* copyNode( TreeNode<T, U>* n, TreeNode<T, U>* parent ){
+    TreeNode<T, U>* c = new TreeNode<T, U>( parent, n->key( ), n->value( ) );
+#ifdef TREE_ORDER_STATISTICS
+    c->setSubtreeSize( n->subtreeSize( ) );
+#endif
+    return( c );
+  }
+
+  /**
+   * Append the nodes of the tree rooted at root to nodes in key order.
+   */
+  void flatten( TreeNode<T, U>* root, std::vector<TreeNode<T, U>*>& nodes ){
+    TreeNode<T, U>* n = root ? local_minimum( root ) : NULL;
+    while( n != NULL ){
+      nodes.push_back( n );
+      n = successor( n );
+    }
+  }
+
+  /**
+   * Link nodes[lo, hi), which are in key order, into a balanced subtree.
+   * @return The root of the subtree, NULL if the range is empty.
+   */
+  static TreeNode<T, U>* relink( const std::vector<TreeNode<T, U>*>& nodes, size_t lo,
+                                 size_t hi, TreeNode<T, U>* parent ){
+    if( lo >= hi ){
+      return( NULL );
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    TreeNode<T, U>* n = nodes[mid];
+    n->setParent( parent );
+    n->setLeft( relink( nodes, lo, mid, n ) );
+    n->setRight( relink( nodes, mid + 1, hi, n ) );
+#ifdef TREE_ORDER_STATISTICS
+    n->setSubtreeSize( hi - lo );
+#endif
+    return( n );
+  }
+
+  static size_t countNodes( TreeNode<T, U>* n ){
+    size_t c = 0;
+    TreeNode<T, U>* top = n;
+    while( n ){
+      c++;
+      n = nextPreorder( n, top );
+    }
+    return( c );
+  }
+
+  /**
+   * Delete n and all of its descendants. The link from n's parent, if
+   * any, is left dangling.
+   */
+  void trim( TreeNode<T, U>* n ){
+    TreeNode<T, U>* top = n;
+    while( n ){
+      if( n->left( ) ){
+        n = n->left( );
+      }else if( n->right( ) ){
+        n = n->right( );
+      }else{
+        // A leaf; cut it loose and carry on from its parent.
+        TreeNode<T, U>* p = n == top ? NULL : n->parent( );
+        if( p && p->left( ) == n ){
+          p->setLeft( NULL );
+        }else if( p ){
+          p->setRight( NULL );
+        }
+        delete n;
+        n = p;
+      }
+    }
+  }
+
+  void insertHelper( TreeNode<T, U>* n, const T& key, const U& value ){
+    for( ;; ){
+#ifdef TREE_ORDER_STATISTICS
+      n->setSubtreeSize( n->subtreeSize( ) + 1 );
+#endif
+      if( ! less( key, n->key( ) ) ){
+        if( ! n->right( ) ){
+          n->setRight( new TreeNode<T, U>( n, key, value ) );
+          return;
+        }
+        n = n->right( );
+      }else{
+        if( ! n->left( ) ){
+          n->setLeft( new TreeNode<T, U>( n, key, value ) );
+          return;
+        }
+        n = n->left( );
       }
     }
   }
@@ -338,21 +2304,35 @@ private:
 
   void writeHelper( TreeNode<T, U>* n, std::ostream& out ){
     static int nullcount = 0;
-    if( n->left( ) ){
-      out << "\t" << n->key( ) << " -> " << n->left( )->key( ) << ";\n";
-      writeHelper(n->left( ), out );
-    }else{
-      writeNull(n, nullcount++, out );
-    }
-    if( n->right( ) ){
-      out << "\t" << n->key( ) << " -> " << n->right( )->key( ) << ";\n";
-      writeHelper(n->right( ), out );
-    }else{
-      writeNull( n, nullcount++, out );
+    TreeNode<T, U>* top = n;
+    TreeNode<T, U>* prev = n->parent( );
+    while( n ){
+      TreeNode<T, U>* from = prev;
+      prev = n;
+      bool fromRight = from != n->parent( ) && from == n->right( );
+      if( ! fromRight ){
+        if( from == n->parent( ) ){
+          // First visit: the left edge, then the left subtree.
+          if( n->left( ) ){
+            out << "\t" << n->key( ) << " -> " << n->left( )->key( ) << ";\n";
+            n = n->left( );
+            continue;
+          }
+          writeNull(n, nullcount++, out );
+        }
+        // The left subtree is done: the right edge, then the right subtree.
+        if( n->right( ) ){
+          out << "\t" << n->key( ) << " -> " << n->right( )->key( ) << ";\n";
+          n = n->right( );
+          continue;
+        }
+        writeNull( n, nullcount++, out );
+      }
+      n = n == top ? NULL : n->parent( );
     }
   }
 
-  TreeNode<T, U>* local_minimum( TreeNode<T, U>* r ){
+  TreeNode<T, U>* local_minimum( TreeNode<T, U>* r ) const{
     TreeNode<T, U>* n = r;
     while( n->left( ) != NULL ){
       n = n->left( );
@@ -360,7 +2340,7 @@ private:
     return( n );
   }
   
-  TreeNode<T, U>* local_maximum( TreeNode<T, U>* r ){
+  TreeNode<T, U>* local_maximum( TreeNode<T, U>* r ) const{
     TreeNode<T, U>* n = r;
     while( n->right( ) != NULL ){
       n = n->right( );
@@ -370,8 +2350,8 @@ private:
 
 };
 
-template <class T, class U>
-std::ostream& operator <<( std::ostream& out, Tree<T, U>& t ){
+template <class T, class U, class Compare, class Hash>
+std::ostream& operator <<( std::ostream& out, Tree<T, U, Compare, Hash>& t ){
   t.writeLinks( out );
   return(out);
 }
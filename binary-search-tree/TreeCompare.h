@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for the key comparison helpers used by the
+ * Binary Search Tree class.
+ *
+ */
+
+#ifndef _TREECOMPARE_H_
+#define _TREECOMPARE_H_
+
+#include <cstring>
+#include <string>
+#include <functional>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+/**
+ * A transparent "less than" that compares any two types with operator<.
+ * With it a Tree<std::string, U, TreeLess> can be searched for a const
+ * char* or a string_view without building a std::string for the key.
+ * (std::less<void> does the same from C++14 on.)
+ */
+struct TreeLess{
+  typedef void is_transparent;
+
+  template <class A, class B>
+  bool operator ( )( const A& a, const B& b ) const{
+    return( a < b );
+  }
+};
+
+/**
+ * Three way comparison through a "less than" comparator.
+ * compare( c, a, b ) is negative if a comes before b, positive if it
+ * comes after and 0 if they are equivalent. In general that takes two
+ * calls to c; the specializations below do it in one pass for strings,
+ * so a search compares each key it passes once.
+ */
+template <class Compare>
+struct TreeThreeWay{
+  template <class A, class B>
+  static int compare( const Compare& c, const A& a, const B& b ){
+    if( c( a, b ) ){
+      return( -1 );
+    }
+    return( c( b, a ) ? 1 : 0 );
+  }
+};
+
+/**
+ * One pass three way comparisons of strings with strings, C strings
+ * and string views; anything else goes through operator<.
+ */
+struct TreeStringThreeWay{
+  static int compare( const std::string& a, const std::string& b ){
+    return( a.compare( b ) );
+  }
+
+  static int compare( const std::string& a, const char* b ){
+    return( a.compare( b ) );
+  }
+
+  static int compare( const char* a, const std::string& b ){
+    return( -b.compare( a ) );
+  }
+
+#if __cplusplus >= 201703L
+  static int compare( const std::string& a, std::string_view b ){
+    return( a.compare( b ) );
+  }
+
+  static int compare( std::string_view a, const std::string& b ){
+    return( -b.compare( a ) );
+  }
+#endif
+
+  template <class A, class B>
+  static int compare( const A& a, const B& b ){
+    if( a < b ){
+      return( -1 );
+    }
+    return( b < a ? 1 : 0 );
+  }
+};
+
+template <>
+struct TreeThreeWay<std::less<std::string> >{
+  static int compare( const std::less<std::string>&, const std::string& a,
+                      const std::string& b ){
+    return( a.compare( b ) );
+  }
+};
+
+template <>
+struct TreeThreeWay<TreeLess>{
+  template <class A, class B>
+  static int compare( const TreeLess&, const A& a, const B& b ){
+    return( TreeStringThreeWay::compare( a, b ) );
+  }
+};
+
+#if __cplusplus >= 201402L
+template <>
+struct TreeThreeWay<std::less<void> >{
+  template <class A, class B>
+  static int compare( const std::less<void>&, const A& a, const B& b ){
+    return( TreeStringThreeWay::compare( a, b ) );
+  }
+};
+#endif
+
+/**
+ * TreeIfTransparent<Compare, K, R>::type is R if Compare declares
+ * is_transparent and does not exist otherwise; it enables the lookups
+ * that take a key of type K rather than of the tree's key type. (K
+ * only makes the result depend on the lookup's template argument.)
+ */
+template <class X>
+struct TreeVoid{
+  typedef void type;
+};
+
+template <class Compare, class K, class R, class Enable = void>
+struct TreeIfTransparent{ };
+
+template <class Compare, class K, class R>
+struct TreeIfTransparent<Compare, K, R,
+                         typename TreeVoid<typename Compare::is_transparent>::type>{
+  typedef R type;
+};
+
+#endif
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for exporting the shape of a Binary Search Tree
+ * as GraphViz or as an edge list from a background thread.
+ *
+ */
+
+#ifndef _TREEEXPORT_H_
+#define _TREEEXPORT_H_
+
+#include "Tree.h"
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+/**
+ * A copy of the shape of (part of) a tree, independent of the tree it
+ * was taken from. Nodes are stored breadth first; every node records
+ * its parent's index and which side of the parent it hangs on.
+ * Missing children are kept as stubs, either empty (the child is NULL)
+ * or truncated (the child exists but was left out by the depth or node
+ * limit).
+ */
+template <class T>
+class TreeSnapshot{
+public:
+  static const size_t npos = size_t( -1 );
+
+  struct Node{
+    T key;
+    size_t parent;
+    char side;
+  };
+
+  struct Stub{
+    size_t parent;
+    char side;
+    bool truncated;
+  };
+
+  std::vector<Node> nodes;
+  std::vector<Stub> stubs;
+
+ /**
+  * Write the snapshot as a GraphViz digraph in the format of Tree::write.
+  */
+  void writeDot( std::ostream& out ) const{
+    out << "digraph BST{\n";
+    out << "\tnode [fontname=\"Helvetica\"];\n";
+    if( nodes.empty( ) ){
+      out << "\n";
+    }else if( nodes.size( ) == 1 && stubs.size( ) == 2 &&
+              ! stubs[0].truncated && ! stubs[1].truncated ){
+      out << "\t" << nodes[0].key << ";\n";
+    }else{
+      for( size_t i = 1; i < nodes.size( ); i++ ){
+        out << "\t" << nodes[nodes[i].parent].key << " -> " << nodes[i].key << ";\n";
+      }
+      for( size_t i = 0; i < stubs.size( ); i++ ){
+        const char* kind = stubs[i].truncated ? "more" : "null";
+        if( stubs[i].truncated ){
+          out << "\t" << kind << i << " [shape=none, label=\"...\"];\n";
+        }else{
+          out << "\t" << kind << i << " [shape=point];\n";
+        }
+        out << "\t" << nodes[stubs[i].parent].key << " -> " << kind << i << ";\n";
+      }
+    }
+    out << "}\n";
+  }
+
+ /**
+  * Write the snapshot as one "parent side child" line per edge, side
+  * being L or R; the root is written as "- - key" and truncated
+  * subtrees as "parent side ...".
+  */
+  void writeEdgeList( std::ostream& out ) const{
+    for( size_t i = 0; i < nodes.size( ); i++ ){
+      if( nodes[i].parent == npos ){
+        out << "- - " << nodes[i].key << "\n";
+      }else{
+        out << nodes[nodes[i].parent].key << " " << nodes[i].side << " "
+            << nodes[i].key << "\n";
+      }
+    }
+    for( size_t i = 0; i < stubs.size( ); i++ ){
+      if( stubs[i].truncated ){
+        out << nodes[stubs[i].parent].key << " " << stubs[i].side << " ...\n";
+      }
+    }
+  }
+};
+
+/**
+ * Writes tree snapshots to files on a background thread so the thread
+ * that took the snapshot can carry on at once. Jobs are written in the
+ * order they were submitted through a large buffered stream. A GraphViz
+ * file may also be rendered to PDF by running dot with posix_spawn,
+ * which does not copy the calling process the way fork does.
+ */
+class TreeExporter{
+public:
+  enum Format { kDot, kEdgeList };
+
+ /**
+  * TreeExporter constructor.
+  * Starts the background thread.
+  */
+  TreeExporter( ) : _stop( false ), _busy( false ),
+  _worker( &TreeExporter::run, this ) { }
+
+ /**
+  * TreeExporter deconstructor.
+  * Finishes every job submitted so far.
+  */
+  ~TreeExporter( ){
+    {
+      std::lock_guard<std::mutex> lock( _m );
+      _stop = true;
+    }
+    _wake.notify_all( );
+    _worker.join( );
+  }
+
+ /**
+  * Queue a snapshot to be written.
+  * @param snapshot The snapshot; it is moved from.
+  * @param path The file to write.
+  * @param format kDot for GraphViz, kEdgeList for an edge list.
+  * @param pdf If not empty and format is kDot, render path to this PDF
+  *            file with dot once it has been written.
+  * @param removeSource Delete path once it has been rendered.
+  */
+  template <class T>
+  void submit( TreeSnapshot<T>& snapshot, const std::string& path,
+               Format format = kDot, const std::string& pdf = "",
+               bool removeSource = false ){
+    std::shared_ptr<TreeSnapshot<T> > s( new TreeSnapshot<T>( ) );
+    s->nodes.swap( snapshot.nodes );
+    s->stubs.swap( snapshot.stubs );
+    std::function<void( )> job = [s, path, format, pdf, removeSource]( ){
+      {
+        std::vector<char> buffer( 1 << 20 );
+        std::ofstream out;
+        out.rdbuf( )->pubsetbuf( &buffer[0], buffer.size( ) );
+        out.open( path.c_str( ) );
+        if( format == kDot ){
+          s->writeDot( out );
+        }else{
+          s->writeEdgeList( out );
+        }
+      }
+      if( format == kDot && ! pdf.empty( ) ){
+        if( render( path, pdf ) && removeSource ){
+          std::remove( path.c_str( ) );
+        }
+      }
+    };
+    {
+      std::lock_guard<std::mutex> lock( _m );
+      _jobs.push_back( job );
+    }
+    _wake.notify_all( );
+  }
+
+ /**
+  * Block until every job submitted so far has been written.
+  */
+  void wait( ){
+    std::unique_lock<std::mutex> lock( _m );
+    while( ! _jobs.empty( ) || _busy ){
+      _idle.wait( lock );
+    }
+  }
+
+private:
+  /**
+   * Run "dot -Tpdf dotPath -o pdfPath" and wait for it.
+   * @return True if dot ran and succeeded.
+   */
+  static bool render( const std::string& dotPath, const std::string& pdfPath ){
+    std::string a0 = "dot", a1 = "-Tpdf", a3 = "-o";
+    std::string a2 = dotPath, a4 = pdfPath;
+    char* argv[] = { &a0[0], &a1[0], &a2[0], &a3[0], &a4[0], NULL };
+    pid_t child;
+    int status = -1;
+    if( posix_spawnp( &child, "dot", NULL, NULL, argv, environ ) != 0 ||
+        waitpid( child, &status, 0 ) != child ||
+        ! WIFEXITED( status ) || WEXITSTATUS( status ) != 0 ){
+      std::cerr << "could not run dot for " << dotPath << std::endl;
+      return( false );
+    }
+    return( true );
+  }
+
+  void run( ){
+    std::unique_lock<std::mutex> lock( _m );
+    for( ;; ){
+      while( _jobs.empty( ) && ! _stop ){
+        _wake.wait( lock );
+      }
+      if( _jobs.empty( ) ){
+        break;
+      }
+      std::function<void( )> job = _jobs.front( );
+      _jobs.pop_front( );
+      _busy = true;
+      lock.unlock( );
+      job( );
+      lock.lock( );
+      _busy = false;
+      _idle.notify_all( );
+    }
+  }
+
+  std::mutex _m;
+  std::condition_variable _wake;
+  std::condition_variable _idle;
+  std::deque<std::function<void( )> > _jobs;
+  bool _stop;
+  bool _busy;
+  std::thread _worker;
+
+  TreeExporter( const TreeExporter& );
+  TreeExporter& operator =( const TreeExporter& );
+};
+
+/**
+ * Tree::snapshot, declared in Tree.h. It lives here with TreeSnapshot so
+ * that only the programs that export trees need it.
+ */
+template <class T, class U, class Compare, class Hash>
+TreeSnapshot<T> Tree<T, U, Compare, Hash>::snapshot( size_t maxDepth,
+                                                     size_t maxNodes ){
+  TreeSnapshot<T> s;
+  if( ! _root || maxNodes == 0 ){
+    return( s );
+  }
+  std::vector<TreeNode<T, U>*> src;
+  src.push_back( _root );
+  typename TreeSnapshot<T>::Node root = { _root->key( ), TreeSnapshot<T>::npos, ' ' };
+  s.nodes.push_back( root );
+  size_t depth = 0;
+  size_t levelEnd = 1;
+  for( size_t i = 0; i < src.size( ); i++ ){
+    if( i == levelEnd ){
+      depth++;
+      levelEnd = src.size( );
+    }
+    for( int side = 0; side < 2; side++ ){
+      TreeNode<T, U>* c = side == 0 ? src[i]->left( ) : src[i]->right( );
+      char name = side == 0 ? 'L' : 'R';
+      if( c == NULL || depth >= maxDepth || src.size( ) >= maxNodes ){
+        typename TreeSnapshot<T>::Stub stub = { i, name, c != NULL };
+        s.stubs.push_back( stub );
+      }else{
+        typename TreeSnapshot<T>::Node n = { c->key( ), i, name };
+        s.nodes.push_back( n );
+        src.push_back( c );
+      }
+    }
+  }
+  return( s );
+}
+
+#endif
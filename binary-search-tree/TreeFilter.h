@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * This is a header file for the blocked Bloom filter that can sit in
+ * front of a Binary Search Tree to answer most misses without a search.
+ *
+ * Based in part on "Cache-, Hash- and Space-Efficient Bloom Filters"
+ * by Putze, Sanders and Singler.
+ *
+ */
+
+#ifndef _TREEFILTER_H_
+#define _TREEFILTER_H_
+
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <stdint.h>
+
+/**
+ * The hash a Tree uses when it is not given one for a key type that
+ * std::hash does not cover. It hashes every key to 0; Tree refuses to
+ * enable a filter or to build a treap with it, so it only stands in
+ * for code that is never run.
+ */
+template <class T>
+struct TreeNoHash{
+  size_t operator ( )( const T& ) const{
+    return( 0 );
+  }
+};
+
+/**
+ * TreeDefaultHash<T>::type is std::hash<T> if that can hash a T and
+ * TreeNoHash<T> otherwise, so a Tree of keys without a hash compiles as
+ * long as nothing that needs one is used.
+ */
+template <class T, class Enable = void>
+struct TreeDefaultHash{
+  typedef TreeNoHash<T> type;
+};
+
+template <class T>
+struct TreeDefaultHash<T, typename std::enable_if<std::is_convertible<
+  decltype( std::hash<T>( )( std::declval<const T&>( ) ) ), size_t>::value>::type>{
+  typedef std::hash<T> type;
+};
+
+/**
+ * A blocked Bloom filter over keys of type T.
+ * Each key sets kProbes bits in one 512 bit block, a cache line, chosen
+ * by its hash, so a query touches one cache line whatever the number of
+ * probes. mayContain never returns false for a key that was added; for
+ * other keys it returns true with a probability that grows as more keys
+ * are added than the filter was sized for. Keys cannot be taken out.
+ *
+ * Keys that compare equal must have equal Hash values.
+ */
+template <class T, class Hash = std::hash<T> >
+class TreeBloomFilter{
+public:
+  static const unsigned kProbes = 6;
+
+ /**
+  * TreeBloomFilter constructor.
+  * Initializes an empty filter with room for no keys; call reset first.
+  * @param bitsPerKey The number of bits to spend on each key.
+  */
+  explicit TreeBloomFilter( unsigned bitsPerKey ) :
+  _bitsPerKey( bitsPerKey ), _base( 0 ), _blocks( 0 ), _capacity( 0 ),
+  _added( 0 ), _removed( 0 ) { }
+
+ /**
+  * TreeBloomFilter copy constructor.
+  * The blocks are copied into a buffer of the filter's own, aligned to
+  * a cache line afresh; copying _words and _base as they are would put
+  * the blocks wherever the copy's vector happened to land.
+  * @param other The filter to copy.
+  */
+  TreeBloomFilter( const TreeBloomFilter& other ) :
+  _bitsPerKey( other._bitsPerKey ), _base( 0 ), _blocks( other._blocks ),
+  _capacity( other._capacity ), _added( other._added ),
+  _removed( other._removed ){
+    if( _blocks > 0 ){
+      allocate( );
+      std::copy( other._words.begin( ) + other._base,
+                 other._words.begin( ) + other._base + _blocks * kBlockWords,
+                 _words.begin( ) + _base );
+    }
+  }
+
+  TreeBloomFilter& operator =( const TreeBloomFilter& other ){
+    if( &other != this ){
+      TreeBloomFilter copy( other );
+      _bitsPerKey = copy._bitsPerKey;
+      _words.swap( copy._words );
+      _base = copy._base;
+      _blocks = copy._blocks;
+      _capacity = copy._capacity;
+      _added = copy._added;
+      _removed = copy._removed;
+    }
+    return( *this );
+  }
+
+ /**
+  * Empty the filter and size it for capacity keys.
+  * @param capacity The number of keys the filter should hold.
+  */
+  void reset( size_t capacity ){
+    _capacity = capacity;
+    _blocks = (capacity * _bitsPerKey + kBlockBits - 1) / kBlockBits;
+    if( _blocks == 0 ){
+      _blocks = 1;
+    }
+    allocate( );
+    _added = 0;
+    _removed = 0;
+  }
+
+ /**
+  * Add key to the filter.
+  * @param key The key to add.
+  */
+  void add( const T& key ){
+    uint64_t h = hash( key );
+    uint64_t* b = block( h );
+    uint64_t g = h * 0x9e3779b97f4a7c15ull;
+    for( unsigned i = 0; i < kProbes; i++ ){
+      unsigned bit = (g >> (9 * i)) & (kBlockBits - 1);
+      b[bit / 64] |= uint64_t( 1 ) << (bit % 64);
+    }
+    _added++;
+  }
+
+ /**
+  * Check if key may have been added.
+  * @param key The key to look for.
+  * @return False if key was certainly never added, True otherwise.
+  */
+  bool mayContain( const T& key ) const{
+    uint64_t h = hash( key );
+    const uint64_t* b = block( h );
+    uint64_t g = h * 0x9e3779b97f4a7c15ull;
+    for( unsigned i = 0; i < kProbes; i++ ){
+      unsigned bit = (g >> (9 * i)) & (kBlockBits - 1);
+      if( (b[bit / 64] & (uint64_t( 1 ) << (bit % 64))) == 0 ){
+        return( false );
+      }
+    }
+    return( true );
+  }
+
+ /**
+  * Note that a key was removed from the set the filter stands for. The
+  * key's bits stay set; the count only tells when to rebuild.
+  */
+  void removed( ){
+    _removed++;
+  }
+
+ /**
+  * Check if the filter has become too full, or holds too many removed
+  * keys, to be worth keeping; either way it should be rebuilt.
+  * @return True if the filter should be rebuilt.
+  */
+  bool worn( ) const{
+    return( _added > _capacity || 2 * _removed > _capacity );
+  }
+
+ /**
+  * The bytes held by the filter.
+  */
+  size_t memoryBytes( ) const{
+    return( _words.capacity( ) * sizeof(uint64_t) );
+  }
+
+private:
+  static const unsigned kBlockBits = 512;
+  static const unsigned kBlockWords = kBlockBits / 64;
+  static const unsigned kBlockBytes = kBlockBits / 8;
+
+  unsigned _bitsPerKey;
+  std::vector<uint64_t> _words;
+  // The index in _words of the first block.
+  size_t _base;
+  size_t _blocks;
+  size_t _capacity;
+  size_t _added;
+  size_t _removed;
+
+  /**
+   * Replace _words with _blocks zeroed blocks and point _base at the
+   * first that starts on a cache line boundary.
+   */
+  void allocate( ){
+    // One spare block so the first can start on a cache line boundary.
+    std::vector<uint64_t>( (_blocks + 1) * kBlockWords, 0 ).swap( _words );
+    uintptr_t a = reinterpret_cast<uintptr_t>( &_words[0] );
+    _base = ((kBlockBytes - a % kBlockBytes) % kBlockBytes) / sizeof(uint64_t);
+  }
+
+  static uint64_t hash( const T& key ){
+    uint64_t h = Hash( )( key );
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return( h );
+  }
+
+  /**
+   * The block for hash h; the high 32 bits pick it without a division.
+   */
+  uint64_t* block( uint64_t h ){
+    return( &_words[_base + ((h >> 32) * _blocks >> 32) * kBlockWords] );
+  }
+
+  const uint64_t* block( uint64_t h ) const{
+    return( &_words[_base + ((h >> 32) * _blocks >> 32) * kBlockWords] );
+  }
+};
+
+template <class T, class Hash>
+const unsigned TreeBloomFilter<T, Hash>::kProbes;
+
+template <class T, class Hash>
+const unsigned TreeBloomFilter<T, Hash>::kBlockBits;
+
+template <class T, class Hash>
+const unsigned TreeBloomFilter<T, Hash>::kBlockWords;
+
+template <class T, class Hash>
+const unsigned TreeBloomFilter<T, Hash>::kBlockBytes;
+
+#endif
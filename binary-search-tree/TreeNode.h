@@ -19,6 +19,17 @@
 #include <iostream>
 #include <cassert>
 
+/**
+ * Define TREE_ORDER_STATISTICS before including this file to give every
+ * node the size of the subtree rooted at it. Tree uses the sizes to
+ * answer rank and select queries in O(h).
+ */
+#ifdef TREE_ORDER_STATISTICS
+#define TREENODE_SIZE_INIT , _size(1)
+#else
+#define TREENODE_SIZE_INIT
+#endif
+
 /**
  * A naïve, templated tree node class.
  * This tree node class is for use with the
@@ -32,7 +43,8 @@ public:
    * @param key The key of the node
    */
    explicit TreeNode( const T& key, const U& value ) :
-   _key(key), _value(value), _left(NULL), _right(NULL), _parent(NULL) { };
+   _key(key), _value(value), _left(NULL), _right(NULL), _parent(NULL)
+   TREENODE_SIZE_INIT { };
   
  /**
   * TreeNode constructor.
@@ -40,7 +52,8 @@ public:
   * @param key The key of the node.
   */
   explicit TreeNode( TreeNode<T, U>* parent, const T& key, const U& value )  :
-  _key(key), _value(value), _left(NULL), _right(NULL), _parent(parent) { };
+  _key(key), _value(value), _left(NULL), _right(NULL), _parent(parent)
+  TREENODE_SIZE_INIT { };
 
   /**
    * TreeNode deconstructor.
@@ -50,9 +63,11 @@ public:
 
   /**
    * Returned the key of the tree node object.
-   * @return The value of _key.
+   * The key is returned by reference so that comparing it with another
+   * key copies nothing.
+   * @return A reference to _key.
    */
-  T key( ) const{
+  const T& key( ) const{
     return(_key);
   }
 
@@ -66,9 +81,9 @@ public:
 
  /**
   * Returned the value of the tree node object.
-  * @return The value of _value.
+  * @return A reference to _value.
   */
- U value( ) const{
+ const U& value( ) const{
    return(_value);
  }
 
@@ -134,6 +149,24 @@ public:
     return(this);
   }
 
+#ifdef TREE_ORDER_STATISTICS
+  /**
+   * Return the number of nodes in the subtree rooted at this node.
+   * @return The value of _size.
+   */
+  size_t subtreeSize( ) const{
+    return(_size);
+  }
+
+  /**
+   * Set the number of nodes in the subtree rooted at this node.
+   * @param size The number of nodes, including this one.
+   */
+  void setSubtreeSize( size_t size ){
+    _size = size;
+  }
+#endif
+
   /**
    * Write the contents of the tree node to the identified ostream.
    * @param out A reference to a desired ostream - can be cout.
@@ -249,6 +282,13 @@ private:
   * TreeNode's parent pointer; private data member.
   */
   TreeNode<T, U>* _parent;
+
+#ifdef TREE_ORDER_STATISTICS
+ /**
+  * The number of nodes in the subtree rooted at this node.
+  */
+  size_t _size;
+#endif
 };
 
 
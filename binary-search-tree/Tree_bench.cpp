@@ -0,0 +1,1503 @@
+/*
+ * Copyright (c) 2012 Michael Shafae.
+ * All rights reserved.
+ *
+ * Benchmark program for the Tree class and its relatives.
+ *
+ * Build with something like
+ *   g++ -std=c++11 -O2 -pthread -o Tree_bench Tree_bench.cpp
+ *
+ * Run "Tree_bench numKeys" for every benchmark or "Tree_bench numKeys
+ * name" for one of them. "Tree_bench numKeys harness [file.csv]" runs
+ * only the comparison harness for 1K keys up to numKeys and writes its
+ * results as CSV.
+ *
+ */
+
+#define TREE_VERBOSE 0
+#include "Tree.h"
+#include "MappedTree.h"
+#include "TreeExport.h"
+#include "ConcurrentTree.h"
+#include "LockFreeSkipList.h"
+#include "SplayTree.h"
+#include "CompactTree.h"
+#include "PersistentTree.h"
+#include "IntervalTree.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <fstream>
+#include <map>
+#include <set>
+#include <new>
+#include <sys/resource.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define BENCH_MALLOC_SIZE( p ) malloc_usable_size( p )
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define BENCH_MALLOC_SIZE( p ) malloc_size( p )
+#endif
+
+using namespace std;
+
+/*
+ * The bytes the calling thread has allocated and not yet freed, as
+ * counted by the operator new and delete below, including the
+ * allocator's rounding. The counter is per thread so the concurrent
+ * benchmarks do not contend on it; the harness allocates and frees on
+ * the main thread only.
+ */
+static thread_local long long liveBytes = 0;
+
+/*
+ * The number of calls the calling thread has made to operator new.
+ */
+static thread_local long long allocations = 0;
+
+#ifdef BENCH_MALLOC_SIZE
+#if defined(__GNUC__) && ! defined(__clang__) && __GNUC__ >= 11
+// The replacements below pair malloc with free; GCC cannot tell once
+// they are inlined into the standard containers.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new( size_t n ){
+  void* p = malloc( n == 0 ? 1 : n );
+  if( p == NULL ){
+    throw bad_alloc( );
+  }
+  allocations++;
+  liveBytes += BENCH_MALLOC_SIZE( p );
+  return( p );
+}
+
+void* operator new( size_t n, const nothrow_t& ) noexcept{
+  void* p = malloc( n == 0 ? 1 : n );
+  if( p != NULL ){
+    allocations++;
+    liveBytes += BENCH_MALLOC_SIZE( p );
+  }
+  return( p );
+}
+
+void operator delete( void* p ) noexcept{
+  if( p != NULL ){
+    liveBytes -= BENCH_MALLOC_SIZE( p );
+    free( p );
+  }
+}
+
+void operator delete( void* p, const nothrow_t& ) noexcept{
+  operator delete( p );
+}
+
+#ifdef __cpp_sized_deallocation
+// From C++14 delete passes the size when it knows it; the size is
+// looked up from the pointer like any other. The standard has no
+// nothrow form of the sized delete.
+void operator delete( void* p, size_t ) noexcept{
+  operator delete( p );
+}
+#endif
+#endif
+
+typedef Tree<unsigned int, unsigned int> UTree;
+
+/*
+ * Seconds elapsed since start.
+ */
+double elapsed( chrono::steady_clock::time_point start ){
+  return( chrono::duration<double>( chrono::steady_clock::now( ) - start ).count( ) );
+}
+
+/*
+ * Fill l with the keys 0, 2, 4, ... in random order. The odd numbers
+ * are then guaranteed misses.
+ */
+void shuffled_keys( vector<unsigned int>& l, int numKeys, unsigned int seed ){
+  mt19937 rng( seed );
+  l.clear( );
+  for( int i = 0; i < numKeys; i++ ){
+    l.push_back( 2 * i );
+  }
+  shuffle( l.begin( ), l.end( ), rng );
+}
+
+/*
+ * numQueries lookups, about half of which hit.
+ */
+void query_keys( vector<unsigned int>& q, int numKeys, int numQueries, unsigned int seed ){
+  mt19937 rng( seed );
+  uniform_int_distribution<unsigned int> d( 0, 2 * numKeys - 1 );
+  q.resize( numQueries );
+  for( int i = 0; i < numQueries; i++ ){
+    q[i] = d( rng );
+  }
+}
+
+/*
+ * numQueries lookups of the keys in l drawn from a Zipf distribution
+ * with exponent s: the i-th key of l is drawn with probability
+ * proportional to 1 / (i + 1)^s. Since l is shuffled the popular keys
+ * are scattered over the key range.
+ */
+void zipf_keys( vector<unsigned int>& q, const vector<unsigned int>& l, int numQueries,
+                double s, unsigned int seed ){
+  vector<double> cdf( l.size( ) );
+  double sum = 0;
+  for( size_t i = 0; i < l.size( ); i++ ){
+    sum += pow( double( i + 1 ), -s );
+    cdf[i] = sum;
+  }
+  mt19937 rng( seed );
+  uniform_real_distribution<double> d( 0, sum );
+  q.resize( numQueries );
+  for( int i = 0; i < numQueries; i++ ){
+    size_t r = upper_bound( cdf.begin( ), cdf.end( ), d( rng ) ) - cdf.begin( );
+    q[i] = l[r < l.size( ) ? r : l.size( ) - 1];
+  }
+}
+
+void report( const char* name, int numQueries, double seconds, size_t hits ){
+  cout << "  " << name << ": " << numQueries / seconds / 1e6
+       << " Mlookups/s (" << 1e9 * seconds / numQueries << " ns/lookup, "
+       << hits << " hits)" << endl;
+}
+
+void freeze_bench( int numKeys ){
+  UTree t;
+  vector<unsigned int> l;
+  vector<unsigned int> q;
+  shuffled_keys( l, numKeys, 1 );
+  for( int i = 0; i < numKeys; i++ ){
+    t.insert( l[i], l[i] );
+  }
+  int numQueries = numKeys < 1000000 ? 1000000 : numKeys;
+  query_keys( q, numKeys, numQueries, 2 );
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+  FrozenTree<unsigned int, unsigned int> f = t.freeze( );
+  cout << "freeze of " << numKeys << " keys: " << elapsed( start ) << " s" << endl;
+
+  size_t hits = 0;
+  start = chrono::steady_clock::now( );
+  for( int i = 0; i < numQueries; i++ ){
+    hits += t.hasKey( q[i] );
+  }
+  report( "Tree::hasKey", numQueries, elapsed( start ), hits );
+
+  size_t frozenHits = 0;
+  start = chrono::steady_clock::now( );
+  for( int i = 0; i < numQueries; i++ ){
+    frozenHits += f.hasKey( q[i] );
+  }
+  report( "FrozenTree::hasKey", numQueries, elapsed( start ), frozenHits );
+  assert( frozenHits == hits );
+
+  vector<size_t> slots( numQueries );
+  start = chrono::steady_clock::now( );
+  frozenHits = f.find_many( &q[0], numQueries, &slots[0] );
+  report( "FrozenTree::find_many", numQueries, elapsed( start ), frozenHits );
+  assert( frozenHits == hits );
+  for( int i = 0; i < numQueries; i++ ){
+    assert( slots[i] == f.find( q[i] ) );
+  }
+}
+
+void build_bench( int numKeys ){
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+  {
+    UTree t;
+    for( int i = 0; i < numKeys; i++ ){
+      t.insert( l[i], l[i] );
+    }
+    cout << "insert of " << numKeys << " shuffled keys: " << elapsed( start ) << " s" << endl;
+  }
+
+  sort( l.begin( ), l.end( ) );
+  {
+    UTree t;
+    start = chrono::steady_clock::now( );
+    t.build_from_sorted( l.begin( ), l.end( ), l.begin( ) );
+    cout << "build_from_sorted of " << numKeys << " keys: " << elapsed( start ) << " s" << endl;
+    assert( t.size( ) == l.size( ) );
+    for( int i = 0; i < numKeys; i += 1 + numKeys / 1000 ){
+      assert( t.hasKey( l[i] ) && ! t.hasKey( l[i] + 1 ) );
+    }
+  }
+  {
+    UTree t;
+    start = chrono::steady_clock::now( );
+    t.build_from_sorted_parallel( l.begin( ), l.end( ), l.begin( ), 0 );
+    cout << "build_from_sorted_parallel of " << numKeys << " keys ("
+         << thread::hardware_concurrency( ) << " threads): " << elapsed( start ) << " s" << endl;
+    assert( t.size( ) == l.size( ) );
+    for( int i = 0; i < numKeys; i += 1 + numKeys / 1000 ){
+      assert( t.hasKey( l[i] ) && ! t.hasKey( l[i] + 1 ) );
+    }
+  }
+}
+
+void range_bench( int numKeys ){
+  UTree t;
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  for( int i = 0; i < numKeys; i++ ){
+    t.insert( l[i], l[i] );
+  }
+  const int numScans = 10000;
+  const unsigned int width = 200;
+  mt19937 rng( 3 );
+  uniform_int_distribution<unsigned int> d( 0, 2 * numKeys );
+
+  size_t visited = 0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+  for( int i = 0; i < numScans; i++ ){
+    unsigned int lo = d( rng );
+    t.for_each_in_range( lo, lo + width,
+                         [&visited]( const unsigned int&, const unsigned int& ){ visited++; } );
+  }
+  double seconds = elapsed( start );
+  cout << "for_each_in_range over " << numKeys << " keys: " << 1e9 * seconds / numScans
+       << " ns/scan (" << visited / double( numScans ) << " keys/scan)" << endl;
+
+  // The same scans by walking the whole tree, for comparison.
+  rng.seed( 3 );
+  size_t walked = 0;
+  int numWalks = numScans / 100 + 1;
+  start = chrono::steady_clock::now( );
+  for( int i = 0; i < numWalks; i++ ){
+    unsigned int lo = d( rng );
+    for( UTree::iterator j = t.begin( ); j != t.end( ); ++j ){
+      walked += (lo <= j->key( ) && j->key( ) <= lo + width);
+    }
+  }
+  cout << "full in-order walk over " << numKeys << " keys: "
+       << 1e9 * elapsed( start ) / numWalks << " ns/scan ("
+       << walked / double( numWalks ) << " keys/scan)" << endl;
+}
+
+/*
+ * Batches of lookups answered one hasKey at a time, as Tree_driver's
+ * find does, and with find_many.
+ */
+void batch_bench( int numKeys ){
+  UTree t;
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  for( int i = 0; i < numKeys; i++ ){
+    t.insert( l[i], l[i] );
+  }
+  const int batch = 4096;
+  int numQueries = numKeys < 1000000 ? 1000000 : numKeys;
+  numQueries -= numQueries % batch;
+  vector<unsigned int> q;
+  query_keys( q, numKeys, numQueries, 2 );
+  vector<unsigned int> sorted( q );
+  for( int b = 0; b < numQueries; b += batch ){
+    sort( sorted.begin( ) + b, sorted.begin( ) + b + batch );
+  }
+  bool* found = new bool[batch];
+
+  for( int pass = 0; pass < 2; pass++ ){
+    const vector<unsigned int>& keys = pass == 0 ? q : sorted;
+    const char* kind = pass == 0 ? "random" : "sorted";
+    size_t hits = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+    for( int i = 0; i < numQueries; i++ ){
+      hits += t.hasKey( keys[i] );
+    }
+    double loop = elapsed( start );
+    size_t batchHits = 0;
+    start = chrono::steady_clock::now( );
+    for( int b = 0; b < numQueries; b += batch ){
+      batchHits += t.find_many( &keys[b], batch, found );
+    }
+    double many = elapsed( start );
+    assert( hits == batchHits );
+    cout << batch << "-key " << kind << " batches over " << numKeys << " keys: hasKey loop "
+         << 1e9 * loop / numQueries << " ns/key, find_many "
+         << 1e9 * many / numQueries << " ns/key (" << loop / many << "x)" << endl;
+  }
+  delete [] found;
+
+  vector<unsigned int> fresh;
+  query_keys( fresh, numKeys, numKeys, 4 );
+  for( int i = 0; i < numKeys; i++ ){
+    fresh[i] |= 1;
+  }
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+  for( int i = 0; i < numKeys; i++ ){
+    t.insert( fresh[i], fresh[i] );
+  }
+  double loop = elapsed( start );
+  UTree t2;
+  for( int i = 0; i < numKeys; i++ ){
+    t2.insert( l[i], l[i] );
+  }
+  start = chrono::steady_clock::now( );
+  for( int b = 0; b < numKeys; b += batch ){
+    int n = numKeys - b < batch ? numKeys - b : batch;
+    t2.insert_many( &fresh[b], &fresh[b], n );
+  }
+  double many = elapsed( start );
+  assert( t.size( ) == t2.size( ) );
+  cout << "inserting " << numKeys << " new keys: insert loop " << 1e9 * loop / numKeys
+       << " ns/key, insert_many " << 1e9 * many / numKeys << " ns/key ("
+       << loop / many << "x)" << endl;
+}
+
+/*
+ * Restoring a tree from an image compared with reinserting its keys.
+ */
+void snapshot_bench( int numKeys ){
+  const char* path = "Tree_bench.img";
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  UTree t;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+  for( int i = 0; i < numKeys; i++ ){
+    t.insert( l[i], l[i] );
+  }
+  double reinsert = elapsed( start );
+
+  start = chrono::steady_clock::now( );
+  bool saved = t.save( path );
+  double save = elapsed( start );
+  assert( saved );
+
+  UTree u;
+  start = chrono::steady_clock::now( );
+  bool loaded = u.load( path );
+  double load = elapsed( start );
+  assert( loaded && u.size( ) == t.size( ) );
+
+  MappedTree<unsigned int, unsigned int> m;
+  start = chrono::steady_clock::now( );
+  bool mapped = m.open( path );
+  double open = elapsed( start );
+  assert( mapped && m.size( ) == t.size( ) );
+  size_t hits = 0;
+  for( int i = 0; i < numKeys; i++ ){
+    hits += m.hasKey( l[i] );
+  }
+  assert( hits == size_t( numKeys ) );
+  m.close( );
+
+  // A count whose products with the key and value sizes wrap around to
+  // the file's real size must be refused, not mapped past the end.
+  uint64_t wrapped = (uint64_t( 1 ) << 62) + t.size( );
+  fstream image( path, ios::in | ios::out | ios::binary );
+  image.seekp( offsetof( TreeImageHeader, count ) );
+  image.write( reinterpret_cast<const char*>( &wrapped ), sizeof(wrapped) );
+  image.close( );
+  assert( ! m.open( path ) && ! u.load( path ) && u.size( ) == t.size( ) );
+  remove( path );
+
+  cout << "restoring " << numKeys << " keys: reinsert " << reinsert << " s, save "
+       << save << " s, load " << load << " s, MappedTree::open " << open << " s" << endl;
+}
+
+/*
+ * How long the caller is held up by a GraphViz dump written with
+ * Tree::write compared with a snapshot handed to TreeExporter.
+ */
+void export_bench( int numKeys ){
+  UTree t;
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  for( int i = 0; i < numKeys; i++ ){
+    t.insert( l[i], l[i] );
+  }
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+  {
+    ofstream f( "Tree_bench-write.dot" );
+    t.write( f );
+  }
+  double write = elapsed( start );
+
+  TreeExporter exporter;
+  start = chrono::steady_clock::now( );
+  TreeSnapshot<unsigned int> s = t.snapshot( );
+  exporter.submit( s, "Tree_bench-export.dot" );
+  double stall = elapsed( start );
+  exporter.wait( );
+  double total = elapsed( start );
+
+  start = chrono::steady_clock::now( );
+  TreeSnapshot<unsigned int> capped = t.snapshot( 12, 4096 );
+  exporter.submit( capped, "Tree_bench-capped.dot" );
+  double cappedStall = elapsed( start );
+  exporter.wait( );
+
+  remove( "Tree_bench-write.dot" );
+  remove( "Tree_bench-export.dot" );
+  remove( "Tree_bench-capped.dot" );
+  cout << "dumping " << numKeys << " keys: Tree::write " << write
+       << " s, snapshot+submit " << stall << " s (written after " << total
+       << " s), capped snapshot+submit " << cappedStall << " s" << endl;
+}
+
+/*
+ * Readers call hasKey as fast as they can while one writer inserts and
+ * removes keys at a fixed rate.
+ */
+void concurrent_bench( int numKeys ){
+  const double seconds = 0.5;
+  const int writesPerSecond = 100000;
+  ConcurrentTree<unsigned int, unsigned int> t;
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  for( int i = 0; i < numKeys; i++ ){
+    t.insert( l[i], l[i] );
+  }
+  unsigned int maxReaders = thread::hardware_concurrency( );
+  if( maxReaders < 16 ){
+    maxReaders = 16;
+  }
+  cout << "concurrent reads over " << numKeys << " keys, one writer at "
+       << writesPerSecond << " writes/s" << endl;
+  for( unsigned int readers = 1; readers <= maxReaders; readers *= 2 ){
+    atomic<bool> stop( false );
+    atomic<unsigned long long> reads( 0 );
+    atomic<size_t> hits( 0 );
+    unsigned long long writes = 0;
+    thread writer( [&]( ){
+      mt19937 rng( 7 );
+      uniform_int_distribution<unsigned int> d( 0, 2 * numKeys - 1 );
+      chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+      while( ! stop.load( ) ){
+        // Keep the key count steady: remove a key or put it back.
+        unsigned int k = d( rng ) & ~1u;
+        if( ! t.remove( k ) ){
+          t.insert( k, k );
+        }
+        writes++;
+        this_thread::sleep_until( start +
+          chrono::microseconds( writes * 1000000 / writesPerSecond ) );
+      }
+    } );
+    vector<thread> pool;
+    for( unsigned int r = 0; r < readers; r++ ){
+      pool.push_back( thread( [&, r]( ){
+        mt19937 rng( 100 + r );
+        uniform_int_distribution<unsigned int> d( 0, 2 * numKeys - 1 );
+        unsigned long long mine = 0;
+        size_t found = 0;
+        while( ! stop.load( memory_order_relaxed ) ){
+          for( int i = 0; i < 256; i++ ){
+            found += t.hasKey( d( rng ) );
+          }
+          mine += 256;
+        }
+        reads += mine;
+        hits += found;
+      } ) );
+    }
+    this_thread::sleep_for( chrono::duration<double>( seconds ) );
+    stop.store( true );
+    writer.join( );
+    for( size_t i = 0; i < pool.size( ); i++ ){
+      pool[i].join( );
+    }
+    cout << "  " << readers << " readers: " << reads.load( ) / seconds / 1e6
+         << " Mlookups/s (" << 100.0 * hits.load( ) / reads.load( ) << "% hits), "
+         << writes / seconds << " writes/s" << endl;
+  }
+}
+
+/*
+ * Tree behind one mutex, the baseline for the concurrent containers.
+ */
+class LockedTree{
+public:
+  bool insert( unsigned int key, unsigned int value ){
+    lock_guard<mutex> lock( _m );
+    size_t before = _t.size( );
+    _t.insert( key, value );
+    return( _t.size( ) != before );
+  }
+  bool remove( unsigned int key ){
+    lock_guard<mutex> lock( _m );
+    return( _t.remove( key ) );
+  }
+  bool hasKey( unsigned int key ){
+    lock_guard<mutex> lock( _m );
+    return( _t.hasKey( key ) );
+  }
+private:
+  mutex _m;
+  UTree _t;
+};
+
+/*
+ * Every thread runs 80% lookups, 10% inserts and 10% removes on keys
+ * drawn uniformly from twice the initial key count.
+ */
+template <class Map>
+double mixed_ops_per_second( Map& m, int numKeys, unsigned int threads, double seconds ){
+  atomic<bool> stop( false );
+  atomic<unsigned long long> ops( 0 );
+  vector<thread> pool;
+  for( unsigned int i = 0; i < threads; i++ ){
+    pool.push_back( thread( [&, i]( ){
+      mt19937 rng( 1000 + i );
+      uniform_int_distribution<unsigned int> d( 0, 2 * numKeys - 1 );
+      unsigned long long mine = 0;
+      while( ! stop.load( memory_order_relaxed ) ){
+        for( int j = 0; j < 64; j++ ){
+          unsigned int k = d( rng );
+          unsigned int op = rng( ) % 10;
+          if( op == 0 ){
+            m.insert( k, k );
+          }else if( op == 1 ){
+            m.remove( k );
+          }else{
+            m.hasKey( k );
+          }
+        }
+        mine += 64;
+      }
+      ops += mine;
+    } ) );
+  }
+  this_thread::sleep_for( chrono::duration<double>( seconds ) );
+  stop.store( true );
+  for( size_t i = 0; i < pool.size( ); i++ ){
+    pool[i].join( );
+  }
+  return( ops.load( ) / seconds );
+}
+
+void skiplist_bench( int numKeys ){
+  const double seconds = 0.3;
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  cout << "mixed 80/10/10 workload over " << numKeys << " keys" << endl;
+  for( unsigned int threads = 1; threads <= 64; threads *= 2 ){
+    LockedTree t;
+    LockFreeSkipList<unsigned int, unsigned int> s;
+    for( int i = 0; i < numKeys; i++ ){
+      t.insert( l[i], l[i] );
+      s.insert( l[i], l[i] );
+    }
+    double tree = mixed_ops_per_second( t, numKeys, threads, seconds );
+    double list = mixed_ops_per_second( s, numKeys, threads, seconds );
+    cout << "  " << threads << " threads: mutex Tree " << tree / 1e6
+         << " Mops/s, LockFreeSkipList " << list / 1e6 << " Mops/s" << endl;
+  }
+}
+
+/*
+ * Lookups of keys that are all present, drawn uniformly and from a
+ * Zipf(0.99) distribution, answered by Tree, by std::map (a red-black
+ * tree) and by SplayTree with full and with semi-splaying.
+ */
+void splay_bench( int numKeys ){
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  UTree t;
+  map<unsigned int, unsigned int> m;
+  SplayTree<unsigned int, unsigned int> full;
+  SplayTree<unsigned int, unsigned int> semi( true );
+  for( int i = 0; i < numKeys; i++ ){
+    t.insert( l[i], l[i] );
+    m.insert( make_pair( l[i], l[i] ) );
+    full.insert( l[i], l[i] );
+    semi.insert( l[i], l[i] );
+  }
+  int numQueries = numKeys < 1000000 ? 1000000 : numKeys;
+  for( int pass = 0; pass < 2; pass++ ){
+    vector<unsigned int> q;
+    if( pass == 0 ){
+      uniform_int_distribution<int> d( 0, numKeys - 1 );
+      mt19937 rng( 5 );
+      q.resize( numQueries );
+      for( int i = 0; i < numQueries; i++ ){
+        q[i] = l[d( rng )];
+      }
+      cout << "uniform lookups over " << numKeys << " keys" << endl;
+    }else{
+      zipf_keys( q, l, numQueries, 0.99, 5 );
+      cout << "Zipf(0.99) lookups over " << numKeys << " keys" << endl;
+    }
+    size_t hits = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+    for( int i = 0; i < numQueries; i++ ){
+      hits += t.hasKey( q[i] );
+    }
+    report( "Tree::hasKey", numQueries, elapsed( start ), hits );
+
+    hits = 0;
+    start = chrono::steady_clock::now( );
+    for( int i = 0; i < numQueries; i++ ){
+      hits += m.count( q[i] );
+    }
+    report( "std::map::count", numQueries, elapsed( start ), hits );
+
+    hits = 0;
+    start = chrono::steady_clock::now( );
+    for( int i = 0; i < numQueries; i++ ){
+      hits += full.hasKey( q[i] );
+    }
+    report( "SplayTree::hasKey", numQueries, elapsed( start ), hits );
+
+    hits = 0;
+    start = chrono::steady_clock::now( );
+    for( int i = 0; i < numQueries; i++ ){
+      hits += semi.hasKey( q[i] );
+    }
+    report( "SplayTree::hasKey (semi)", numQueries, elapsed( start ), hits );
+  }
+}
+
+/*
+ * The comparison harness.
+ *
+ * Every structure is filled from a stream of keys and then answers a
+ * trace of lookups of keys it holds. The streams are
+ *   sorted       the keys in ascending order, looked up in that order,
+ *   random       the keys shuffled, looked up uniformly,
+ *   zipf         the keys shuffled, looked up with Zipf(0.99),
+ *   adversarial  the keys from alternating ends (smallest, largest,
+ *                second smallest, ...), looked up uniformly.
+ * Sorted and adversarial streams turn Tree, ConcurrentTree and
+ * CompactTree into a list, so they are only run on them up to
+ * kDegenerateLimit keys. PersistentTree is filled by replacing the
+ * version it holds with the one insert returns, so its rows include
+ * releasing the old root.
+ *
+ * Every operation (or every k-th one above a million) is timed on its
+ * own and the ns/op percentiles are reported, less the cost of reading
+ * the clock. Bytes per key is the memory the structure allocates for
+ * the keys it holds, counted by operator new; peak RSS is that of the
+ * whole process so far.
+ */
+const int kDegenerateLimit = 20000;
+
+struct Percentiles{
+  double mean, p50, p90, p99, p999, max;
+};
+
+/*
+ * The median cost of reading the clock twice, in ns.
+ */
+double clock_overhead( ){
+  vector<double> t( 10001 );
+  for( size_t i = 0; i < t.size( ); i++ ){
+    chrono::steady_clock::time_point a = chrono::steady_clock::now( );
+    chrono::steady_clock::time_point b = chrono::steady_clock::now( );
+    t[i] = chrono::duration<double, nano>( b - a ).count( );
+  }
+  nth_element( t.begin( ), t.begin( ) + t.size( ) / 2, t.end( ) );
+  return( t[t.size( ) / 2] );
+}
+
+Percentiles percentiles( vector<double>& ns, double overhead ){
+  Percentiles p = { 0, 0, 0, 0, 0, 0 };
+  if( ns.empty( ) ){
+    return( p );
+  }
+  double sum = 0;
+  for( size_t i = 0; i < ns.size( ); i++ ){
+    ns[i] = ns[i] > overhead ? ns[i] - overhead : 0;
+    sum += ns[i];
+  }
+  sort( ns.begin( ), ns.end( ) );
+  size_t last = ns.size( ) - 1;
+  p.mean = sum / ns.size( );
+  p.p50 = ns[size_t( last * 0.5 )];
+  p.p90 = ns[size_t( last * 0.9 )];
+  p.p99 = ns[size_t( last * 0.99 )];
+  p.p999 = ns[size_t( last * 0.999 )];
+  p.max = ns[last];
+  return( p );
+}
+
+/*
+ * The peak resident set size of the process in KB.
+ */
+long peak_rss_kb( ){
+  struct rusage u;
+  getrusage( RUSAGE_SELF, &u );
+#ifdef __APPLE__
+  return( u.ru_maxrss / 1024 );
+#else
+  return( u.ru_maxrss );
+#endif
+}
+
+/*
+ * One insert and one lookup for every structure in the harness.
+ */
+void bench_insert( UTree& t, unsigned int k ){
+  t.insert( k, k );
+}
+
+bool bench_find( UTree& t, unsigned int k ){
+  return( t.hasKey( k ) );
+}
+
+void bench_insert( map<unsigned int, unsigned int>& m, unsigned int k ){
+  m.insert( make_pair( k, k ) );
+}
+
+bool bench_find( map<unsigned int, unsigned int>& m, unsigned int k ){
+  return( m.count( k ) != 0 );
+}
+
+void bench_insert( set<unsigned int>& m, unsigned int k ){
+  m.insert( k );
+}
+
+bool bench_find( set<unsigned int>& m, unsigned int k ){
+  return( m.count( k ) != 0 );
+}
+
+void bench_insert( SplayTree<unsigned int, unsigned int>& t, unsigned int k ){
+  t.insert( k, k );
+}
+
+bool bench_find( SplayTree<unsigned int, unsigned int>& t, unsigned int k ){
+  return( t.hasKey( k ) );
+}
+
+void bench_insert( LockFreeSkipList<unsigned int, unsigned int>& s, unsigned int k ){
+  s.insert( k, k );
+}
+
+bool bench_find( LockFreeSkipList<unsigned int, unsigned int>& s, unsigned int k ){
+  return( s.hasKey( k ) );
+}
+
+void bench_insert( ConcurrentTree<unsigned int, unsigned int>& t, unsigned int k ){
+  t.insert( k, k );
+}
+
+bool bench_find( ConcurrentTree<unsigned int, unsigned int>& t, unsigned int k ){
+  return( t.hasKey( k ) );
+}
+
+void bench_insert( CompactTree<unsigned int, unsigned int>& t, unsigned int k ){
+  t.insert( k, k );
+}
+
+bool bench_find( CompactTree<unsigned int, unsigned int>& t, unsigned int k ){
+  return( t.hasKey( k ) );
+}
+
+void bench_insert( PersistentTree<unsigned int, unsigned int>& t, unsigned int k ){
+  t = t.insert( k, k );
+}
+
+bool bench_find( PersistentTree<unsigned int, unsigned int>& t, unsigned int k ){
+  return( t.hasKey( k ) );
+}
+
+void harness_row( ostream& csv, const char* structure, const char* stream, size_t n,
+                  const char* op, const Percentiles& p, double bytesPerKey ){
+  long rss = peak_rss_kb( );
+  csv << structure << "," << stream << "," << n << "," << op << "," << p.mean << ","
+      << p.p50 << "," << p.p90 << "," << p.p99 << "," << p.p999 << "," << p.max << ","
+      << bytesPerKey << "," << rss << "\n";
+  cout << "  " << structure << " " << op << ": mean " << p.mean << " p50 " << p.p50
+       << " p99 " << p.p99 << " p99.9 " << p.p999 << " ns/op, " << bytesPerKey
+       << " bytes/key, peak RSS " << rss << " KB" << endl;
+}
+
+template <class Map>
+void harness_case( const char* structure, const char* stream,
+                   const vector<unsigned int>& ins, const vector<unsigned int>& look,
+                   double overhead, ostream& csv ){
+  size_t stride = ins.size( ) / 1000000 + 1;
+  vector<double> ns;
+  ns.reserve( ins.size( ) / stride + 1 );
+  long long before = liveBytes;
+  Map* m = new Map;
+  for( size_t i = 0; i < ins.size( ); i++ ){
+    if( i % stride != 0 ){
+      bench_insert( *m, ins[i] );
+      continue;
+    }
+    chrono::steady_clock::time_point a = chrono::steady_clock::now( );
+    bench_insert( *m, ins[i] );
+    chrono::steady_clock::time_point b = chrono::steady_clock::now( );
+    ns.push_back( chrono::duration<double, nano>( b - a ).count( ) );
+  }
+  double bytesPerKey = double( liveBytes - before ) / ins.size( );
+  harness_row( csv, structure, stream, ins.size( ), "insert",
+               percentiles( ns, overhead ), bytesPerKey );
+
+  ns.clear( );
+  size_t hits = 0;
+  for( size_t i = 0; i < look.size( ); i++ ){
+    if( i % stride != 0 ){
+      hits += bench_find( *m, look[i] );
+      continue;
+    }
+    chrono::steady_clock::time_point a = chrono::steady_clock::now( );
+    hits += bench_find( *m, look[i] );
+    chrono::steady_clock::time_point b = chrono::steady_clock::now( );
+    ns.push_back( chrono::duration<double, nano>( b - a ).count( ) );
+  }
+  assert( hits == look.size( ) );
+  harness_row( csv, structure, stream, ins.size( ), "find",
+               percentiles( ns, overhead ), bytesPerKey );
+  delete m;
+}
+
+/*
+ * Fill ins with the keys 0, 2, ..., 2(n - 1) in the order of stream and
+ * look with n lookups of them.
+ */
+void harness_stream( const char* stream, int n, vector<unsigned int>& ins,
+                     vector<unsigned int>& look ){
+  ins.resize( n );
+  look.resize( n );
+  if( strcmp( stream, "sorted" ) == 0 ){
+    for( int i = 0; i < n; i++ ){
+      ins[i] = 2 * i;
+    }
+    look = ins;
+    return;
+  }
+  if( strcmp( stream, "adversarial" ) == 0 ){
+    for( int i = 0, lo = 0, hi = n - 1; i < n; i++ ){
+      ins[i] = 2 * (i % 2 == 0 ? lo++ : hi--);
+    }
+  }else{
+    shuffled_keys( ins, n, 11 );
+  }
+  if( strcmp( stream, "zipf" ) == 0 ){
+    zipf_keys( look, ins, n, 0.99, 12 );
+  }else{
+    mt19937 rng( 12 );
+    uniform_int_distribution<int> d( 0, n - 1 );
+    for( int i = 0; i < n; i++ ){
+      look[i] = ins[d( rng )];
+    }
+  }
+}
+
+void harness( int maxKeys, const char* csvPath ){
+  ofstream csv( csvPath );
+  csv << "structure,stream,n,op,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,"
+         "bytes_per_key,peak_rss_kb\n";
+  double overhead = clock_overhead( );
+  cout << "harness: clock overhead " << overhead << " ns, results in " << csvPath << endl;
+#ifndef BENCH_MALLOC_SIZE
+  cout << "  (allocations are not counted on this platform; bytes/key reads 0)" << endl;
+#endif
+  const char* streams[] = { "sorted", "random", "zipf", "adversarial" };
+  vector<int> sizes;
+  for( long long n = 1000; n <= maxKeys; n *= 10 ){
+    sizes.push_back( int( n ) );
+  }
+  if( sizes.empty( ) || sizes.back( ) != maxKeys ){
+    sizes.push_back( maxKeys );
+  }
+  for( size_t i = 0; i < sizes.size( ); i++ ){
+    int n = sizes[i];
+    for( int s = 0; s < 4; s++ ){
+      vector<unsigned int> ins;
+      vector<unsigned int> look;
+      harness_stream( streams[s], n, ins, look );
+      cout << streams[s] << " stream of " << n << " keys" << endl;
+      bool degenerate = s == 0 || s == 3;
+      if( degenerate && n > kDegenerateLimit ){
+        cout << "  Tree, ConcurrentTree and CompactTree skipped (quadratic on this stream)"
+             << endl;
+      }else{
+        harness_case<UTree>( "Tree", streams[s], ins, look, overhead, csv );
+        harness_case<ConcurrentTree<unsigned int, unsigned int> >( "ConcurrentTree",
+                                                                   streams[s], ins, look,
+                                                                   overhead, csv );
+        harness_case<CompactTree<unsigned int, unsigned int> >( "CompactTree", streams[s],
+                                                                ins, look, overhead, csv );
+      }
+      harness_case<SplayTree<unsigned int, unsigned int> >( "SplayTree", streams[s],
+                                                            ins, look, overhead, csv );
+      harness_case<LockFreeSkipList<unsigned int, unsigned int> >( "LockFreeSkipList",
+                                                                   streams[s], ins, look,
+                                                                   overhead, csv );
+      harness_case<PersistentTree<unsigned int, unsigned int> >( "PersistentTree",
+                                                                 streams[s], ins, look,
+                                                                 overhead, csv );
+      harness_case<map<unsigned int, unsigned int> >( "std::map", streams[s],
+                                                      ins, look, overhead, csv );
+      harness_case<set<unsigned int> >( "std::set", streams[s], ins, look, overhead, csv );
+    }
+  }
+}
+
+/*
+ * The union, intersection and difference of two trees with
+ * unite, intersect and subtract, compared with inserting (or removing)
+ * the keys of one tree one by one, for a second tree of the same size
+ * and of a hundredth of the size.
+ */
+void setops_bench( int numKeys ){
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  unsigned int maxThreads = thread::hardware_concurrency( );
+  for( int pass = 0; pass < 2; pass++ ){
+    int m = pass == 0 ? numKeys : numKeys / 100 + 1;
+    // Every third key of the other tree is also in the first one.
+    vector<unsigned int> o( m );
+    mt19937 rng( 9 );
+    for( int i = 0; i < m; i++ ){
+      o[i] = i % 3 == 0 ? l[rng( ) % numKeys] : (2 * (rng( ) % numKeys) + 1);
+    }
+    cout << "set operations on " << numKeys << " and " << m << " keys" << endl;
+
+    UTree a;
+    UTree b;
+    for( int i = 0; i < numKeys; i++ ){
+      a.insert( l[i], l[i] );
+    }
+    for( int i = 0; i < m; i++ ){
+      b.insert( o[i], o[i] );
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+    for( UTree::iterator i = b.begin( ); i != b.end( ); ++i ){
+      unsigned int k = i->key( );
+      unsigned int v = i->value( );
+      a.insert( k, v );
+    }
+    double loop = elapsed( start );
+    size_t unionSize = a.size( );
+    start = chrono::steady_clock::now( );
+    for( UTree::iterator i = b.begin( ); i != b.end( ); ++i ){
+      a.remove( i->key( ) );
+    }
+    double removeLoop = elapsed( start );
+    cout << "  insert loop " << loop << " s, remove loop " << removeLoop << " s" << endl;
+
+    for( unsigned int threads = 1; threads <= maxThreads || threads == 1; threads *= 2 ){
+      double seconds[3];
+      for( int op = 0; op < 3; op++ ){
+        a.clear( );
+        b.clear( );
+        for( int i = 0; i < numKeys; i++ ){
+          a.insert( l[i], l[i] );
+        }
+        for( int i = 0; i < m; i++ ){
+          b.insert( o[i], o[i] );
+        }
+        start = chrono::steady_clock::now( );
+        if( op == 0 ){
+          a.unite( b, threads );
+        }else if( op == 1 ){
+          a.intersect( b, threads );
+        }else{
+          a.subtract( b, threads );
+        }
+        seconds[op] = elapsed( start );
+        assert( op != 0 || a.size( ) == unionSize );
+      }
+      cout << "  " << threads << " threads: unite " << seconds[0] << " s, intersect "
+           << seconds[1] << " s, subtract " << seconds[2] << " s" << endl;
+    }
+  }
+}
+
+/*
+ * Memory per key and lookup speed of Tree against CompactTree with and
+ * without parent links, all filled by inserting the same shuffled keys.
+ */
+template <class Map>
+void compact_case( const char* name, Map& m, const vector<unsigned int>& l,
+                   const vector<unsigned int>& q, long long before ){
+  for( size_t i = 0; i < l.size( ); i++ ){
+    unsigned int k = l[i];
+    unsigned int v = l[i];
+    m.insert( k, v );
+  }
+  double bytes = double( liveBytes - before ) / l.size( );
+  size_t hits = 0;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+  for( size_t i = 0; i < q.size( ); i++ ){
+    hits += m.hasKey( q[i] );
+  }
+  double seconds = elapsed( start );
+  cout << "  " << name << ": " << bytes << " bytes/key, " << 1e9 * seconds / q.size( )
+       << " ns/lookup (" << hits << " hits)" << endl;
+}
+
+void compact_bench( int numKeys ){
+  vector<unsigned int> l;
+  vector<unsigned int> q;
+  shuffled_keys( l, numKeys, 1 );
+  int numQueries = numKeys < 1000000 ? 1000000 : numKeys;
+  query_keys( q, numKeys, numQueries, 2 );
+  cout << "compact layouts for " << numKeys << " keys" << endl;
+  {
+    long long before = liveBytes;
+    UTree t;
+    compact_case( "Tree", t, l, q, before );
+  }
+  {
+    long long before = liveBytes;
+    CompactTree<unsigned int, unsigned int, true> t;
+    t.reserve( numKeys );
+    compact_case( "CompactTree", t, l, q, before );
+  }
+  {
+    long long before = liveBytes;
+    CompactTree<unsigned int, unsigned int, false> t;
+    t.reserve( numKeys );
+    compact_case( "CompactTree without parent links", t, l, q, before );
+  }
+}
+
+/*
+ * A stream of updates with a point-in-time view taken every 1000
+ * updates and the last 16 views kept, using Tree with freeze( ) for
+ * the views and using PersistentTree, whose views are handles.
+ */
+void persistent_bench( int numKeys ){
+  const int every = 1000;
+  const size_t kept = 16;
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  int numUpdates = numKeys < 200000 ? numKeys : 200000;
+  vector<unsigned int> u;
+  query_keys( u, numKeys, numUpdates, 6 );
+  cout << numUpdates << " updates to " << numKeys << " keys, a view every " << every
+       << " updates, last " << kept << " kept" << endl;
+  {
+    UTree t;
+    for( int i = 0; i < numKeys; i++ ){
+      t.insert( l[i], l[i] );
+    }
+    vector<FrozenTree<unsigned int, unsigned int> > views;
+    long long before = liveBytes;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+    for( int i = 0; i < numUpdates; i++ ){
+      unsigned int k = u[i];
+      if( ! t.remove( k ) ){
+        t.insert( k, k );
+      }
+      if( i % every == 0 ){
+        if( views.size( ) == kept ){
+          views.erase( views.begin( ) );
+        }
+        views.push_back( t.freeze( ) );
+      }
+    }
+    double seconds = elapsed( start );
+    cout << "  Tree + freeze: " << 1e9 * seconds / numUpdates << " ns/update, "
+         << double( liveBytes - before ) / (1 << 20) << " MB held by the views" << endl;
+  }
+  {
+    PersistentTree<unsigned int, unsigned int> t;
+    for( int i = 0; i < numKeys; i++ ){
+      t = t.insert( l[i], l[i] );
+    }
+    vector<PersistentTree<unsigned int, unsigned int> > views;
+    long long before = liveBytes;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+    for( int i = 0; i < numUpdates; i++ ){
+      unsigned int k = u[i];
+      if( t.hasKey( k ) ){
+        t = t.remove( k );
+      }else{
+        t = t.insert( k, k );
+      }
+      if( i % every == 0 ){
+        if( views.size( ) == kept ){
+          views.erase( views.begin( ) );
+        }
+        views.push_back( t );
+      }
+    }
+    double seconds = elapsed( start );
+    cout << "  PersistentTree: " << 1e9 * seconds / numUpdates << " ns/update, "
+         << double( liveBytes - before ) / (1 << 20) << " MB held by the views" << endl;
+  }
+}
+
+/*
+ * A string ordering that Tree knows nothing about, so a search has to
+ * call it twice per level to tell "less", "equal" and "greater" apart.
+ */
+struct PlainStringLess{
+  bool operator ( )( const string& a, const string& b ) const{
+    return( a < b );
+  }
+};
+
+/*
+ * Time t.hasKey( q ) over the queries, where Query makes the key passed
+ * to hasKey from a query string.
+ */
+template <class Map, class Query>
+void compare_case( const char* name, const vector<string>& keys,
+                   const vector<unsigned int>& l, const vector<string>& queries,
+                   Query query ){
+  Map t;
+  for( size_t i = 0; i < keys.size( ); i++ ){
+    t.insert( keys[i], l[i] );
+  }
+  size_t hits = 0;
+  long long before = allocations;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+  for( size_t i = 0; i < queries.size( ); i++ ){
+    hits += t.hasKey( query( queries[i] ) );
+  }
+  double seconds = elapsed( start );
+  report( name, queries.size( ), seconds, hits );
+  cout << "    " << double( allocations - before ) / queries.size( )
+       << " allocations/lookup" << endl;
+}
+
+string as_string( const string& q ){
+  return( string( q.c_str( ) ) );
+}
+
+const char* as_c_string( const string& q ){
+  return( q.c_str( ) );
+}
+
+/*
+ * Lookups in a tree of string keys, too long for the short string
+ * optimization, made with const char* queries. With std::less each
+ * query has to be turned into a std::string first; the transparent
+ * TreeLess compares the C string in place. Both take one three way
+ * comparison per level, PlainStringLess takes two.
+ */
+void compare_bench( int numKeys ){
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  int numQueries = numKeys < 1000000 ? numKeys : 1000000;
+  vector<unsigned int> q;
+  query_keys( q, numKeys, numQueries, 2 );
+  vector<string> keys( numKeys );
+  vector<string> queries( numQueries );
+  char buf[64];
+  for( int i = 0; i < numKeys; i++ ){
+    snprintf( buf, sizeof(buf), "customer-%010u-record", l[i] );
+    keys[i] = buf;
+  }
+  for( int i = 0; i < numQueries; i++ ){
+    snprintf( buf, sizeof(buf), "customer-%010u-record", q[i] );
+    queries[i] = buf;
+  }
+  cout << numQueries << " string lookups in " << numKeys << " keys" << endl;
+  compare_case<Tree<string, unsigned int, PlainStringLess> >(
+    "PlainStringLess, string key", keys, l, queries, as_string );
+  compare_case<Tree<string, unsigned int> >(
+    "std::less, string key", keys, l, queries, as_string );
+  compare_case<Tree<string, unsigned int, TreeLess> >(
+    "TreeLess, const char* key", keys, l, queries, as_c_string );
+}
+
+/*
+ * hasKey with and without the Bloom filter front end as the share of
+ * lookups that hit goes from none to all. The misses are the odd
+ * numbers between the keys, so without the filter each one walks to
+ * a leaf.
+ */
+void filter_bench( int numKeys ){
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  int numQueries = numKeys < 1000000 ? numKeys : 1000000;
+  UTree plain;
+  UTree filtered;
+  filtered.enableFilter( );
+  for( int i = 0; i < numKeys; i++ ){
+    plain.insert( l[i], l[i] );
+    filtered.insert( l[i], l[i] );
+  }
+  TreeBloomFilter<unsigned int> f( 10 );
+  f.reset( numKeys );
+  for( int i = 0; i < numKeys; i++ ){
+    f.add( l[i] );
+  }
+  size_t fp = 0;
+  for( int i = 0; i < numKeys; i++ ){
+    fp += f.mayContain( 2 * i + 1 );
+  }
+  // Copies lay their blocks out afresh and must answer as f does.
+  TreeBloomFilter<unsigned int> g( f );
+  TreeBloomFilter<unsigned int> h( 4 );
+  h = g;
+  for( int i = 0; i < 2 * numKeys; i++ ){
+    assert( g.mayContain( i ) == f.mayContain( i ) && h.mayContain( i ) == f.mayContain( i ) );
+  }
+  filtered.hasKey( 0 );
+  cout << numQueries << " lookups in " << numKeys << " keys, filter "
+       << double( filtered.filterBytes( ) ) / numKeys << " bytes/key, "
+       << 100.0 * fp / numKeys << "% false positives at 10 bits/key" << endl;
+  const double ratios[] = { 0.0, 0.1, 0.5, 0.9, 1.0 };
+  for( size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++ ){
+    mt19937 rng( 7 );
+    uniform_int_distribution<int> pick( 0, numKeys - 1 );
+    bernoulli_distribution hit( ratios[r] );
+    vector<unsigned int> q( numQueries );
+    for( int i = 0; i < numQueries; i++ ){
+      q[i] = 2 * pick( rng ) + (hit( rng ) ? 0 : 1);
+    }
+    cout << " " << 100 * ratios[r] << "% hits" << endl;
+    size_t hits = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+    for( int i = 0; i < numQueries; i++ ){
+      hits += plain.hasKey( q[i] );
+    }
+    report( "no filter", numQueries, elapsed( start ), hits );
+    hits = 0;
+    start = chrono::steady_clock::now( );
+    for( int i = 0; i < numQueries; i++ ){
+      hits += filtered.hasKey( q[i] );
+    }
+    report( "Bloom filter", numQueries, elapsed( start ), hits );
+  }
+}
+
+/*
+ * Copying a tree with the copy constructor against inserting its keys
+ * again in the order they first came in (in key order the copy would
+ * degenerate into a list), and merging two trees against unite and
+ * against an insert loop.
+ */
+void copy_bench( int numKeys ){
+  vector<unsigned int> l;
+  shuffled_keys( l, numKeys, 1 );
+  UTree t;
+  for( int i = 0; i < numKeys; i++ ){
+    t.insert( l[i], l[i] );
+  }
+  cout << "copying and merging trees of " << numKeys << " keys" << endl;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+  UTree byInsert;
+  for( int i = 0; i < numKeys; i++ ){
+    byInsert.insert( l[i], l[i] );
+  }
+  cout << "  insert loop copy: " << elapsed( start ) << " s" << endl;
+  start = chrono::steady_clock::now( );
+  UTree copy( t );
+  cout << "  copy constructor: " << elapsed( start ) << " s" << endl;
+  start = chrono::steady_clock::now( );
+  UTree moved( std::move( copy ) );
+  cout << "  move constructor: " << elapsed( start ) << " s" << endl;
+
+  // The other tree holds the odd numbers, so no key is in both.
+  UTree other;
+  for( int i = 0; i < numKeys; i++ ){
+    other.insert( l[i] + 1, l[i] );
+  }
+  for( int op = 0; op < 3; op++ ){
+    UTree a( t );
+    UTree b( other );
+    start = chrono::steady_clock::now( );
+    if( op == 0 ){
+      for( UTree::iterator i = b.begin( ); i != b.end( ); ++i ){
+        a.insert( i->key( ), i->value( ) );
+      }
+    }else if( op == 1 ){
+      a.unite( b, 1 );
+    }else{
+      a.merge( b );
+    }
+    double seconds = elapsed( start );
+    assert( a.size( ) == size_t( 2 * numKeys ) );
+    const char* names[] = { "insert loop", "unite", "merge" };
+    cout << "  " << names[op] << ": " << seconds << " s" << endl;
+  }
+}
+
+/*
+ * Building a tree from numKeys unsorted keys, about a third of them
+ * repeated, by inserting them one at a time and with
+ * build_from_unsorted on 1, 2, 4, ... threads up to 64 or the number of
+ * cores, whichever is larger. The insert loop is skipped above 10M keys.
+ */
+void unsorted_bench( int numKeys ){
+  mt19937 rng( 3 );
+  uniform_int_distribution<unsigned int> d( 0, numKeys - 1 );
+  vector<unsigned int> keys( numKeys );
+  for( int i = 0; i < numKeys; i++ ){
+    keys[i] = d( rng );
+  }
+  cout << "building from " << numKeys << " unsorted keys" << endl;
+  unsigned int cores = thread::hardware_concurrency( );
+  unsigned int most = cores > 64 ? cores : 64;
+  double one = 0;
+  for( unsigned int threads = 1; threads <= most; threads *= 2 ){
+    UTree t;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+    t.build_from_unsorted( keys.begin( ), keys.end( ), keys.begin( ), threads );
+    double seconds = elapsed( start );
+    if( threads == 1 ){
+      one = seconds;
+    }
+    cout << "  build_from_unsorted, " << threads << " threads: " << seconds
+         << " s, speedup " << one / seconds << (threads > cores ? " (oversubscribed)" : "")
+         << endl;
+  }
+  // Last, since the nodes it frees leave the heap scattered.
+  if( numKeys <= 10000000 ){
+    UTree t;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+    for( int i = 0; i < numKeys; i++ ){
+      t.insert( keys[i], i );
+    }
+    cout << "  insert loop: " << elapsed( start ) << " s, " << t.size( ) << " keys" << endl;
+  }
+}
+
+struct Span{
+  unsigned int lo;
+  unsigned int hi;
+};
+
+/*
+ * Adds one to count for each interval reported.
+ */
+struct CountSpans{
+  size_t* count;
+  explicit CountSpans( size_t* c ) : count( c ) { }
+  void operator ( )( unsigned int, unsigned int, unsigned int ) const{
+    (*count)++;
+  }
+};
+
+/*
+ * Overlap and stabbing queries on numKeys time ranges, with the
+ * starts spread over [0, 1000 numKeys) and lengths up to 2000, against
+ * a linear scan of the same ranges kept in a vector.
+ */
+void interval_bench( int numKeys ){
+  const int numQueries = 1000;
+  const unsigned int width = 1000;
+  mt19937 rng( 1 );
+  uniform_int_distribution<unsigned int> start( 0, 1000u * numKeys );
+  uniform_int_distribution<unsigned int> length( 0, 2000 );
+  vector<Span> spans( numKeys );
+  IntervalTree<unsigned int, unsigned int> t;
+  chrono::steady_clock::time_point begin = chrono::steady_clock::now( );
+  for( int i = 0; i < numKeys; i++ ){
+    spans[i].lo = start( rng );
+    spans[i].hi = spans[i].lo + length( rng );
+    t.insert( spans[i].lo, spans[i].hi, i );
+  }
+  cout << numKeys << " intervals inserted in " << elapsed( begin ) << " s, "
+       << numQueries << " queries" << endl;
+  vector<unsigned int> q( numQueries );
+  for( int i = 0; i < numQueries; i++ ){
+    q[i] = start( rng );
+  }
+  for( int stab = 0; stab < 2; stab++ ){
+    unsigned int w = stab ? 0 : width;
+    size_t found = 0;
+    begin = chrono::steady_clock::now( );
+    for( int i = 0; i < numQueries; i++ ){
+      t.overlap( q[i], q[i] + w, CountSpans( &found ) );
+    }
+    double seconds = elapsed( begin );
+    cout << "  IntervalTree " << (stab ? "stab" : "overlap") << ": "
+         << 1e9 * seconds / numQueries << " ns/query ("
+         << double( found ) / numQueries << " intervals/query)" << endl;
+    found = 0;
+    begin = chrono::steady_clock::now( );
+    for( int i = 0; i < numQueries; i++ ){
+      unsigned int lo = q[i];
+      unsigned int hi = q[i] + w;
+      for( size_t j = 0; j < spans.size( ); j++ ){
+        found += spans[j].lo <= hi && lo <= spans[j].hi;
+      }
+    }
+    seconds = elapsed( begin );
+    cout << "  linear scan " << (stab ? "stab" : "overlap") << ": "
+         << 1e9 * seconds / numQueries << " ns/query ("
+         << double( found ) / numQueries << " intervals/query)" << endl;
+  }
+}
+
+int main( int argc, char** argv ){
+  int numKeys;
+  const char* which = "all";
+  if( argc < 2 ){
+    cout << "Usage: " << argv[0] << " numKeys [benchmark]\n";
+    exit(1);
+  }
+  numKeys = atoi( argv[1] );
+  if( numKeys < 1 ){
+    cout << "numKeys must be positive.\n";
+    exit(1);
+  }
+  if( argc > 2 ){
+    which = argv[2];
+  }
+
+  bool all = strcmp( which, "all" ) == 0;
+  if( strcmp( which, "harness" ) == 0 ){
+    harness( numKeys, argc > 3 ? argv[3] : "Tree_bench.csv" );
+  }
+  if( all || strcmp( which, "freeze" ) == 0 ){
+    freeze_bench( numKeys );
+  }
+  if( all || strcmp( which, "build" ) == 0 ){
+    build_bench( numKeys );
+  }
+  if( all || strcmp( which, "range" ) == 0 ){
+    range_bench( numKeys );
+  }
+  if( all || strcmp( which, "batch" ) == 0 ){
+    batch_bench( numKeys );
+  }
+  if( all || strcmp( which, "setops" ) == 0 ){
+    setops_bench( numKeys );
+  }
+  if( all || strcmp( which, "compact" ) == 0 ){
+    compact_bench( numKeys );
+  }
+  if( all || strcmp( which, "persistent" ) == 0 ){
+    persistent_bench( numKeys );
+  }
+  if( all || strcmp( which, "compare" ) == 0 ){
+    compare_bench( numKeys );
+  }
+  if( all || strcmp( which, "filter" ) == 0 ){
+    filter_bench( numKeys );
+  }
+  if( all || strcmp( which, "interval" ) == 0 ){
+    interval_bench( numKeys );
+  }
+  if( all || strcmp( which, "copy" ) == 0 ){
+    copy_bench( numKeys );
+  }
+  if( all || strcmp( which, "unsorted" ) == 0 ){
+    unsorted_bench( numKeys );
+  }
+  if( all || strcmp( which, "snapshot" ) == 0 ){
+    snapshot_bench( numKeys );
+  }
+  if( all || strcmp( which, "export" ) == 0 ){
+    export_bench( numKeys );
+  }
+  if( all || strcmp( which, "splay" ) == 0 ){
+    splay_bench( numKeys );
+  }
+  if( all || strcmp( which, "concurrent" ) == 0 ){
+    concurrent_bench( numKeys );
+  }
+  if( all || strcmp( which, "skiplist" ) == 0 ){
+    skiplist_bench( numKeys );
+  }
+  return(0);
+}
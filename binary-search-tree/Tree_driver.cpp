@@ -9,12 +9,16 @@
  */
 
 #include "Tree.h"
+#include "TreeExport.h"
 #include <iostream>
 #include <cstdlib>
 #include <fstream>
 #include <vector>
 #include <algorithm>
 #include <iterator>
+#include <ctime>
+#include <cstring>
+#include <string>
 
 using namespace std;
 
@@ -94,23 +98,16 @@ void del( Tree<unsigned int, unsigned int>& t, vector<unsigned int>& l, int numK
 }
 
 #define REMOVE
-void writeGraphViz( Tree<unsigned int, unsigned int>& t, const char* fname ){
-  char buffer[255];
-  pid_t child;
-  sprintf( buffer, "%s.dot", fname );
-  ofstream f( buffer );
-  t.write( f );
-  f.close( );
-  sprintf( buffer, "dot -Tpdf %s.dot -o %s.pdf", fname, fname );
-  child = fork( );
-  if( child == 0 ){
-    system( buffer );
+void writeGraphViz( TreeExporter& exporter, Tree<unsigned int, unsigned int>& t,
+                    const char* fname ){
+  TreeSnapshot<unsigned int> s = t.snapshot( );
+  string base( fname );
 #ifdef REMOVE
-    sprintf( buffer, "%s.dot", fname);
-    remove( buffer );
+  bool removeDot = true;
+#else
+  bool removeDot = false;
 #endif
-    exit(0);
-  }
+  exporter.submit( s, base + ".dot", TreeExporter::kDot, base + ".pdf", removeDot );
 }
 
 void writeLinks( Tree<unsigned int, unsigned int>& t, const char* fname ){
@@ -119,6 +116,28 @@ void writeLinks( Tree<unsigned int, unsigned int>& t, const char* fname ){
   f.close( );
 }
 
+/*
+ * Walk t through a const reference and check that the keys come out
+ * in ascending order, and that an iterator and a const_iterator over
+ * the same tree agree.
+ */
+void const_walk( Tree<unsigned int, unsigned int>& t ){
+  const Tree<unsigned int, unsigned int>& c = t;
+  Tree<unsigned int, unsigned int>::iterator i = t.begin( );
+  size_t count = 0;
+  for( Tree<unsigned int, unsigned int>::const_iterator j = c.begin( ); j != c.end( ); ++j, ++i ){
+    assert( i == j );
+    assert( count == 0 || prev( j )->key( ) < j->key( ) );
+    count++;
+  }
+  assert( i == t.end( ) && count == c.size( ) );
+  if( count > 0 ){
+    Tree<unsigned int, unsigned int>::const_iterator k = c.find( c.begin( )->key( ) );
+    assert( k == t.begin( ) && c.lower_bound( k->key( ) ) == k );
+  }
+  cout << "Walked " << count << " keys through a const_iterator" << endl;
+}
+
 /*void insert_find_test( int numKeys ){
   Tree<unsigned int> t;
   vector<unsigned int> l;
@@ -154,11 +173,14 @@ void writeLinks( Tree<unsigned int, unsigned int>& t, const char* fname ){
   for( int i = 0; i < numKeys; i++ ){
     cout << "The inorder successor of " << l[i] << " is " << t.inorderSuccessorTest( l[i] ) << endl;
   }
-  writeGraphViz( t, "treedump-is" );
+  writeGraphViz( exporter, t, "treedump-is" );
   writeLinks( t, "links-is.txt" );
 }*/
 
 void insertion_deletion_test( int numKeys ){
+  // Dumps are written and rendered by a background thread; it finishes
+  // the outstanding ones when the test returns.
+  TreeExporter exporter;
   Tree<unsigned int, unsigned int> t;
   vector<unsigned int> l;
   time_t now = time(NULL);
@@ -178,51 +200,341 @@ void insertion_deletion_test( int numKeys ){
   random_shuffle( l.begin( ), l.end(), rng );
   
   insert( t, l, numKeys );
+  const_walk( t );
 
   random_shuffle( l.begin( ), l.end(), rng );
   //copy(l.begin(), l.end(), std::ostream_iterator<unsigned int>(std::cout, "\n") );
 
   cout << "Writing dump 1\n";
-  writeGraphViz( t, "treedump-1" );
+  writeGraphViz( exporter, t, "treedump-1" );
   writeLinks( t, "links-1.txt" );
 
   del( t, l, numKeys / 3 );
   empty( t );
   cout << "Writing dump 2\n";
-  writeGraphViz( t, "treedump-2" );
+  writeGraphViz( exporter, t, "treedump-2" );
   writeLinks( t, "links-2.txt" );
 
   del( t, l, numKeys / 3 );
   empty( t );
   cout << "Writing dump 3\n";
-  writeGraphViz( t, "treedump-3" );
+  writeGraphViz( exporter, t, "treedump-3" );
   writeLinks( t, "links-3.txt" );
   
   /*insert( t, l, numKeys / 3 );
   random_shuffle( l.begin( ), l.end(), rng );
   cout << "Writing dump 4\n";
-  writeGraphViz( t, "treedump-4" );
+  writeGraphViz( exporter, t, "treedump-4" );
   writeLinks( t, "links-4.txt" );*/
 
   del( t, l, numKeys / 3 );
   empty( t );
   cout << "Writing dump 5\n";
-  writeGraphViz( t, "treedump-5" );
+  writeGraphViz( exporter, t, "treedump-5" );
   writeLinks( t, "links-5.txt" );
 }
 
 void create_delete_test( int numKeys ){
-  Tree<unsigned int, unsigned int> *t = new Tree<unsigned int, unsigned int>( );
+  Tree<unsigned int, unsigned int> t;
   vector<unsigned int> l;
   //BRNG rng(time(NULL));
   BRNG rng(1);
   srand(time(NULL));
 
-  empty( *t );
-  insert( *t, l, numKeys );
+  empty( t );
+  insert( t, l, numKeys );
+  // A copy owns its nodes; a move takes them and leaves its source empty.
+  Tree<unsigned int, unsigned int> copy( t );
+  Tree<unsigned int, unsigned int> moved( std::move( copy ) );
+  assert( copy.isEmpty( ) && moved.size( ) == t.size( ) );
+  // Trees in a vector are moved, not copied, when it grows.
+  static_assert( std::is_nothrow_move_constructible<Tree<unsigned int, unsigned int> >::value &&
+                 std::is_nothrow_move_assignable<Tree<unsigned int, unsigned int> >::value,
+                 "Tree's move operations must be noexcept" );
+}
+
+/*
+ * Make t a single chain of the keys first, first + step, ... in
+ * ascending order, n keys in all: the first key is inserted and the
+ * rest are added with insert_many, each below the last.
+ */
+void build_chain( Tree<unsigned int, unsigned int>& t, unsigned int first,
+                  unsigned int step, int n ){
+  vector<unsigned int> k;
+  for( int i = 1; i < n; i++ ){
+    k.push_back( first + i * step );
+  }
+  t.insert( first, first );
+  t.insert_many( &k[0], &k[0], k.size( ) );
+  int depth = 0;
+  for( TreeNode<unsigned int, unsigned int>* x = t.maximum( ); x->parent( ); x = x->parent( ) ){
+    depth++;
+  }
+  assert( depth == n - 1 );
+}
+
+/*
+ * Counts the characters written to it and throws them away, so the
+ * dumps of a long chain can be checked without holding them in memory.
+ */
+class CountingBuffer : public streambuf{
+public:
+  CountingBuffer( ) : count( 0 ){ }
+  size_t count;
+protected:
+  int_type overflow( int_type c ){
+    count++;
+    return( c );
+  }
+  streamsize xsputn( const char*, streamsize n ){
+    count += n;
+    return( n );
+  }
+};
+
+/*
+ * Build a tree that is a single chain of numKeys nodes, then search
+ * it, write it, copy it and tear it down. Anything that recursed once
+ * per level would overflow the stack long before the end of a chain
+ * of 100000000 nodes, which is the size to run it at:
+ *
+ *   Tree_driver 100000000 degenerate
+ *
+ * The chain and its copy take about 10 GB.
+ */
+void degenerate_test( int numKeys ){
+  Tree<unsigned int, unsigned int> *t = new Tree<unsigned int, unsigned int>( );
+  unsigned int last = numKeys - 1;
+  clock_t start = clock( );
+  build_chain( *t, 0, 1, numKeys );
+  assert( t->size( ) == size_t( numKeys ) );
+  assert( t->minimum( )->key( ) == 0 && t->maximum( )->key( ) == last );
+  cout << "Built a chain of " << numKeys << " keys in "
+       << double( clock( ) - start ) / CLOCKS_PER_SEC << " s" << endl;
+
+  start = clock( );
+  int count = 0;
+  for( Tree<unsigned int, unsigned int>::iterator i = t->begin( ); i != t->end( ); ++i ){
+    count++;
+  }
+  assert( count == numKeys );
+  assert( t->hasKey( 0 ) && t->hasKey( last / 2 ) && t->hasKey( last ) );
+  assert( ! t->hasKey( last + 1 ) );
+  assert( t->find( last ) != t->end( ) && t->find( last )->value( ) == last );
+  cout << "Walked and searched " << count << " keys in "
+       << double( clock( ) - start ) / CLOCKS_PER_SEC << " s" << endl;
+
+  start = clock( );
+  CountingBuffer dotBuffer, linksBuffer;
+  ostream dot( &dotBuffer ), links( &linksBuffer );
+  t->write( dot );
+  t->writeLinks( links );
+  assert( dotBuffer.count > size_t( numKeys ) && linksBuffer.count > size_t( numKeys ) );
+  cout << "Wrote the chain in "
+       << double( clock( ) - start ) / CLOCKS_PER_SEC << " s" << endl;
+
+  start = clock( );
+  Tree<unsigned int, unsigned int> copy( *t );
+  assert( copy.size( ) == t->size( ) && copy.hasKey( last ) );
+  assert( t->remove( last ) && t->remove( 0 ) );
+  assert( t->size( ) == size_t( numKeys - 2 ) && ! t->hasKey( last ) );
   delete t;
+  copy.clear( );
+  assert( copy.isEmpty( ) );
+  cout << "Copied and destroyed the chain in "
+       << double( clock( ) - start ) / CLOCKS_PER_SEC << " s" << endl;
+}
+
+/*
+ * Check that t holds exactly the keys in expected, each paired with
+ * itself.
+ */
+void check_keys( Tree<unsigned int, unsigned int>& t, const vector<unsigned int>& expected ){
+  assert( t.size( ) == expected.size( ) );
+  size_t i = 0;
+  for( Tree<unsigned int, unsigned int>::iterator j = t.begin( ); j != t.end( ); ++j, ++i ){
+    assert( j->key( ) == expected[i] && j->value( ) == expected[i] );
+  }
+  assert( i == expected.size( ) );
+}
+
+/*
+ * Split, join, unite, intersect and subtract trees that are chains of
+ * numKeys nodes. None of them may recurse once per level; run it with
+ * 500000 to 2000000 keys to check.
+ */
+void degenerate_setops_test( int numKeys ){
+  vector<unsigned int> x;
+  vector<unsigned int> y;
+  for( int i = 0; i < numKeys; i++ ){
+    x.push_back( 2 * i );
+    y.push_back( 3 * i );
+  }
+  clock_t start = clock( );
+  {
+    Tree<unsigned int, unsigned int> a, less, greater;
+    build_chain( a, 0, 2, numKeys );
+    unsigned int key = x[numKeys / 2];
+    unsigned int value = 0;
+    assert( a.split( key, less, greater, &value ) && value == key );
+    assert( a.isEmpty( ) );
+    assert( less.size( ) == size_t( numKeys / 2 ) );
+    assert( greater.size( ) == size_t( numKeys - numKeys / 2 - 1 ) );
+    a.join( less, key, value, greater );
+    assert( less.isEmpty( ) && greater.isEmpty( ) );
+    check_keys( a, x );
+  }
+  cout << "Split and joined a chain of " << numKeys << " keys in "
+       << double( clock( ) - start ) / CLOCKS_PER_SEC << " s" << endl;
+
+  const char* names[] = { "United", "Intersected", "Subtracted" };
+  for( int op = 0; op < 3; op++ ){
+    vector<unsigned int> expected;
+    if( op == 0 ){
+      set_union( x.begin( ), x.end( ), y.begin( ), y.end( ), back_inserter( expected ) );
+    }else if( op == 1 ){
+      set_intersection( x.begin( ), x.end( ), y.begin( ), y.end( ), back_inserter( expected ) );
+    }else{
+      set_difference( x.begin( ), x.end( ), y.begin( ), y.end( ), back_inserter( expected ) );
+    }
+    Tree<unsigned int, unsigned int> a, b;
+    build_chain( a, 0, 2, numKeys );
+    build_chain( b, 0, 3, numKeys );
+    start = clock( );
+    if( op == 0 ){
+      a.unite( b, 1 );
+    }else if( op == 1 ){
+      a.intersect( b, 1 );
+    }else{
+      a.subtract( b, 1 );
+    }
+    double seconds = double( clock( ) - start ) / CLOCKS_PER_SEC;
+    assert( b.isEmpty( ) );
+    check_keys( a, expected );
+    cout << names[op] << " two chains of " << numKeys << " keys in "
+         << seconds << " s" << endl;
+  }
+}
+
+/*
+ * A key with no std::hash, ordered by PointLess.
+ */
+struct Point{
+  int x;
+  int y;
+};
+
+struct PointLess{
+  bool operator ( )( const Point& a, const Point& b ) const{
+    return( a.x < b.x || (a.x == b.x && a.y < b.y) );
+  }
+};
+
+ostream& operator <<( ostream& out, const Point& p ){
+  out << "(" << p.x << ", " << p.y << ")";
+  return( out );
+}
+
+/*
+ * A tree of keys that std::hash can not hash still inserts, finds,
+ * iterates, copies and removes; only the filter and the treap
+ * operations need a hash.
+ */
+void unhashable_key_test( int numKeys ){
+  Tree<Point, int, PointLess> t;
+  for( int i = 0; i < numKeys; i++ ){
+    Point p = { i % 7, i };
+    t.insert( p, i );
+  }
+  assert( t.size( ) == size_t( numKeys ) );
+  Point first = { 0, 0 };
+  Point absent = { 7, 0 };
+  assert( t.hasKey( first ) && ! t.hasKey( absent ) );
+  assert( t.find( first )->value( ) == 0 );
+  Tree<Point, int, PointLess> copy( t );
+  int count = 0;
+  Point previous = { -1, -1 };
+  for( Tree<Point, int, PointLess>::const_iterator i = copy.cbegin( ); i != copy.cend( ); ++i ){
+    assert( PointLess( )( previous, i->key( ) ) );
+    previous = i->key( );
+    count++;
+  }
+  assert( count == numKeys );
+  assert( t.remove( first ) && ! t.hasKey( first ) && copy.hasKey( first ) );
+  cout << "Inserted, walked and removed " << numKeys << " unhashable keys" << endl;
 }
 
+#ifdef TREE_ORDER_STATISTICS
+/*
+ * Check rank, select and count_range on t against s, the same keys in
+ * a sorted vector. The keys are all even, so the odd probes fall
+ * between them.
+ */
+void check_order( Tree<unsigned int, unsigned int>& t, const vector<unsigned int>& s ){
+  assert( t.size( ) == s.size( ) );
+  for( size_t k = 0; k < s.size( ); k++ ){
+    assert( t.select( k )->key( ) == s[k] );
+    assert( t.rank( s[k] ) == k );
+    assert( t.rank( s[k] + 1 ) == k + 1 );
+  }
+  assert( t.select( s.size( ) ) == t.end( ) );
+  assert( t.rank( 0 ) == 0 );
+  for( size_t k = 0; k < s.size( ); k++ ){
+    unsigned int lo = rand( ) % (2 * s.size( ) + 2);
+    unsigned int hi = rand( ) % (2 * s.size( ) + 2);
+    size_t expected = hi < lo ? 0 :
+      size_t( upper_bound( s.begin( ), s.end( ), hi ) -
+              lower_bound( s.begin( ), s.end( ), lo ) );
+    assert( t.count_range( lo, hi ) == expected );
+  }
+}
+
+/*
+ * Insert numKeys keys a third at a time through insert,
+ * insert_recursive and insert_many, then remove half of them, checking
+ * the order statistics against a sorted vector as the tree changes.
+ * Build with -DTREE_ORDER_STATISTICS.
+ */
+void order_statistics_test( int numKeys ){
+  Tree<unsigned int, unsigned int> t;
+  vector<unsigned int> l;
+  vector<unsigned int> s;
+  BRNG rng(1);
+  int third = numKeys / 3;
+  int every = numKeys / 8 > 0 ? numKeys / 8 : 1;
+
+  for( int i = 0; i < numKeys; i++ ){
+    l.push_back( 2 * i );
+  }
+  random_shuffle( l.begin( ), l.end( ), rng );
+  for( int i = 0; i < third; i++ ){
+    t.insert( l[i], l[i] );
+  }
+  for( int i = third; i < 2 * third; i++ ){
+    t.insert_recursive( l[i], l[i] );
+  }
+  s.assign( l.begin( ), l.begin( ) + 2 * third );
+  sort( s.begin( ), s.end( ) );
+  check_order( t, s );
+  t.insert_many( &l[2 * third], &l[2 * third], numKeys - 2 * third );
+  s = l;
+  sort( s.begin( ), s.end( ) );
+  check_order( t, s );
+
+  random_shuffle( l.begin( ), l.end( ), rng );
+  for( int i = 0; i < numKeys / 2; i++ ){
+    t.remove( l[i] );
+    s.erase( lower_bound( s.begin( ), s.end( ), l[i] ) );
+    if( i % every == 0 ){
+      check_order( t, s );
+    }
+  }
+  check_order( t, s );
+  cout << "Checked rank, select and count_range over " << numKeys
+       << " keys" << endl;
+}
+#endif
+
 int main( int argc, char** argv ){
   int numKeys;
   if( argc < 2 ){
@@ -239,7 +551,19 @@ int main( int argc, char** argv ){
   //rotation_test( );
   //insert_find_test( numKeys );
   //inorder_test( numKeys );
-  insertion_deletion_test( numKeys );
+  if( argc > 2 && strcmp( argv[2], "degenerate" ) == 0 ){
+    degenerate_test( numKeys );
+  }else if( argc > 2 && strcmp( argv[2], "chains" ) == 0 ){
+    degenerate_setops_test( numKeys );
+  }else if( argc > 2 && strcmp( argv[2], "unhashable" ) == 0 ){
+    unhashable_key_test( numKeys );
+#ifdef TREE_ORDER_STATISTICS
+  }else if( argc > 2 && strcmp( argv[2], "order" ) == 0 ){
+    order_statistics_test( numKeys );
+#endif
+  }else{
+    insertion_deletion_test( numKeys );
+  }
   //create_delete_test(numKeys);
   return(0);
 }
@@ -20,6 +20,7 @@
 
 #include "GLSLShader.h"
 #include "transformations.h"
+#include "matrix_simd.h"
 #include "glut_teapot.h"
 
 void msglVersion(void){
@@ -342,7 +343,9 @@ public:
 
     modelViewMatrix = lookat(eyePosition, centerPosition, upVector);
 
-    normalMatrix = modelViewMatrix.inverse().transpose( );
+    // The modelview matrix is affine, so its inverse transpose can skip
+    // the general inverse.
+    mat4NormalMatrix( (float*)normalMatrix, (const float*)modelViewMatrix );
 
     // Set light & material properties for the teapot;
     // lights are transformed by current modelview matrix
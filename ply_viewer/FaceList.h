@@ -37,25 +37,28 @@
 
 /*
  * Macro to allocate/free 2D arrays using C constructs
+ * The rows share one block, so varName[0] is also the whole array as
+ * dim_x * dim_y contiguous values.
  */
 #define msAlloc2D( type, varName, dim_x, dim_y ) \
 { \
 	int __i; \
+	type *__block; \
 	if( !((varName) = (type**)calloc( (dim_x), sizeof(type*) )) ){ \
 		fprintf( stderr, "Could not allocate memory." ); \
 	} \
-	for( __i = 0; __i < dim_x; __i++ ){ \
-		if( !((varName)[__i] = (type*)calloc( (dim_y), sizeof(type) )) ){ \
+	if( !(__block = (type*)calloc( size_t(dim_x) * (dim_y), sizeof(type) )) ){ \
 		fprintf( stderr, "Could not allocate memory." ); \
-		} \
+	} \
+	for( __i = 0; __i < dim_x; __i++ ){ \
+		(varName)[__i] = __block + size_t(__i) * (dim_y); \
 	} \
 }
 
 #define msFree2D( varName, dim_x, dim_y ) \
 { \
-	int __i; \
-	for( __i = 0; __i < dim_x; __i++ ){ \
-		free( varName[__i] ); \
+	if( (dim_x) > 0 ){ \
+		free( (varName)[0] ); \
 	} \
 	free( varName ); \
 }
@@ -104,6 +107,7 @@ public:
   
   ~FaceList( ){
 		msFree2D( vertices, vc, 3 );
+		msFree2D( colors, vc, 3 );
 		msFree2D( v_normals, vc, 3 );
 		msFree2D( f_normals, fc, 3 );
     msFree2D( faces, fc, 3 );
@@ -0,0 +1,439 @@
+/*
+ * Copyright (c) 2013 Michael Shafae
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * $Id$
+ *
+ */
+
+
+/*
+ * Batched vertex transforms; see VertexTransform.h.
+ *
+ * Every layout comes down to a stream of 3-vectors. The SSE2 code
+ * transforms two of them at a time: it loads their coordinates into
+ * one register each for x, y and z, computes the results for both with
+ * the same instructions and stores them back. Interleaved positions
+ * and normals alternate in the stream, so one lane of each register
+ * holds a position and the other a normal, and each lane has its own
+ * coefficients.
+ */
+
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "VertexTransform.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define VT_X86
+#include <emmintrin.h>
+#define SSE2_TARGET __attribute__((target("sse2")))
+#endif
+
+/*
+ * An affine map of 3-vectors: the columns of a 3x3 matrix and a
+ * translation, and whether to normalize the result.
+ */
+typedef struct Affine3{
+  double c[4][3];
+  bool normalize;
+}Affine3;
+
+static void positionMap( Affine3& a, const double *m ){
+  for( int j = 0; j < 4; j++ ){
+    for( int i = 0; i < 3; i++ ){
+      a.c[j][i] = m[4 * j + i];
+    }
+  }
+  a.normalize = false;
+}
+
+static void normalMap( Affine3& a, const double *m ){
+  // The columns of the inverse transpose are the rows of the inverse,
+  // the cross products of the columns over the determinant.
+  const double *u = m, *v = m + 4, *w = m + 8;
+  double n[3][3] = {
+    { v[1] * w[2] - v[2] * w[1], v[2] * w[0] - v[0] * w[2], v[0] * w[1] - v[1] * w[0] },
+    { w[1] * u[2] - w[2] * u[1], w[2] * u[0] - w[0] * u[2], w[0] * u[1] - w[1] * u[0] },
+    { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] }
+  };
+  double det = u[0] * n[0][0] + u[1] * n[0][1] + u[2] * n[0][2];
+  for( int j = 0; j < 3; j++ ){
+    for( int i = 0; i < 3; i++ ){
+      a.c[j][i] = n[j][i] / det;
+    }
+    a.c[3][j] = 0.0;
+  }
+  a.normalize = true;
+}
+
+static inline void apply( const Affine3& a, const double *v, double *r ){
+  double x = v[0], y = v[1], z = v[2];
+  double rx = a.c[0][0] * x + a.c[1][0] * y + a.c[2][0] * z + a.c[3][0];
+  double ry = a.c[0][1] * x + a.c[1][1] * y + a.c[2][1] * z + a.c[3][1];
+  double rz = a.c[0][2] * x + a.c[1][2] * y + a.c[2][2] * z + a.c[3][2];
+  if( a.normalize ){
+    double length = rx * rx + ry * ry + rz * rz;
+    length = length > 0.0 ? 1.0 / sqrt(length) : 0.0;
+    rx *= length;
+    ry *= length;
+    rz *= length;
+  }
+  r[0] = rx;
+  r[1] = ry;
+  r[2] = rz;
+}
+
+/*
+ * One batch of 3-vectors: either a packed stream, x y z per vector, in
+ * which vector k uses map[k & 1], or three arrays of coordinates that
+ * all use map[0].
+ */
+typedef struct Job{
+  bool soa;
+  bool stream;
+  const Affine3 *map[2];
+  const double *in;
+  double *out;
+  const double *x, *y, *z;
+  double *ox, *oy, *oz;
+}Job;
+
+static void scalarRange( const Job& job, size_t begin, size_t end ){
+  for( size_t k = begin; k < end; k++ ){
+    if( job.soa ){
+      double v[3] = { job.x[k], job.y[k], job.z[k] };
+      double r[3];
+      apply( *job.map[0], v, r );
+      job.ox[k] = r[0];
+      job.oy[k] = r[1];
+      job.oz[k] = r[2];
+    }else{
+      apply( *job.map[k & 1], job.in + 3 * k, job.out + 3 * k );
+    }
+  }
+}
+
+#ifdef VT_X86
+
+static inline bool aligned16( const double *p ){
+  return( (reinterpret_cast<uintptr_t>( p ) & 15) == 0 );
+}
+
+/*
+ * Coefficients for two lanes, lane 0 using map a and lane 1 map b.
+ */
+typedef struct Lanes{
+  __m128d c[4][3];
+  __m128d normalize;
+  bool anyNormalize;
+}Lanes;
+
+SSE2_TARGET
+static void setLanes( Lanes& l, const Affine3& a, const Affine3& b ){
+  for( int j = 0; j < 4; j++ ){
+    for( int i = 0; i < 3; i++ ){
+      l.c[j][i] = _mm_set_pd( b.c[j][i], a.c[j][i] );
+    }
+  }
+  l.normalize = _mm_castsi128_pd( _mm_set_epi32( -int(b.normalize), -int(b.normalize),
+                                                 -int(a.normalize), -int(a.normalize) ) );
+  l.anyNormalize = a.normalize || b.normalize;
+}
+
+SSE2_TARGET
+static inline void sseApply( const Lanes& l, __m128d x, __m128d y, __m128d z,
+                             __m128d& rx, __m128d& ry, __m128d& rz ){
+  rx = _mm_add_pd( _mm_add_pd( _mm_mul_pd( l.c[0][0], x ), _mm_mul_pd( l.c[1][0], y ) ),
+                   _mm_add_pd( _mm_mul_pd( l.c[2][0], z ), l.c[3][0] ) );
+  ry = _mm_add_pd( _mm_add_pd( _mm_mul_pd( l.c[0][1], x ), _mm_mul_pd( l.c[1][1], y ) ),
+                   _mm_add_pd( _mm_mul_pd( l.c[2][1], z ), l.c[3][1] ) );
+  rz = _mm_add_pd( _mm_add_pd( _mm_mul_pd( l.c[0][2], x ), _mm_mul_pd( l.c[1][2], y ) ),
+                   _mm_add_pd( _mm_mul_pd( l.c[2][2], z ), l.c[3][2] ) );
+  if( l.anyNormalize ){
+    const __m128d one = _mm_set1_pd( 1.0 );
+    __m128d length = _mm_add_pd( _mm_add_pd( _mm_mul_pd( rx, rx ), _mm_mul_pd( ry, ry ) ),
+                                 _mm_mul_pd( rz, rz ) );
+    // 0 for a zero vector, which would otherwise come out as NaN.
+    __m128d s = _mm_and_pd( _mm_div_pd( one, _mm_sqrt_pd( length ) ),
+                            _mm_cmpgt_pd( length, _mm_setzero_pd( ) ) );
+    // 1 in the lanes that are not normalized.
+    s = _mm_or_pd( _mm_and_pd( l.normalize, s ), _mm_andnot_pd( l.normalize, one ) );
+    rx = _mm_mul_pd( rx, s );
+    ry = _mm_mul_pd( ry, s );
+    rz = _mm_mul_pd( rz, s );
+  }
+}
+
+SSE2_TARGET
+static void sseRange( const Job& job, size_t begin, size_t end ){
+  size_t k = begin;
+  bool stream = job.stream;
+  if( job.soa ){
+    if( stream && k < end && ! aligned16( job.ox + k ) ){
+      scalarRange( job, k, k + 1 );
+      k++;
+    }
+    // Non-temporal stores need all three arrays aligned alike.
+    stream = stream && aligned16( job.ox + k ) && aligned16( job.oy + k ) &&
+             aligned16( job.oz + k );
+    Lanes l;
+    setLanes( l, *job.map[0], *job.map[0] );
+    for( ; k + 2 <= end; k += 2 ){
+      __m128d rx, ry, rz;
+      sseApply( l, _mm_loadu_pd( job.x + k ), _mm_loadu_pd( job.y + k ),
+                _mm_loadu_pd( job.z + k ), rx, ry, rz );
+      if( stream ){
+        _mm_stream_pd( job.ox + k, rx );
+        _mm_stream_pd( job.oy + k, ry );
+        _mm_stream_pd( job.oz + k, rz );
+      }else{
+        _mm_storeu_pd( job.ox + k, rx );
+        _mm_storeu_pd( job.oy + k, ry );
+        _mm_storeu_pd( job.oz + k, rz );
+      }
+    }
+  }else{
+    if( stream && k < end && ! aligned16( job.out + 3 * k ) ){
+      scalarRange( job, k, k + 1 );
+      k++;
+    }
+    stream = stream && aligned16( job.out + 3 * k );
+    Lanes l;
+    setLanes( l, *job.map[k & 1], *job.map[(k + 1) & 1] );
+    for( ; k + 2 <= end; k += 2 ){
+      const double *p = job.in + 3 * k;
+      double *q = job.out + 3 * k;
+      // x0 y0 | z0 x1 | y1 z1
+      __m128d v0 = _mm_loadu_pd( p );
+      __m128d v1 = _mm_loadu_pd( p + 2 );
+      __m128d v2 = _mm_loadu_pd( p + 4 );
+      __m128d rx, ry, rz;
+      sseApply( l, _mm_shuffle_pd( v0, v1, 2 ), _mm_shuffle_pd( v0, v2, 1 ),
+                _mm_shuffle_pd( v1, v2, 2 ), rx, ry, rz );
+      v0 = _mm_unpacklo_pd( rx, ry );
+      v1 = _mm_shuffle_pd( rz, rx, 2 );
+      v2 = _mm_unpackhi_pd( ry, rz );
+      if( stream ){
+        _mm_stream_pd( q, v0 );
+        _mm_stream_pd( q + 2, v1 );
+        _mm_stream_pd( q + 4, v2 );
+      }else{
+        _mm_storeu_pd( q, v0 );
+        _mm_storeu_pd( q + 2, v1 );
+        _mm_storeu_pd( q + 4, v2 );
+      }
+    }
+  }
+  if( k < end ){
+    scalarRange( job, k, end );
+  }
+  if( stream ){
+    // Make the non-temporal stores visible before the thread finishes.
+    _mm_sfence( );
+  }
+}
+
+static bool chooseSSE2( ){
+  const char *cap = getenv( "VERTEX_SIMD" );
+  if( cap != NULL && strcmp( cap, "scalar" ) == 0 ){
+    return( false );
+  }
+  __builtin_cpu_init( );
+  return( __builtin_cpu_supports( "sse2" ) );
+}
+
+static bool haveSSE2( ){
+  static const bool have = chooseSSE2( );
+  return( have );
+}
+
+#endif
+
+static void runRange( const Job& job, size_t begin, size_t end ){
+#ifdef VT_X86
+  if( haveSSE2( ) ){
+    sseRange( job, begin, end );
+    return;
+  }
+#endif
+  scalarRange( job, begin, end );
+}
+
+const char* vertexTransformName( ){
+#ifdef VT_X86
+  if( haveSSE2( ) ){
+    return( "sse2" );
+  }
+#endif
+  return( "scalar" );
+}
+
+//
+// Threads
+//
+
+// Below this many vectors per thread, starting a thread costs more
+// than it saves.
+static const size_t kMinPerThread = 1 << 16;
+
+typedef struct Task{
+  const Job *job;
+  size_t begin;
+  size_t end;
+}Task;
+
+static void* runTask( void *arg ){
+  Task *t = static_cast<Task*>( arg );
+  runRange( *t->job, t->begin, t->end );
+  return( NULL );
+}
+
+static void run( const Job& job, size_t count, unsigned threads ){
+#ifndef _WIN32
+  if( threads == 0 ){
+    long n = sysconf( _SC_NPROCESSORS_ONLN );
+    threads = n > 0 ? unsigned(n) : 1;
+  }
+  if( threads > count / kMinPerThread ){
+    threads = unsigned(count / kMinPerThread);
+  }
+  if( threads > 1 ){
+    // Chunks of 8 vectors are whole cache lines, so no two threads
+    // write to the same line.
+    size_t chunk = (count / threads + 7) & ~size_t(7);
+    std::vector<Task> tasks( threads );
+    std::vector<pthread_t> ids( threads );
+    std::vector<bool> started( threads, false );
+    for( unsigned i = 0; i < threads; i++ ){
+      tasks[i].job = &job;
+      tasks[i].begin = i * chunk < count ? i * chunk : count;
+      tasks[i].end = i + 1 == threads || (i + 1) * chunk > count ? count : (i + 1) * chunk;
+    }
+    for( unsigned i = 1; i < threads; i++ ){
+      started[i] = pthread_create( &ids[i], NULL, runTask, &tasks[i] ) == 0;
+      if( ! started[i] ){
+        runTask( &tasks[i] );
+      }
+    }
+    runTask( &tasks[0] );
+    for( unsigned i = 1; i < threads; i++ ){
+      if( started[i] ){
+        pthread_join( ids[i], NULL );
+      }
+    }
+    return;
+  }
+#endif
+  runRange( job, 0, count );
+}
+
+//
+// The interface
+//
+
+static Job packedJob( const Affine3 *a, const Affine3 *b, const double *in,
+                      double *out, unsigned flags ){
+  Job job = Job( );
+  job.soa = false;
+  job.stream = (flags & VT_STREAM) != 0;
+  job.map[0] = a;
+  job.map[1] = b;
+  job.in = in;
+  job.out = out;
+  return( job );
+}
+
+void transformVerticesSoA( const double *m, const VertexArrays& in,
+                           const VertexArrays& out, size_t n,
+                           unsigned flags, unsigned threads ){
+  Affine3 position, normal;
+  positionMap( position, m );
+  normalMap( normal, m );
+  Job job = Job( );
+  job.soa = true;
+  job.stream = (flags & VT_STREAM) != 0;
+  job.map[0] = job.map[1] = &position;
+  job.x = in.x;
+  job.y = in.y;
+  job.z = in.z;
+  job.ox = out.x;
+  job.oy = out.y;
+  job.oz = out.z;
+  run( job, n, threads );
+  if( in.nx != NULL ){
+    job.map[0] = job.map[1] = &normal;
+    job.x = in.nx;
+    job.y = in.ny;
+    job.z = in.nz;
+    job.ox = out.nx;
+    job.oy = out.ny;
+    job.oz = out.nz;
+    run( job, n, threads );
+  }
+}
+
+void transformVerticesInterleaved( const double *m, const double *in,
+                                   double *out, size_t n, bool normals,
+                                   unsigned flags, unsigned threads ){
+  Affine3 position, normal;
+  positionMap( position, m );
+  normalMap( normal, m );
+  if( normals ){
+    // Even vectors are positions, odd ones normals.
+    run( packedJob( &position, &normal, in, out, flags ), 2 * n, threads );
+  }else{
+    run( packedJob( &position, &position, in, out, flags ), n, threads );
+  }
+}
+
+void transformNormals( const double *m, const double *in, double *out,
+                       size_t n, unsigned flags, unsigned threads ){
+  Affine3 normal;
+  normalMap( normal, m );
+  run( packedJob( &normal, &normal, in, out, flags ), n, threads );
+}
+
+void transformFaceList( FaceList *fl, const double *m, unsigned threads ){
+  // msAlloc2D keeps each array's rows contiguous.
+  if( fl->vc > 0 ){
+    transformVerticesInterleaved( m, fl->vertices[0], fl->vertices[0],
+                                  fl->vc, false, 0, threads );
+    transformNormals( m, fl->v_normals[0], fl->v_normals[0], fl->vc, 0, threads );
+  }
+  if( fl->fc > 0 ){
+    transformNormals( m, fl->f_normals[0], fl->f_normals[0], fl->fc, 0, threads );
+  }
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2013 Michael Shafae
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * $Id$
+ *
+ */
+
+/*
+ * Transform whole vertex arrays by a 4x4 matrix at once.
+ *
+ * The matrix is 16 doubles in column major order, as OpenGL stores it,
+ * and must be affine: its last row is 0 0 0 1. Positions are
+ * transformed by the matrix. Normals are transformed by the inverse
+ * transpose of its upper left 3x3 and then normalized, so they stay
+ * perpendicular to the surface under non-uniform scales.
+ *
+ * The work is done with SSE2 where the CPU has it and split across
+ * threads when there is enough of it. Setting the environment variable
+ * VERTEX_SIMD to "scalar" turns SSE2 off, for comparison. The output
+ * may be the same array as the input, which transforms the vertices in
+ * place, but must not overlap it otherwise.
+ */
+
+#ifndef _VERTEXTRANSFORM_H_
+#define _VERTEXTRANSFORM_H_
+
+#include <cstddef>
+#include "FaceList.h"
+
+/*
+ * Flags for the transform functions.
+ * VT_STREAM writes the results with non-temporal stores, which go
+ * around the caches. Use it when the output is not going to be read
+ * again soon, as when exporting, so that it does not push everything
+ * else out of the caches.
+ */
+#define VT_STREAM 1
+
+/*
+ * Vertices stored as a structure of arrays, one array per coordinate.
+ * The normals are optional; set nx, ny and nz to NULL if there are none.
+ */
+typedef struct VertexArrays{
+  double *x;
+  double *y;
+  double *z;
+  double *nx;
+  double *ny;
+  double *nz;
+}VertexArrays;
+
+/*
+ * Transform n vertices held as arrays of coordinates.
+ * m: the affine matrix
+ * in, out: the arrays to read and write; out may be the same as in.
+ * flags: 0 or VT_STREAM
+ * threads: the most threads to use; 0 uses one per processor.
+ */
+void transformVerticesSoA( const double *m, const VertexArrays& in,
+                           const VertexArrays& out, size_t n,
+                           unsigned flags, unsigned threads );
+
+/*
+ * Transform n vertices held interleaved, as x y z per vertex or, if
+ * normals is true, as x y z nx ny nz per vertex.
+ * m: the affine matrix
+ * in, out: the arrays to read and write; out may be the same as in.
+ * flags: 0 or VT_STREAM
+ * threads: the most threads to use; 0 uses one per processor.
+ */
+void transformVerticesInterleaved( const double *m, const double *in,
+                                   double *out, size_t n, bool normals,
+                                   unsigned flags, unsigned threads );
+
+/*
+ * Transform n normals held as x y z per normal.
+ */
+void transformNormals( const double *m, const double *in, double *out,
+                       size_t n, unsigned flags, unsigned threads );
+
+/*
+ * Transform a model's vertices, vertex normals and face normals in
+ * place. The bounding sphere is left as it was.
+ */
+void transformFaceList( FaceList *fl, const double *m, unsigned threads );
+
+/*
+ * Names the code in use: "sse2" or "scalar".
+ */
+const char* vertexTransformName( );
+
+#endif
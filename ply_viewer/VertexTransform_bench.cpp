@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2013 Michael Shafae
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * $Id$
+ *
+ */
+
+
+/*
+ * Checks the batched transforms in VertexTransform.cpp against a
+ * vertex at a time loop, then measures their throughput. Build it with
+ *
+ *   c++ -O2 -I../shared -o VertexTransform_bench VertexTransform_bench.cpp \
+ *       VertexTransform.cpp -lpthread
+ *
+ * and run it as
+ *
+ *   ./VertexTransform_bench [vertices [threads]]
+ *
+ * The default is 100 million vertices on every processor. Each layout
+ * is timed on its own, the ones written to new arrays needing 48 bytes
+ * a vertex, as does the interleaved positions and normals; 100 million
+ * vertices take 4.8 GB. The rate counts the bytes read plus the bytes
+ * written.
+ */
+
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <sys/time.h>
+#include <vector>
+
+#include "VertexTransform.h"
+
+// Both sides are computed in double precision.
+#define CHECK_TOLERANCE 1.0e-12
+#include "bench_check.h"
+
+double now( ){
+  struct timeval t;
+  gettimeofday( &t, NULL );
+  return( t.tv_sec + t.tv_usec * 1.0e-6 );
+}
+
+double randomUnit( ){
+  return( rand( ) / double(RAND_MAX) * 2.0 - 1.0 );
+}
+
+/*
+ * A rotation about (1, 2, 3), a non-uniform scale and a translation.
+ */
+void testMatrix( double *m ){
+  double x = 1.0 / sqrt(14.0), y = 2.0 / sqrt(14.0), z = 3.0 / sqrt(14.0);
+  double c = cos(0.7), s = sin(0.7), t = 1.0 - c;
+  double r[9] = { x * x * t + c, y * x * t + z * s, x * z * t - y * s,
+                  x * y * t - z * s, y * y * t + c, y * z * t + x * s,
+                  x * z * t + y * s, y * z * t - x * s, z * z * t + c };
+  double scale[3] = { 2.0, 0.5, 1.25 };
+  for( int j = 0; j < 3; j++ ){
+    for( int i = 0; i < 3; i++ ){
+      m[4 * j + i] = r[3 * j + i] * scale[j];
+    }
+    m[4 * j + 3] = 0.0;
+  }
+  m[12] = 1.0;
+  m[13] = -2.0;
+  m[14] = 0.5;
+  m[15] = 1.0;
+}
+
+/*
+ * The vertex at a time version, as PlyModel.cpp would write it.
+ */
+void transformPoint3d( double *out, const double *m, const double *p ){
+  double r[3];
+  for( int i = 0; i < 3; i++ ){
+    r[i] = m[i] * p[0] + m[4 + i] * p[1] + m[8 + i] * p[2] + m[12 + i];
+  }
+  memcpy( out, r, sizeof(r) );
+}
+
+void transformNormal3d( double *out, const double *m, const double *n ){
+  // The inverse transpose, by Gauss-Jordan elimination.
+  double a[3][6];
+  for( int r = 0; r < 3; r++ ){
+    for( int c = 0; c < 3; c++ ){
+      a[r][c] = m[4 * c + r];
+      a[r][3 + c] = r == c ? 1.0 : 0.0;
+    }
+  }
+  for( int c = 0; c < 3; c++ ){
+    int p = c;
+    for( int r = c + 1; r < 3; r++ ){
+      if( fabs(a[r][c]) > fabs(a[p][c]) ){
+        p = r;
+      }
+    }
+    for( int k = 0; k < 6; k++ ){
+      double swap = a[c][k];
+      a[c][k] = a[p][k];
+      a[p][k] = swap;
+    }
+    double d = a[c][c];
+    for( int k = 0; k < 6; k++ ){
+      a[c][k] /= d;
+    }
+    for( int r = 0; r < 3; r++ ){
+      if( r != c ){
+        double f = a[r][c];
+        for( int k = 0; k < 6; k++ ){
+          a[r][k] -= f * a[c][k];
+        }
+      }
+    }
+  }
+  double r[3];
+  for( int i = 0; i < 3; i++ ){
+    // Row i of the inverse is column i of its transpose.
+    r[i] = a[0][3 + i] * n[0] + a[1][3 + i] * n[1] + a[2][3 + i] * n[2];
+  }
+  double length = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+  for( int i = 0; i < 3; i++ ){
+    out[i] = length > 0.0 ? r[i] / length : 0.0;
+  }
+}
+
+/*
+ * Every layout and mode, with odd counts and arrays that start off a
+ * 16 byte boundary, on 1 and 3 threads.
+ */
+void checkAll( ){
+  double m[16];
+  testMatrix( m );
+  const size_t sizes[] = { 0, 1, 2, 7, 200001 };
+  for( unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++ ){
+    size_t n = sizes[s];
+    // One spare double in front, so offset 1 is misaligned.
+    std::vector<double> data( 6 * n + 1 ), expected( 6 * n );
+    for( size_t i = 0; i < data.size( ); i++ ){
+      data[i] = 10.0 * randomUnit( );
+    }
+    for( int offset = 0; offset < 2; offset++ ){
+      for( unsigned flags = 0; flags <= VT_STREAM; flags++ ){
+        for( unsigned threads = 1; threads <= 3; threads += 2 ){
+          double *p = &data[0] + offset;
+          std::vector<double> v( p, p + 6 * n ), out( 6 * n );
+          double *in = v.empty( ) ? NULL : &v[0];
+
+          for( size_t i = 0; i < n; i++ ){
+            transformPoint3d( &expected[6 * i], m, in + 6 * i );
+            transformNormal3d( &expected[6 * i + 3], m, in + 6 * i + 3 );
+          }
+          if( n > 0 ){
+            transformVerticesInterleaved( m, in, &out[0], n, true, flags, threads );
+            checkElements( "interleaved", &out[0], &expected[0], 6 * n );
+            transformVerticesInterleaved( m, in, in, n, true, flags, threads );
+            checkElements( "interleaved in place", in, &expected[0], 6 * n );
+          }
+
+          std::vector<double> w( p, p + 6 * n );
+          in = w.empty( ) ? NULL : &w[0];
+          for( size_t i = 0; i < 2 * n; i++ ){
+            transformPoint3d( &expected[3 * i], m, in + 3 * i );
+          }
+          if( n > 0 ){
+            transformVerticesInterleaved( m, in, in, 2 * n, false, flags, threads );
+            checkElements( "positions in place", in, &expected[0], 6 * n );
+          }
+
+          std::vector<double> soa( p, p + 6 * n ), soaOut( 6 * n + 1 );
+          if( n > 0 ){
+            VertexArrays a, b;
+            double *q = &soa[0];
+            a.x = q; a.y = q + n; a.z = q + 2 * n;
+            a.nx = q + 3 * n; a.ny = q + 4 * n; a.nz = q + 5 * n;
+            // Output arrays aligned differently from each other.
+            double *r = &soaOut[0] + 1;
+            b.x = r; b.y = r + n; b.z = r + 2 * n;
+            b.nx = r + 3 * n; b.ny = r + 4 * n; b.nz = r + 5 * n;
+            for( size_t i = 0; i < n; i++ ){
+              double v3[3] = { a.x[i], a.y[i], a.z[i] };
+              double n3[3] = { a.nx[i], a.ny[i], a.nz[i] };
+              transformPoint3d( &expected[6 * i], m, v3 );
+              transformNormal3d( &expected[6 * i + 3], m, n3 );
+            }
+            transformVerticesSoA( m, a, b, n, flags, threads );
+            std::vector<double> got( 6 * n );
+            for( size_t i = 0; i < n; i++ ){
+              double g[6] = { b.x[i], b.y[i], b.z[i], b.nx[i], b.ny[i], b.nz[i] };
+              memcpy( &got[6 * i], g, sizeof(g) );
+            }
+            checkElements( "SoA", &got[0], &expected[0], 6 * n );
+            transformVerticesSoA( m, a, a, n, flags, threads );
+            for( size_t i = 0; i < n; i++ ){
+              double g[6] = { a.x[i], a.y[i], a.z[i], a.nx[i], a.ny[i], a.nz[i] };
+              memcpy( &got[6 * i], g, sizeof(g) );
+            }
+            checkElements( "SoA in place", &got[0], &expected[0], 6 * n );
+          }
+        }
+      }
+    }
+  }
+
+  // A FaceList, whose arrays the transform reaches through vertices[0].
+  FaceList fl( 1001, 500 );
+  std::vector<double> before( 3 * 1001 );
+  for( int i = 0; i < fl.vc; i++ ){
+    for( int j = 0; j < 3; j++ ){
+      fl.vertices[i][j] = before[3 * i + j] = randomUnit( );
+      fl.v_normals[i][j] = randomUnit( );
+    }
+  }
+  std::vector<double> expected( 3 * 1001 );
+  for( int i = 0; i < fl.vc; i++ ){
+    transformPoint3d( &expected[3 * i], m, &before[3 * i] );
+  }
+  transformFaceList( &fl, m, 2 );
+  checkElements( "FaceList", fl.vertices[0], &expected[0], 3 * 1001 );
+}
+
+void report( const char *name, double seconds, size_t bytes ){
+  printf( "%-40s %7.3f s %7.2f GB/s\n", name, seconds, bytes / seconds * 1.0e-9 );
+}
+
+int main( int argc, char* argv[] ){
+  size_t n = argc > 1 ? strtoul( argv[1], NULL, 10 ) : 100000000;
+  unsigned threads = argc > 2 ? atoi( argv[2] ) : 0;
+  double m[16];
+  testMatrix( m );
+
+  printf( "Using the %s code.\n", vertexTransformName( ) );
+  checkAll( );
+  if( failures > 0 ){
+    fprintf( stderr, "%d results differ from the reference\n", failures );
+    return( 1 );
+  }
+  printf( "%lu vertices, %u threads (0 is one per processor)\n",
+          (unsigned long)n, threads );
+
+  double t;
+  {
+    // Positions, x y z per vertex: 24 bytes read and 24 written each.
+    std::vector<double> v( 3 * n ), out( 3 * n );
+    for( size_t i = 0; i < v.size( ); i++ ){
+      v[i] = double(i % 1000);
+    }
+    size_t bytes = 2 * v.size( ) * sizeof(double);
+    t = now( );
+    for( size_t i = 0; i < n; i++ ){
+      transformPoint3d( &v[3 * i], m, &v[3 * i] );
+    }
+    report( "positions, a vertex at a time", now( ) - t, bytes );
+    t = now( );
+    transformVerticesInterleaved( m, &v[0], &v[0], n, false, 0, threads );
+    report( "positions, in place", now( ) - t, bytes );
+    t = now( );
+    transformVerticesInterleaved( m, &v[0], &out[0], n, false, 0, threads );
+    report( "positions, to a new array", now( ) - t, bytes );
+    t = now( );
+    transformVerticesInterleaved( m, &v[0], &out[0], n, false, VT_STREAM, threads );
+    report( "positions, to a new array, streaming", now( ) - t, bytes );
+  }
+  {
+    std::vector<double> x( n, 1.0 ), y( n, 2.0 ), z( n, 3.0 );
+    std::vector<double> ox( n ), oy( n ), oz( n );
+    VertexArrays a, b;
+    a.x = &x[0];
+    a.y = &y[0];
+    a.z = &z[0];
+    b.x = &ox[0];
+    b.y = &oy[0];
+    b.z = &oz[0];
+    a.nx = a.ny = a.nz = b.nx = b.ny = b.nz = NULL;
+    size_t bytes = 6 * n * sizeof(double);
+    t = now( );
+    transformVerticesSoA( m, a, a, n, 0, threads );
+    report( "positions SoA, in place", now( ) - t, bytes );
+    t = now( );
+    transformVerticesSoA( m, a, b, n, 0, threads );
+    report( "positions SoA, to new arrays", now( ) - t, bytes );
+    t = now( );
+    transformVerticesSoA( m, a, b, n, VT_STREAM, threads );
+    report( "positions SoA, to new arrays, streaming", now( ) - t, bytes );
+  }
+  {
+    // Positions and normals interleaved: 48 bytes each way.
+    std::vector<double> v( 6 * n, 1.0 );
+    size_t bytes = 2 * v.size( ) * sizeof(double);
+    t = now( );
+    transformVerticesInterleaved( m, &v[0], &v[0], n, true, 0, threads );
+    report( "positions and normals, in place", now( ) - t, bytes );
+  }
+  return( 0 );
+}
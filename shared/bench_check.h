@@ -0,0 +1,92 @@
+//
+// Michael Shafae
+// mshafae at fullerton.edu
+//
+// The checks the *_bench programs run before they time anything. Each
+// result is compared element by element with a reference, relative to
+// the reference's magnitude once it exceeds 1; the first element off by
+// more than the tolerance is reported and counted in failures. Only the
+// first ten failures are printed so a broken kernel checked in a loop
+// does not flood the terminal.
+//
+// A bench that needs a tolerance other than the default defines
+// CHECK_TOLERANCE before including this file. It is meant to be
+// included by one source file per program.
+//
+// $Id$
+//
+// STUDENTS DO NOT NEED TO MAKE ANY CHANGES TO THIS FILE.
+//
+
+#ifndef _BENCH_CHECK_H_
+#define _BENCH_CHECK_H_
+
+#include <cstdio>
+#include <cmath>
+#include <cstddef>
+
+#ifndef CHECK_TOLERANCE
+// Single precision, as computed by OpenGL, with room for its rounding.
+#define CHECK_TOLERANCE 1.0e-5
+#endif
+
+#define CHECK_REPORTED_FAILURES 10
+
+static int failures = 0;
+
+/*
+ * checkFailed( ) counts a failed check, and says whether it should
+ * still be printed.
+ */
+static inline bool checkFailed( ){
+  return( failures++ < CHECK_REPORTED_FAILURES );
+}
+
+/*
+ * checkElements( ) compares the n elements of v with expected and
+ * returns whether they all match.
+ * name: Names the check in the message printed on failure.
+ */
+template <class T, class U>
+static inline bool checkElements( const char *name, const T *v,
+                                  const U *expected, size_t n ){
+  for( size_t i = 0; i < n; i++ ){
+    double e = expected[i];
+    double scale = fabs(e) > 1.0 ? fabs(e) : 1.0;
+    // Written so that a NaN fails.
+    if( !(fabs(v[i] - e) <= CHECK_TOLERANCE * scale) ){
+      if( checkFailed( ) ){
+        fprintf( stderr, "%s: element %lu is %.*g, expected %.*g\n",
+                 name, (unsigned long)i, sizeof(T) > sizeof(float) ? 17 : 9,
+                 double(v[i]), sizeof(U) > sizeof(float) ? 17 : 9, e );
+      }
+      return( false );
+    }
+  }
+  return( true );
+}
+
+/*
+ * checkMatrix( ) compares two 4x4 matrices and prints the name of the
+ * check if they match.
+ */
+template <class T, class U>
+static inline void checkMatrix( const char *name, const T *m,
+                                const U *expected ){
+  if( checkElements( name, m, expected, 16 ) ){
+    printf( "%-22s ok\n", name );
+  }
+}
+
+/*
+ * checkTrue( ) counts a failure, printing message, unless ok holds,
+ * and returns ok.
+ */
+static inline bool checkTrue( bool ok, const char *message ){
+  if( !ok && checkFailed( ) ){
+    fprintf( stderr, "%s\n", message );
+  }
+  return( ok );
+}
+
+#endif
@@ -0,0 +1,457 @@
+//
+// Michael Shafae
+// mshafae at fullerton.edu
+//
+// Scalar, SSE and AVX versions of the 4x4 matrix kernels declared in
+// matrix_simd.h, and the code that picks among them at run time.
+//
+// The general inverse follows "Fast 4x4 Matrix Inverse with SSE SIMD,
+// Explained" by Eric Zhang, which inverts the matrix by 2x2 blocks.
+// Every kernel works on columns, so the SSE versions need no transposes.
+//
+// $Id$
+//
+// STUDENTS DO NOT NEED TO MAKE ANY CHANGES TO THIS FILE.
+//
+
+#include <cstdlib>
+#include <cstring>
+#include "matrix_simd.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define MATRIX_SIMD_X86
+#include <immintrin.h>
+#define SSE_TARGET __attribute__((target("sse2")))
+#define AVX_TARGET __attribute__((target("avx")))
+#endif
+
+//
+// Scalar kernels
+//
+
+static void scalarMultiply( float *out, const float *a, const float *b ){
+  float r[16];
+  for( int j = 0; j < 4; j++ ){
+    for( int i = 0; i < 4; i++ ){
+      r[4 * j + i] = a[i] * b[4 * j] + a[4 + i] * b[4 * j + 1] +
+                     a[8 + i] * b[4 * j + 2] + a[12 + i] * b[4 * j + 3];
+    }
+  }
+  memcpy( out, r, sizeof(r) );
+}
+
+static void scalarTransformVec4( float *out, const float *m, const float *v ){
+  float c[4] = { v[0], v[1], v[2], v[3] };
+  out[0] = m[0] * c[0] + m[4] * c[1] + m[8]  * c[2] + m[12] * c[3];
+  out[1] = m[1] * c[0] + m[5] * c[1] + m[9]  * c[2] + m[13] * c[3];
+  out[2] = m[2] * c[0] + m[6] * c[1] + m[10] * c[2] + m[14] * c[3];
+  out[3] = m[3] * c[0] + m[7] * c[1] + m[11] * c[2] + m[15] * c[3];
+}
+
+static bool scalarInverse( float *out, const float *m ){
+  // The 2x2 determinants of the first two and the last two columns.
+  float s0 = m[0] * m[5] - m[4] * m[1];
+  float s1 = m[0] * m[6] - m[4] * m[2];
+  float s2 = m[0] * m[7] - m[4] * m[3];
+  float s3 = m[1] * m[6] - m[5] * m[2];
+  float s4 = m[1] * m[7] - m[5] * m[3];
+  float s5 = m[2] * m[7] - m[6] * m[3];
+  float c5 = m[10] * m[15] - m[14] * m[11];
+  float c4 = m[9] * m[15] - m[13] * m[11];
+  float c3 = m[9] * m[14] - m[13] * m[10];
+  float c2 = m[8] * m[15] - m[12] * m[11];
+  float c1 = m[8] * m[14] - m[12] * m[10];
+  float c0 = m[8] * m[13] - m[12] * m[9];
+  float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+  if( det == 0.0f ){
+    return( false );
+  }
+  float d = 1.0f / det;
+  float r[16];
+  r[0] = (m[5] * c5 - m[6] * c4 + m[7] * c3) * d;
+  r[1] = (-m[1] * c5 + m[2] * c4 - m[3] * c3) * d;
+  r[2] = (m[13] * s5 - m[14] * s4 + m[15] * s3) * d;
+  r[3] = (-m[9] * s5 + m[10] * s4 - m[11] * s3) * d;
+  r[4] = (-m[4] * c5 + m[6] * c2 - m[7] * c1) * d;
+  r[5] = (m[0] * c5 - m[2] * c2 + m[3] * c1) * d;
+  r[6] = (-m[12] * s5 + m[14] * s2 - m[15] * s1) * d;
+  r[7] = (m[8] * s5 - m[10] * s2 + m[11] * s1) * d;
+  r[8] = (m[4] * c4 - m[5] * c2 + m[7] * c0) * d;
+  r[9] = (-m[0] * c4 + m[1] * c2 - m[3] * c0) * d;
+  r[10] = (m[12] * s4 - m[13] * s2 + m[15] * s0) * d;
+  r[11] = (-m[8] * s4 + m[9] * s2 - m[11] * s0) * d;
+  r[12] = (-m[4] * c3 + m[5] * c1 - m[6] * c0) * d;
+  r[13] = (m[0] * c3 - m[1] * c1 + m[2] * c0) * d;
+  r[14] = (-m[12] * s3 + m[13] * s1 - m[14] * s0) * d;
+  r[15] = (m[8] * s3 - m[9] * s1 + m[10] * s0) * d;
+  memcpy( out, r, sizeof(r) );
+  return( true );
+}
+
+// The rows of the inverse of the upper left 3x3 of m are the cross
+// products of its columns over its determinant; n receives them as rows.
+static void scalarInverse3( float n[3][3], const float *m ){
+  const float *a = m, *b = m + 4, *c = m + 8;
+  n[0][0] = b[1] * c[2] - b[2] * c[1];
+  n[0][1] = b[2] * c[0] - b[0] * c[2];
+  n[0][2] = b[0] * c[1] - b[1] * c[0];
+  n[1][0] = c[1] * a[2] - c[2] * a[1];
+  n[1][1] = c[2] * a[0] - c[0] * a[2];
+  n[1][2] = c[0] * a[1] - c[1] * a[0];
+  n[2][0] = a[1] * b[2] - a[2] * b[1];
+  n[2][1] = a[2] * b[0] - a[0] * b[2];
+  n[2][2] = a[0] * b[1] - a[1] * b[0];
+  float d = 1.0f / (a[0] * n[0][0] + a[1] * n[0][1] + a[2] * n[0][2]);
+  for( int i = 0; i < 3; i++ ){
+    for( int j = 0; j < 3; j++ ){
+      n[i][j] *= d;
+    }
+  }
+}
+
+static void scalarAffineInverse( float *out, const float *m ){
+  float n[3][3];
+  float t[3] = { m[12], m[13], m[14] };
+  scalarInverse3( n, m );
+  for( int i = 0; i < 3; i++ ){
+    for( int j = 0; j < 3; j++ ){
+      out[4 * j + i] = n[i][j];
+    }
+    out[12 + i] = -(n[i][0] * t[0] + n[i][1] * t[1] + n[i][2] * t[2]);
+    out[4 * i + 3] = 0.0f;
+  }
+  out[15] = 1.0f;
+}
+
+static void scalarNormalMatrix3( float *out, const float *m ){
+  float n[3][3];
+  scalarInverse3( n, m );
+  memcpy( out, n, sizeof(n) );
+}
+
+static void scalarNormalMatrix4( float *out, const float *m ){
+  float n[3][3];
+  float t[3] = { m[12], m[13], m[14] };
+  scalarInverse3( n, m );
+  for( int j = 0; j < 3; j++ ){
+    out[4 * j] = n[j][0];
+    out[4 * j + 1] = n[j][1];
+    out[4 * j + 2] = n[j][2];
+    out[4 * j + 3] = -(n[j][0] * t[0] + n[j][1] * t[1] + n[j][2] * t[2]);
+  }
+  out[12] = out[13] = out[14] = 0.0f;
+  out[15] = 1.0f;
+}
+
+#ifdef MATRIX_SIMD_X86
+
+//
+// SSE kernels
+//
+
+#define SHUFFLE( a, b, x, y, z, w ) \
+  _mm_shuffle_ps( (a), (b), _MM_SHUFFLE( (w), (z), (y), (x) ) )
+#define SWIZZLE( a, x, y, z, w ) SHUFFLE( a, a, x, y, z, w )
+
+SSE_TARGET
+static inline __m128 sseColumnCombination( __m128 c0, __m128 c1, __m128 c2,
+                                           __m128 c3, __m128 v ){
+  __m128 r = _mm_mul_ps( c0, SWIZZLE( v, 0, 0, 0, 0 ) );
+  r = _mm_add_ps( r, _mm_mul_ps( c1, SWIZZLE( v, 1, 1, 1, 1 ) ) );
+  r = _mm_add_ps( r, _mm_mul_ps( c2, SWIZZLE( v, 2, 2, 2, 2 ) ) );
+  return( _mm_add_ps( r, _mm_mul_ps( c3, SWIZZLE( v, 3, 3, 3, 3 ) ) ) );
+}
+
+SSE_TARGET
+static void sseMultiply( float *out, const float *a, const float *b ){
+  __m128 a0 = _mm_loadu_ps( a );
+  __m128 a1 = _mm_loadu_ps( a + 4 );
+  __m128 a2 = _mm_loadu_ps( a + 8 );
+  __m128 a3 = _mm_loadu_ps( a + 12 );
+  __m128 b0 = _mm_loadu_ps( b );
+  __m128 b1 = _mm_loadu_ps( b + 4 );
+  __m128 b2 = _mm_loadu_ps( b + 8 );
+  __m128 b3 = _mm_loadu_ps( b + 12 );
+  _mm_storeu_ps( out, sseColumnCombination( a0, a1, a2, a3, b0 ) );
+  _mm_storeu_ps( out + 4, sseColumnCombination( a0, a1, a2, a3, b1 ) );
+  _mm_storeu_ps( out + 8, sseColumnCombination( a0, a1, a2, a3, b2 ) );
+  _mm_storeu_ps( out + 12, sseColumnCombination( a0, a1, a2, a3, b3 ) );
+}
+
+SSE_TARGET
+static void sseTransformVec4( float *out, const float *m, const float *v ){
+  __m128 r = sseColumnCombination( _mm_loadu_ps( m ), _mm_loadu_ps( m + 4 ),
+                                   _mm_loadu_ps( m + 8 ), _mm_loadu_ps( m + 12 ),
+                                   _mm_loadu_ps( v ) );
+  _mm_storeu_ps( out, r );
+}
+
+// 2x2 matrices held as (x, y, z, w) = | x y |
+//                                     | z w |
+// a * b
+SSE_TARGET
+static inline __m128 mat2Mul( __m128 a, __m128 b ){
+  return( _mm_add_ps( _mm_mul_ps( a, SWIZZLE( b, 0, 3, 0, 3 ) ),
+                      _mm_mul_ps( SWIZZLE( a, 1, 0, 3, 2 ),
+                                  SWIZZLE( b, 2, 1, 2, 1 ) ) ) );
+}
+
+// adj( a ) * b
+SSE_TARGET
+static inline __m128 mat2AdjMul( __m128 a, __m128 b ){
+  return( _mm_sub_ps( _mm_mul_ps( SWIZZLE( a, 3, 3, 0, 0 ), b ),
+                      _mm_mul_ps( SWIZZLE( a, 1, 1, 2, 2 ),
+                                  SWIZZLE( b, 2, 3, 0, 1 ) ) ) );
+}
+
+// a * adj( b )
+SSE_TARGET
+static inline __m128 mat2MulAdj( __m128 a, __m128 b ){
+  return( _mm_sub_ps( _mm_mul_ps( a, SWIZZLE( b, 3, 0, 3, 0 ) ),
+                      _mm_mul_ps( SWIZZLE( a, 1, 0, 3, 2 ),
+                                  SWIZZLE( b, 2, 1, 2, 1 ) ) ) );
+}
+
+SSE_TARGET
+static bool sseInverse( float *out, const float *m ){
+  // The inverse of the transpose is the transpose of the inverse, so
+  // treating the columns as rows gives the inverse's columns.
+  __m128 r0 = _mm_loadu_ps( m );
+  __m128 r1 = _mm_loadu_ps( m + 4 );
+  __m128 r2 = _mm_loadu_ps( m + 8 );
+  __m128 r3 = _mm_loadu_ps( m + 12 );
+  // | A B |
+  // | C D |
+  __m128 A = _mm_movelh_ps( r0, r1 );
+  __m128 B = _mm_movehl_ps( r1, r0 );
+  __m128 C = _mm_movelh_ps( r2, r3 );
+  __m128 D = _mm_movehl_ps( r3, r2 );
+  // ( |A|, |B|, |C|, |D| )
+  __m128 dets = _mm_sub_ps(
+    _mm_mul_ps( SHUFFLE( r0, r2, 0, 2, 0, 2 ), SHUFFLE( r1, r3, 1, 3, 1, 3 ) ),
+    _mm_mul_ps( SHUFFLE( r0, r2, 1, 3, 1, 3 ), SHUFFLE( r1, r3, 0, 2, 0, 2 ) ) );
+  __m128 detA = SWIZZLE( dets, 0, 0, 0, 0 );
+  __m128 detB = SWIZZLE( dets, 1, 1, 1, 1 );
+  __m128 detC = SWIZZLE( dets, 2, 2, 2, 2 );
+  __m128 detD = SWIZZLE( dets, 3, 3, 3, 3 );
+
+  __m128 DC = mat2AdjMul( D, C );
+  __m128 AB = mat2AdjMul( A, B );
+  // The adjugates of the inverse's blocks, times |M|.
+  __m128 X = _mm_sub_ps( _mm_mul_ps( detD, A ), mat2Mul( B, DC ) );
+  __m128 W = _mm_sub_ps( _mm_mul_ps( detA, D ), mat2Mul( C, AB ) );
+  __m128 Y = _mm_sub_ps( _mm_mul_ps( detB, C ), mat2MulAdj( D, AB ) );
+  __m128 Z = _mm_sub_ps( _mm_mul_ps( detC, B ), mat2MulAdj( A, DC ) );
+
+  // |M| = |A| |D| + |B| |C| - tr( adj( A ) B adj( D ) C )
+  __m128 tr = _mm_mul_ps( AB, SWIZZLE( DC, 0, 2, 1, 3 ) );
+  tr = _mm_add_ps( tr, _mm_movehl_ps( tr, tr ) );
+  tr = _mm_add_ss( tr, SWIZZLE( tr, 1, 1, 1, 1 ) );
+  __m128 det = _mm_sub_ss( _mm_add_ss( _mm_mul_ss( detA, detD ),
+                                       _mm_mul_ss( detB, detC ) ), tr );
+  if( _mm_cvtss_f32( det ) == 0.0f ){
+    return( false );
+  }
+  det = SWIZZLE( det, 0, 0, 0, 0 );
+  __m128 scale = _mm_div_ps( _mm_setr_ps( 1.0f, -1.0f, -1.0f, 1.0f ), det );
+  X = _mm_mul_ps( X, scale );
+  Y = _mm_mul_ps( Y, scale );
+  Z = _mm_mul_ps( Z, scale );
+  W = _mm_mul_ps( W, scale );
+  // Take the adjugates and put the blocks back together.
+  _mm_storeu_ps( out, SHUFFLE( X, Y, 3, 1, 3, 1 ) );
+  _mm_storeu_ps( out + 4, SHUFFLE( X, Y, 2, 0, 2, 0 ) );
+  _mm_storeu_ps( out + 8, SHUFFLE( Z, W, 3, 1, 3, 1 ) );
+  _mm_storeu_ps( out + 12, SHUFFLE( Z, W, 2, 0, 2, 0 ) );
+  return( true );
+}
+
+// The dot product of the x, y and z of a and b, in x, y and z; w is 0.
+SSE_TARGET
+static inline __m128 sseDot3( __m128 a, __m128 b ){
+  __m128 p = _mm_mul_ps( a, b );
+  return( _mm_add_ps( _mm_add_ps( p, SWIZZLE( p, 1, 2, 0, 3 ) ),
+                      SWIZZLE( p, 2, 0, 1, 3 ) ) );
+}
+
+SSE_TARGET
+static inline __m128 sseCross( __m128 a, __m128 b ){
+  // The w lane comes out as a.w b.w - a.w b.w, which is 0.
+  return( _mm_sub_ps(
+    _mm_mul_ps( SWIZZLE( a, 1, 2, 0, 3 ), SWIZZLE( b, 2, 0, 1, 3 ) ),
+    _mm_mul_ps( SWIZZLE( a, 2, 0, 1, 3 ), SWIZZLE( b, 1, 2, 0, 3 ) ) ) );
+}
+
+// Sets n0, n1, n2 to the rows of the inverse of m's upper left 3x3, with
+// 0 in w, and t to m's translation.
+SSE_TARGET
+static inline void sseInverse3( __m128& n0, __m128& n1, __m128& n2,
+                                __m128& t, const float *m ){
+  const __m128 xyz = _mm_castsi128_ps( _mm_setr_epi32( -1, -1, -1, 0 ) );
+  __m128 a = _mm_and_ps( _mm_loadu_ps( m ), xyz );
+  __m128 b = _mm_and_ps( _mm_loadu_ps( m + 4 ), xyz );
+  __m128 c = _mm_and_ps( _mm_loadu_ps( m + 8 ), xyz );
+  t = _mm_and_ps( _mm_loadu_ps( m + 12 ), xyz );
+  n0 = sseCross( b, c );
+  n1 = sseCross( c, a );
+  n2 = sseCross( a, b );
+  __m128 d = sseDot3( a, n0 );
+  d = _mm_div_ps( _mm_set1_ps( 1.0f ), SWIZZLE( d, 0, 0, 0, 0 ) );
+  n0 = _mm_mul_ps( n0, d );
+  n1 = _mm_mul_ps( n1, d );
+  n2 = _mm_mul_ps( n2, d );
+}
+
+SSE_TARGET
+static void sseAffineInverse( float *out, const float *m ){
+  __m128 n0, n1, n2, t;
+  sseInverse3( n0, n1, n2, t, m );
+  __m128 n3 = _mm_setzero_ps( );
+  _MM_TRANSPOSE4_PS( n0, n1, n2, n3 );
+  __m128 u = _mm_mul_ps( n0, SWIZZLE( t, 0, 0, 0, 0 ) );
+  u = _mm_add_ps( u, _mm_mul_ps( n1, SWIZZLE( t, 1, 1, 1, 1 ) ) );
+  u = _mm_add_ps( u, _mm_mul_ps( n2, SWIZZLE( t, 2, 2, 2, 2 ) ) );
+  u = _mm_sub_ps( _mm_setr_ps( 0.0f, 0.0f, 0.0f, 1.0f ), u );
+  _mm_storeu_ps( out, n0 );
+  _mm_storeu_ps( out + 4, n1 );
+  _mm_storeu_ps( out + 8, n2 );
+  _mm_storeu_ps( out + 12, u );
+}
+
+SSE_TARGET
+static void sseNormalMatrix3( float *out, const float *m ){
+  __m128 n0, n1, n2, t;
+  sseInverse3( n0, n1, n2, t, m );
+  // The last store would run one float past out.
+  float r[12];
+  _mm_storeu_ps( r, n0 );
+  _mm_storeu_ps( r + 4, n1 );
+  _mm_storeu_ps( r + 8, n2 );
+  memcpy( out, r, 3 * sizeof(float) );
+  memcpy( out + 3, r + 4, 3 * sizeof(float) );
+  memcpy( out + 6, r + 8, 3 * sizeof(float) );
+}
+
+SSE_TARGET
+static inline __m128 sseDot3ToW( __m128 n, __m128 t ){
+  // ( n.x, n.y, n.z, -n . t ); n's w is 0, so adding sets just w.
+  __m128 w = _mm_sub_ps( _mm_setzero_ps( ), sseDot3( n, t ) );
+  w = SWIZZLE( w, 0, 0, 0, 0 );
+  w = _mm_and_ps( w, _mm_castsi128_ps( _mm_setr_epi32( 0, 0, 0, -1 ) ) );
+  return( _mm_add_ps( n, w ) );
+}
+
+SSE_TARGET
+static void sseNormalMatrix4( float *out, const float *m ){
+  __m128 n0, n1, n2, t;
+  sseInverse3( n0, n1, n2, t, m );
+  _mm_storeu_ps( out, sseDot3ToW( n0, t ) );
+  _mm_storeu_ps( out + 4, sseDot3ToW( n1, t ) );
+  _mm_storeu_ps( out + 8, sseDot3ToW( n2, t ) );
+  _mm_storeu_ps( out + 12, _mm_setr_ps( 0.0f, 0.0f, 0.0f, 1.0f ) );
+}
+
+//
+// AVX kernels
+//
+
+AVX_TARGET
+static inline __m256 avxColumnPair( __m256 a0, __m256 a1, __m256 a2,
+                                    __m256 a3, __m256 b ){
+  // b holds two columns of the right hand matrix, one per 128 bit lane.
+  __m256 r = _mm256_mul_ps( a0, _mm256_shuffle_ps( b, b, 0x00 ) );
+  r = _mm256_add_ps( r, _mm256_mul_ps( a1, _mm256_shuffle_ps( b, b, 0x55 ) ) );
+  r = _mm256_add_ps( r, _mm256_mul_ps( a2, _mm256_shuffle_ps( b, b, 0xaa ) ) );
+  return( _mm256_add_ps( r, _mm256_mul_ps( a3, _mm256_shuffle_ps( b, b, 0xff ) ) ) );
+}
+
+AVX_TARGET
+static void avxMultiply( float *out, const float *a, const float *b ){
+  __m256 a0 = _mm256_broadcast_ps( reinterpret_cast<const __m128*>( a ) );
+  __m256 a1 = _mm256_broadcast_ps( reinterpret_cast<const __m128*>( a + 4 ) );
+  __m256 a2 = _mm256_broadcast_ps( reinterpret_cast<const __m128*>( a + 8 ) );
+  __m256 a3 = _mm256_broadcast_ps( reinterpret_cast<const __m128*>( a + 12 ) );
+  __m256 b01 = _mm256_loadu_ps( b );
+  __m256 b23 = _mm256_loadu_ps( b + 8 );
+  _mm256_storeu_ps( out, avxColumnPair( a0, a1, a2, a3, b01 ) );
+  _mm256_storeu_ps( out + 8, avxColumnPair( a0, a1, a2, a3, b23 ) );
+}
+
+#endif
+
+//
+// Dispatch
+//
+
+struct MatrixKernels{
+  const char *name;
+  void (*multiply)( float*, const float*, const float* );
+  void (*transformVec4)( float*, const float*, const float* );
+  bool (*inverse)( float*, const float* );
+  void (*affineInverse)( float*, const float* );
+  void (*normalMatrix3)( float*, const float* );
+  void (*normalMatrix4)( float*, const float* );
+};
+
+static MatrixKernels chooseKernels( ){
+  MatrixKernels k = { "scalar", scalarMultiply, scalarTransformVec4,
+                      scalarInverse, scalarAffineInverse,
+                      scalarNormalMatrix3, scalarNormalMatrix4 };
+#ifdef MATRIX_SIMD_X86
+  const char *cap = getenv( "MATRIX_SIMD" );
+  if( cap != NULL && strcmp( cap, "scalar" ) == 0 ){
+    return( k );
+  }
+  __builtin_cpu_init( );
+  if( __builtin_cpu_supports( "sse2" ) ){
+    k.name = "sse";
+    k.multiply = sseMultiply;
+    k.transformVec4 = sseTransformVec4;
+    k.inverse = sseInverse;
+    k.affineInverse = sseAffineInverse;
+    k.normalMatrix3 = sseNormalMatrix3;
+    k.normalMatrix4 = sseNormalMatrix4;
+  }
+  if( cap != NULL && strcmp( cap, "sse" ) == 0 ){
+    return( k );
+  }
+  if( __builtin_cpu_supports( "avx" ) ){
+    k.name = "avx";
+    k.multiply = avxMultiply;
+  }
+#endif
+  return( k );
+}
+
+static const MatrixKernels& kernels( ){
+  static const MatrixKernels k = chooseKernels( );
+  return( k );
+}
+
+void mat4Multiply( float *out, const float *a, const float *b ){
+  kernels( ).multiply( out, a, b );
+}
+
+void mat4TransformVec4( float *out, const float *m, const float *v ){
+  kernels( ).transformVec4( out, m, v );
+}
+
+bool mat4Inverse( float *out, const float *m ){
+  return( kernels( ).inverse( out, m ) );
+}
+
+void mat4AffineInverse( float *out, const float *m ){
+  kernels( ).affineInverse( out, m );
+}
+
+void mat3NormalMatrix( float *out, const float *m ){
+  kernels( ).normalMatrix3( out, m );
+}
+
+void mat4NormalMatrix( float *out, const float *m ){
+  kernels( ).normalMatrix4( out, m );
+}
+
+const char* matrixSimdName( ){
+  return( kernels( ).name );
+}
@@ -0,0 +1,67 @@
+//
+// Michael Shafae
+// mshafae at fullerton.edu
+//
+// 4x4 matrix kernels for the per-object math done every frame. The
+// matrices are 16 floats in column major order, the order OpenGL and
+// glUniformMatrix4fv( ) use, and the vectors are 4 floats.
+//
+// Each kernel has a scalar version and an SSE version; mat4Multiply( )
+// also has an AVX version. The fastest one the CPU supports is picked
+// the first time a kernel is called. Setting the environment variable
+// MATRIX_SIMD to "scalar" or "sse" caps the choice, which is handy for
+// comparing them. On CPUs other than x86 the scalar versions are used.
+//
+// The output may be the same array as an input in every kernel.
+//
+// $Id$
+//
+// STUDENTS DO NOT NEED TO MAKE ANY CHANGES TO THIS FILE.
+//
+
+#ifndef _MATRIX_SIMD_H_
+#define _MATRIX_SIMD_H_
+
+/*
+ * mat4Multiply( ) computes out = a * b.
+ */
+void mat4Multiply( float *out, const float *a, const float *b );
+
+/*
+ * mat4TransformVec4( ) computes out = m * v.
+ */
+void mat4TransformVec4( float *out, const float *m, const float *v );
+
+/*
+ * mat4Inverse( ) computes the inverse of any invertible m.
+ * Returns false, leaving out unchanged, if m is singular.
+ */
+bool mat4Inverse( float *out, const float *m );
+
+/*
+ * mat4AffineInverse( ) computes the inverse of an affine m, one whose
+ * last row is 0 0 0 1, such as a modelview matrix built from
+ * translations, rotations and scales. It is cheaper than mat4Inverse( ).
+ * m must be invertible.
+ */
+void mat4AffineInverse( float *out, const float *m );
+
+/*
+ * mat3NormalMatrix( ) computes the normal matrix of an affine m, the
+ * inverse transpose of its upper left 3x3, as 9 floats in column major
+ * order, the order glUniformMatrix3fv( ) uses.
+ */
+void mat3NormalMatrix( float *out, const float *m );
+
+/*
+ * mat4NormalMatrix( ) computes the inverse transpose of an affine m as
+ * a 4x4 matrix, for shaders that take the normal matrix as a mat4.
+ */
+void mat4NormalMatrix( float *out, const float *m );
+
+/*
+ * matrixSimdName( ) names the kernels in use: "avx", "sse" or "scalar".
+ */
+const char* matrixSimdName( );
+
+#endif
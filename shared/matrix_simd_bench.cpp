@@ -0,0 +1,245 @@
+//
+// Michael Shafae
+// mshafae at fullerton.edu
+//
+// Checks the kernels in matrix_simd.cpp against a double precision
+// reference, then times them on a batch of objects the way a frame
+// would: a modelview matrix, its normal matrix and a transformed light
+// per object. Build and run it with
+//
+//   c++ -O2 -o matrix_simd_bench matrix_simd_bench.cpp matrix_simd.cpp
+//   ./matrix_simd_bench
+//   MATRIX_SIMD=scalar ./matrix_simd_bench
+//
+// the second run timing the scalar versions for comparison. It exits
+// with a non-zero status if any kernel is off by more than the
+// tolerance.
+//
+// $Id$
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <vector>
+#include "matrix_simd.h"
+
+// The inverses lose a few more bits than the products.
+#define CHECK_TOLERANCE 1.0e-3
+#include "bench_check.h"
+
+double randomUnit( ){
+  return( rand( ) / double(RAND_MAX) * 2.0 - 1.0 );
+}
+
+// A random affine matrix: a rotation about a random axis, a scale and
+// a translation, so it is well conditioned.
+void randomAffine( float *m ){
+  double axis[3] = { randomUnit( ), randomUnit( ), randomUnit( ) + 2.0 };
+  double length = sqrt( axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] );
+  double x = axis[0] / length, y = axis[1] / length, z = axis[2] / length;
+  double angle = randomUnit( ) * M_PI;
+  double c = cos(angle), s = sin(angle), t = 1.0 - c;
+  double scale[3] = { 1.5 + randomUnit( ), 1.5 + randomUnit( ), 1.5 + randomUnit( ) };
+  double r[9] = { x * x * t + c, y * x * t + z * s, x * z * t - y * s,
+                  x * y * t - z * s, y * y * t + c, y * z * t + x * s,
+                  x * z * t + y * s, y * z * t - x * s, z * z * t + c };
+  for( int j = 0; j < 3; j++ ){
+    for( int i = 0; i < 3; i++ ){
+      m[4 * j + i] = r[3 * j + i] * scale[j];
+    }
+    m[4 * j + 3] = 0.0f;
+    m[12 + j] = 10.0 * randomUnit( );
+  }
+  m[15] = 1.0f;
+}
+
+void referenceMultiply( double *out, const float *a, const float *b ){
+  for( int j = 0; j < 4; j++ ){
+    for( int i = 0; i < 4; i++ ){
+      out[4 * j + i] = 0.0;
+      for( int k = 0; k < 4; k++ ){
+        out[4 * j + i] += double(a[4 * k + i]) * b[4 * j + k];
+      }
+    }
+  }
+}
+
+// Gauss-Jordan elimination with partial pivoting.
+bool referenceInverse( double *out, const float *m ){
+  double a[4][8];
+  for( int r = 0; r < 4; r++ ){
+    for( int c = 0; c < 4; c++ ){
+      a[r][c] = m[4 * c + r];
+      a[r][4 + c] = r == c ? 1.0 : 0.0;
+    }
+  }
+  for( int c = 0; c < 4; c++ ){
+    int p = c;
+    for( int r = c + 1; r < 4; r++ ){
+      if( fabs(a[r][c]) > fabs(a[p][c]) ){
+        p = r;
+      }
+    }
+    if( a[p][c] == 0.0 ){
+      return( false );
+    }
+    for( int k = 0; k < 8; k++ ){
+      double swap = a[c][k];
+      a[c][k] = a[p][k];
+      a[p][k] = swap;
+    }
+    double d = a[c][c];
+    for( int k = 0; k < 8; k++ ){
+      a[c][k] /= d;
+    }
+    for( int r = 0; r < 4; r++ ){
+      if( r != c ){
+        double f = a[r][c];
+        for( int k = 0; k < 8; k++ ){
+          a[r][k] -= f * a[c][k];
+        }
+      }
+    }
+  }
+  for( int r = 0; r < 4; r++ ){
+    for( int c = 0; c < 4; c++ ){
+      out[4 * c + r] = a[r][4 + c];
+    }
+  }
+  return( true );
+}
+
+void checkAll( int n ){
+  for( int k = 0; k < n; k++ ){
+    float a[16], b[16], out[16], out9[9];
+    double expected[16], transpose[16], expected9[9];
+    randomAffine( a );
+    randomAffine( b );
+    // Make b a general matrix.
+    b[3] = randomUnit( );
+    b[7] = randomUnit( );
+    b[11] = randomUnit( );
+
+    referenceMultiply( expected, a, b );
+    mat4Multiply( out, a, b );
+    checkElements( "mat4Multiply", out, expected, 16 );
+    mat4TransformVec4( out, a, b );
+    checkElements( "mat4TransformVec4", out, expected, 4 );
+
+    if( referenceInverse( expected, b ) ){
+      checkTrue( mat4Inverse( out, b ),
+                 "mat4Inverse: invertible matrix reported singular" );
+      checkElements( "mat4Inverse", out, expected, 16 );
+    }
+
+    referenceInverse( expected, a );
+    mat4AffineInverse( out, a );
+    checkElements( "mat4AffineInverse", out, expected, 16 );
+    for( int i = 0; i < 4; i++ ){
+      for( int j = 0; j < 4; j++ ){
+        transpose[4 * j + i] = expected[4 * i + j];
+      }
+    }
+    mat4NormalMatrix( out, a );
+    checkElements( "mat4NormalMatrix", out, transpose, 16 );
+    for( int j = 0; j < 3; j++ ){
+      for( int i = 0; i < 3; i++ ){
+        expected9[3 * j + i] = transpose[4 * j + i];
+      }
+    }
+    mat3NormalMatrix( out9, a );
+    checkElements( "mat3NormalMatrix", out9, expected9, 9 );
+  }
+  float zero[16] = { 0 };
+  float out[16];
+  checkTrue( ! mat4Inverse( out, zero ),
+             "mat4Inverse: singular matrix not reported" );
+}
+
+// Keeps the compiler from dropping the work being timed.
+volatile float sink;
+
+double elapsed( clock_t start, long calls ){
+  return( double(clock( ) - start) / CLOCKS_PER_SEC * 1.0e9 / calls );
+}
+
+void timeAll( int objects, int frames ){
+  std::vector<float> models( 16 * objects );
+  std::vector<float> modelViews( 16 * objects );
+  std::vector<float> normals( 16 * objects );
+  std::vector<float> lights( 4 * objects );
+  float view[16];
+  float light[4] = { 0.0f, 5.0f, 10.0f, 1.0f };
+  for( int i = 0; i < objects; i++ ){
+    randomAffine( &models[16 * i] );
+  }
+  randomAffine( view );
+  long calls = long(objects) * frames;
+  clock_t start;
+
+  start = clock( );
+  for( int f = 0; f < frames; f++ ){
+    for( int i = 0; i < objects; i++ ){
+      mat4Multiply( &modelViews[16 * i], view, &models[16 * i] );
+    }
+  }
+  printf( "%-18s %7.1f ns/call\n", "mat4Multiply", elapsed( start, calls ) );
+
+  start = clock( );
+  for( int f = 0; f < frames; f++ ){
+    for( int i = 0; i < objects; i++ ){
+      mat4TransformVec4( &lights[4 * i], &modelViews[16 * i], light );
+    }
+  }
+  printf( "%-18s %7.1f ns/call\n", "mat4TransformVec4", elapsed( start, calls ) );
+
+  start = clock( );
+  for( int f = 0; f < frames; f++ ){
+    for( int i = 0; i < objects; i++ ){
+      mat4Inverse( &normals[16 * i], &modelViews[16 * i] );
+    }
+  }
+  printf( "%-18s %7.1f ns/call\n", "mat4Inverse", elapsed( start, calls ) );
+
+  start = clock( );
+  for( int f = 0; f < frames; f++ ){
+    for( int i = 0; i < objects; i++ ){
+      mat4AffineInverse( &normals[16 * i], &modelViews[16 * i] );
+    }
+  }
+  printf( "%-18s %7.1f ns/call\n", "mat4AffineInverse", elapsed( start, calls ) );
+
+  start = clock( );
+  for( int f = 0; f < frames; f++ ){
+    for( int i = 0; i < objects; i++ ){
+      mat3NormalMatrix( &normals[16 * i], &modelViews[16 * i] );
+    }
+  }
+  printf( "%-18s %7.1f ns/call\n", "mat3NormalMatrix", elapsed( start, calls ) );
+
+  start = clock( );
+  for( int f = 0; f < frames; f++ ){
+    for( int i = 0; i < objects; i++ ){
+      mat4NormalMatrix( &normals[16 * i], &modelViews[16 * i] );
+    }
+  }
+  printf( "%-18s %7.1f ns/call\n", "mat4NormalMatrix", elapsed( start, calls ) );
+
+  sink = modelViews[0] + normals[0] + lights[0];
+}
+
+int main( int argc, char* argv[] ){
+  int objects = argc > 1 ? atoi( argv[1] ) : 50000;
+  int frames = argc > 2 ? atoi( argv[2] ) : 100;
+  printf( "Using the %s kernels.\n", matrixSimdName( ) );
+  checkAll( 10000 );
+  if( failures > 0 ){
+    fprintf( stderr, "%d results differ from the reference\n", failures );
+    return( 1 );
+  }
+  printf( "%d objects, %d frames\n", objects, frames );
+  timeAll( objects, frames );
+  return( 0 );
+}
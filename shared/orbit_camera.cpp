@@ -0,0 +1,245 @@
+//
+// Michael Shafae
+// mshafae at fullerton.edu
+//
+// A camera that orbits a center point, oriented by a unit quaternion.
+//
+// $Id$
+//
+// STUDENTS DO NOT NEED TO MAKE ANY CHANGES TO THIS FILE.
+//
+
+#ifdef WIN32
+// For those who wish to use MSVS, the math defines, such as M_PI, are
+// not defined by default.
+#define _USE_MATH_DEFINES
+#endif
+
+#include <cmath>
+#include "orbit_camera.h"
+
+// Each rotation composed into the target adds a little rounding error
+// to its length. Normalizing every so often keeps it a rotation; a
+// few dozen products are far too few for the error to show.
+#define RENORMALIZE_PERIOD 32
+
+// Past this cosine the arc between two orientations is so short that
+// slerp's sine is mostly rounding error; interpolate linearly instead.
+#define SLERP_LINEAR_THRESHOLD 0.9995
+
+Quaternion quatFromAxisAngle( double degrees, double x, double y, double z ){
+  Quaternion q;
+  double length = sqrt( x * x + y * y + z * z );
+  double half = degrees * M_PI / 360.0;
+  double s = length > 0.0 ? sin(half) / length : 0.0;
+  q.w = cos(half);
+  q.x = x * s;
+  q.y = y * s;
+  q.z = z * s;
+  return( q );
+}
+
+Quaternion quatMultiply( const Quaternion& a, const Quaternion& b ){
+  Quaternion q;
+  q.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+  q.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+  q.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+  q.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+  return( q );
+}
+
+Quaternion quatNormalize( const Quaternion& q ){
+  Quaternion n;
+  double length = sqrt( q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z );
+  n.w = q.w / length;
+  n.x = q.x / length;
+  n.y = q.y / length;
+  n.z = q.z / length;
+  return( n );
+}
+
+Quaternion quatSlerp( const Quaternion& a, const Quaternion& b, double t ){
+  Quaternion q;
+  double d = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+  // q and -q are the same rotation; pick the sign of b that is nearer
+  // to a so the camera takes the short way round.
+  double sign = d < 0.0 ? -1.0 : 1.0;
+  double wa, wb;
+  d *= sign;
+  if( d > SLERP_LINEAR_THRESHOLD ){
+    wa = 1.0 - t;
+    wb = t;
+  }else{
+    double angle = acos(d);
+    double s = sin(angle);
+    wa = sin((1.0 - t) * angle) / s;
+    wb = sin(t * angle) / s;
+  }
+  wb *= sign;
+  q.w = wa * a.w + wb * b.w;
+  q.x = wa * a.x + wb * b.x;
+  q.y = wa * a.y + wb * b.y;
+  q.z = wa * a.z + wb * b.z;
+  return( quatNormalize( q ) );
+}
+
+void quatToAxes( const Quaternion& q, double *x, double *y, double *z ){
+  double xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+  double xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+  double wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+  x[0] = 1.0 - 2.0 * (yy + zz);
+  x[1] = 2.0 * (xy + wz);
+  x[2] = 2.0 * (xz - wy);
+  y[0] = 2.0 * (xy - wz);
+  y[1] = 1.0 - 2.0 * (xx + zz);
+  y[2] = 2.0 * (yz + wx);
+  z[0] = 2.0 * (xz + wy);
+  z[1] = 2.0 * (yz - wx);
+  z[2] = 1.0 - 2.0 * (xx + yy);
+}
+
+// The rotation whose columns are the orthonormal axes x, y and z,
+// after Shepperd: start from the largest of the four squared
+// components so the division is well conditioned.
+static Quaternion quatFromAxes( const double *x, const double *y,
+                                const double *z ){
+  Quaternion q;
+  double trace = x[0] + y[1] + z[2];
+  if( trace > 0.0 ){
+    double s = 2.0 * sqrt( 1.0 + trace );
+    q.w = 0.25 * s;
+    q.x = (y[2] - z[1]) / s;
+    q.y = (z[0] - x[2]) / s;
+    q.z = (x[1] - y[0]) / s;
+  }else if( x[0] > y[1] && x[0] > z[2] ){
+    double s = 2.0 * sqrt( 1.0 + x[0] - y[1] - z[2] );
+    q.w = (y[2] - z[1]) / s;
+    q.x = 0.25 * s;
+    q.y = (y[0] + x[1]) / s;
+    q.z = (z[0] + x[2]) / s;
+  }else if( y[1] > z[2] ){
+    double s = 2.0 * sqrt( 1.0 + y[1] - x[0] - z[2] );
+    q.w = (z[0] - x[2]) / s;
+    q.x = (y[0] + x[1]) / s;
+    q.y = 0.25 * s;
+    q.z = (z[1] + y[2]) / s;
+  }else{
+    double s = 2.0 * sqrt( 1.0 + z[2] - x[0] - y[1] );
+    q.w = (x[1] - y[0]) / s;
+    q.x = (z[0] + x[2]) / s;
+    q.y = (z[1] + y[2]) / s;
+    q.z = 0.25 * s;
+  }
+  return( quatNormalize( q ) );
+}
+
+OrbitCamera::OrbitCamera( ){
+  float eye[] = {0.0, 0.0, 1.0};
+  float center[] = {0.0, 0.0, 0.0};
+  float up[] = {0.0, 1.0, 0.0};
+  _duration = 0.1;
+  lookAt( eye, center, up );
+}
+
+void OrbitCamera::lookAt( const float *eye, const float *center,
+                          const float *up ){
+  double x[3], y[3], z[3];
+  double length;
+  for( int i = 0; i < 3; i++ ){
+    _center[i] = center[i];
+    z[i] = eye[i] - center[i];
+  }
+  _distance = sqrt( z[0] * z[0] + z[1] * z[1] + z[2] * z[2] );
+  for( int i = 0; i < 3; i++ ){
+    z[i] /= _distance;
+  }
+  // The camera's x axis is up cross z and its y axis z cross x, as in
+  // gluLookAt( ).
+  x[0] = up[1] * z[2] - up[2] * z[1];
+  x[1] = up[2] * z[0] - up[0] * z[2];
+  x[2] = up[0] * z[1] - up[1] * z[0];
+  length = sqrt( x[0] * x[0] + x[1] * x[1] + x[2] * x[2] );
+  for( int i = 0; i < 3; i++ ){
+    x[i] /= length;
+  }
+  y[0] = z[1] * x[2] - z[2] * x[1];
+  y[1] = z[2] * x[0] - z[0] * x[2];
+  y[2] = z[0] * x[1] - z[1] * x[0];
+  _target = quatFromAxes( x, y, z );
+  _start = _target;
+  _current = _target;
+  _elapsed = _duration;
+  _steps = 0;
+}
+
+// The delta is about one of the camera's own axes, so it is applied
+// before the orientation: _target * delta.
+void OrbitCamera::beginTransition( const Quaternion& delta ){
+  _start = _current;
+  _target = quatMultiply( _target, delta );
+  if( ++_steps == RENORMALIZE_PERIOD ){
+    _target = quatNormalize( _target );
+    _steps = 0;
+  }
+  _elapsed = 0.0;
+  update( 0.0 );
+}
+
+void OrbitCamera::rotateLeft( float degrees ){
+  beginTransition( quatFromAxisAngle( degrees, 0.0, 1.0, 0.0 ) );
+}
+
+void OrbitCamera::rotateUp( float degrees ){
+  beginTransition( quatFromAxisAngle( degrees, 1.0, 0.0, 0.0 ) );
+}
+
+void OrbitCamera::setTransitionTime( double seconds ){
+  _duration = seconds;
+}
+
+void OrbitCamera::update( double seconds ){
+  double t;
+  _elapsed += seconds;
+  if( _elapsed >= _duration ){
+    _current = _target;
+    return;
+  }
+  // Ease out: the camera starts at full speed, so a held key keeps it
+  // moving steadily, and slows to a stop at the target.
+  t = _elapsed / _duration;
+  _current = quatSlerp( _start, _target, t * (2.0 - t) );
+}
+
+void OrbitCamera::viewMatrix( float *matrix ) const{
+  double x[3], y[3], z[3];
+  quatToAxes( _current, x, y, z );
+  // The rows of the rotation are the camera's axes; the eye sits
+  // _distance along z from the center.
+  for( int i = 0; i < 3; i++ ){
+    matrix[4 * i] = x[i];
+    matrix[4 * i + 1] = y[i];
+    matrix[4 * i + 2] = z[i];
+    matrix[4 * i + 3] = 0.0;
+  }
+  matrix[12] = -(x[0] * _center[0] + x[1] * _center[1] + x[2] * _center[2]);
+  matrix[13] = -(y[0] * _center[0] + y[1] * _center[1] + y[2] * _center[2]);
+  matrix[14] = -(z[0] * _center[0] + z[1] * _center[1] + z[2] * _center[2])
+               - _distance;
+  matrix[15] = 1.0;
+}
+
+void OrbitCamera::eyePosition( float *eye ) const{
+  double x[3], y[3], z[3];
+  quatToAxes( _current, x, y, z );
+  for( int i = 0; i < 3; i++ ){
+    eye[i] = _center[i] + _distance * z[i];
+  }
+}
+
+void OrbitCamera::upVector( float *up ) const{
+  double x[3], y[3], z[3];
+  quatToAxes( _current, x, y, z );
+  for( int i = 0; i < 3; i++ ){
+    up[i] = y[i];
+  }
+}
@@ -0,0 +1,124 @@
+//
+// Michael Shafae
+// mshafae at fullerton.edu
+//
+// A camera that orbits a center point. Its orientation is kept as a
+// unit quaternion rather than as an eye position and up vector, so
+// rotating it many times does not let the axes drift apart, and a
+// change of direction can be animated by interpolating between two
+// orientations. The viewing matrix is computed on the CPU; nothing
+// here calls OpenGL.
+//
+// $Id$
+//
+// STUDENTS DO NOT NEED TO MAKE ANY CHANGES TO THIS FILE.
+//
+
+#ifndef _ORBIT_CAMERA_H_
+#define _ORBIT_CAMERA_H_
+
+/*
+ * A quaternion w + xi + yj + zk. Rotations are unit quaternions.
+ */
+typedef struct Quaternion{
+  double w, x, y, z;
+}Quaternion;
+
+/*
+ * quatFromAxisAngle( ) returns the rotation by degrees around the
+ * axis x, y, z, which need not be of unit length.
+ */
+Quaternion quatFromAxisAngle( double degrees, double x, double y, double z );
+
+/*
+ * quatMultiply( ) returns a * b, the rotation b followed by a.
+ */
+Quaternion quatMultiply( const Quaternion& a, const Quaternion& b );
+
+/*
+ * quatNormalize( ) returns q scaled to unit length.
+ */
+Quaternion quatNormalize( const Quaternion& q );
+
+/*
+ * quatSlerp( ) returns the rotation a fraction t of the way from a to
+ * b along the shorter arc between them, at constant angular speed.
+ * a, b: unit quaternions
+ * t: 0 gives a, 1 gives b
+ */
+Quaternion quatSlerp( const Quaternion& a, const Quaternion& b, double t );
+
+/*
+ * quatToAxes( ) writes the images of the x, y and z axes under the
+ * rotation q, the columns of its rotation matrix.
+ */
+void quatToAxes( const Quaternion& q, double *x, double *y, double *z );
+
+class OrbitCamera{
+private:
+  // The orientation when the current transition began, the one being
+  // shown and the one the camera is heading for.
+  Quaternion _start;
+  Quaternion _current;
+  Quaternion _target;
+  double _center[3];
+  double _distance;
+  // How long a transition takes and how far into it the camera is,
+  // in seconds.
+  double _duration;
+  double _elapsed;
+  // Rotations composed into _target since it was last normalized.
+  int _steps;
+
+  void beginTransition( const Quaternion& delta );
+
+public:
+  OrbitCamera( );
+
+  /*
+   * lookAt( ) places the camera as gluLookAt( ) would and cancels any
+   * transition. The distance from eye to center is kept as the orbit's
+   * radius.
+   * eye: Specifies the position of the eye point.
+   * center: Specifies the position of the reference point.
+   * up: Specifies the direction of the up vector.
+   */
+  void lookAt( const float *eye, const float *center, const float *up );
+
+  /*
+   * rotateLeft( ) orbits the camera by degrees around its up vector.
+   * rotateUp( ) orbits the camera by degrees around its right vector.
+   * The camera turns there over the transition time, starting from
+   * wherever it is shown now, so pressing a key again while it is
+   * moving continues smoothly.
+   */
+  void rotateLeft( float degrees );
+  void rotateUp( float degrees );
+
+  /*
+   * setTransitionTime( ) sets how many seconds a rotation takes to
+   * play out; 0 makes rotations take effect at once.
+   */
+  void setTransitionTime( double seconds );
+
+  /*
+   * update( ) advances the transition by the given number of seconds.
+   * Call it once per frame.
+   */
+  void update( double seconds );
+
+  /*
+   * viewMatrix( ) writes the viewing matrix for the orientation being
+   * shown, in column major order, ready for glLoadMatrixf( ).
+   */
+  void viewMatrix( float *matrix ) const;
+
+  /*
+   * eyePosition( ) and upVector( ) write the eye point and up vector
+   * for the orientation being shown.
+   */
+  void eyePosition( float *eye ) const;
+  void upVector( float *up ) const;
+};
+
+#endif
@@ -0,0 +1,252 @@
+//
+// Michael Shafae
+// mshafae at fullerton.edu
+//
+// Checks OrbitCamera against gluLookAt( )'s matrices, by way of the
+// compile-time checked ctLookAt( ) and ctRotate( ), then compares how
+// far its axes drift from orthonormal after many rotations with how
+// far an eye position and up vector kept in floats drift, and times
+// it. Build and run it with
+//
+//   c++ -std=c++11 -O2 -o orbit_camera_bench orbit_camera_bench.cpp orbit_camera.cpp
+//   ./orbit_camera_bench
+//
+// It exits with a non-zero status if any check fails.
+//
+// $Id$
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include "orbit_camera.h"
+#include "transformations_constexpr.h"
+#include "bench_check.h"
+
+double randomUnit( ){
+  return( rand( ) / double(RAND_MAX) * 2.0 - 1.0 );
+}
+
+// The largest amount by which the rotation part of a viewing matrix
+// differs from orthonormal.
+double orthonormalError( const float *m ){
+  double worst = 0.0;
+  for( int i = 0; i < 3; i++ ){
+    for( int j = 0; j < 3; j++ ){
+      double d = m[i] * m[j] + m[4 + i] * m[4 + j] + m[8 + i] * m[8 + j];
+      d = fabs( d - (i == j ? 1.0 : 0.0) );
+      worst = d > worst ? d : worst;
+    }
+  }
+  return( worst );
+}
+
+void transformPoint( float *out, const Matrix4f& m, const float *p ){
+  for( int i = 0; i < 3; i++ ){
+    out[i] = m.m[i] * p[0] + m.m[4 + i] * p[1] + m.m[8 + i] * p[2] +
+             m.m[12 + i];
+  }
+}
+
+void checkAll( ){
+  OrbitCamera camera;
+  float m[16];
+  camera.setTransitionTime( 0.0 );
+
+  float eye[] = {0.0, 0.0, 5.0};
+  float center[] = {0.0, 0.0, 0.0};
+  float up[] = {0.0, 1.0, 0.0};
+  camera.lookAt( eye, center, up );
+  camera.viewMatrix( m );
+  checkMatrix( "lookAt", m, ctLookAt( 0.0, 0.0, 5.0, 0.0, 0.0, 0.0,
+                                      0.0, 1.0, 0.0 ).m );
+
+  float eye2[] = {3.0, 4.0, -2.0};
+  float center2[] = {0.5, -1.0, 1.0};
+  float up2[] = {0.2, 1.0, 0.1};
+  camera.lookAt( eye2, center2, up2 );
+  camera.viewMatrix( m );
+  checkMatrix( "lookAt oblique", m, ctLookAt( 3.0, 4.0, -2.0, 0.5, -1.0, 1.0,
+                                              0.2, 1.0, 0.1 ).m );
+
+  // Orientations that take each branch of the conversion from axes to
+  // a quaternion.
+  float eye3[] = {0.0, 0.0, -5.0};
+  float up3[] = {0.0, -1.0, 0.0};
+  camera.lookAt( eye3, center, up3 );
+  camera.viewMatrix( m );
+  checkMatrix( "lookAt behind", m, ctLookAt( 0.0, 0.0, -5.0, 0.0, 0.0, 0.0,
+                                             0.0, -1.0, 0.0 ).m );
+  float up4[] = {1.0, 0.0, 0.0};
+  camera.lookAt( eye3, center, up4 );
+  camera.viewMatrix( m );
+  checkMatrix( "lookAt behind, rolled", m,
+               ctLookAt( 0.0, 0.0, -5.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0 ).m );
+  float eye5[] = {0.0, 0.0, 5.0};
+  float up5[] = {0.0, -1.0, 0.0};
+  camera.lookAt( eye5, center, up5 );
+  camera.viewMatrix( m );
+  checkMatrix( "lookAt upside down", m,
+               ctLookAt( 0.0, 0.0, 5.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0 ).m );
+
+  // rotateLeft( ) turns the eye and up vector around the up vector
+  // through the center, rotateUp( ) around the right vector.
+  float rotated[3], upRotated[3], expected[16];
+  camera.lookAt( eye2, center2, up2 );
+  camera.rotateLeft( 30.0 );
+  camera.viewMatrix( m );
+  Matrix4f view = ctLookAt( 3.0, 4.0, -2.0, 0.5, -1.0, 1.0, 0.2, 1.0, 0.1 );
+  Matrix4f turn = ctMultiply( ctTranslate( 0.5, -1.0, 1.0 ),
+    ctMultiply( ctRotate( 30.0, view.m[1], view.m[5], view.m[9] ),
+                ctTranslate( -0.5, 1.0, -1.0 ) ) );
+  transformPoint( rotated, turn, eye2 );
+  camera.upVector( upRotated );
+  Matrix4f rotatedView = ctLookAt( rotated[0], rotated[1], rotated[2],
+                                   0.5, -1.0, 1.0,
+                                   upRotated[0], upRotated[1], upRotated[2] );
+  for( int i = 0; i < 16; i++ ){
+    expected[i] = rotatedView.m[i];
+  }
+  checkMatrix( "rotateLeft", m, expected );
+
+  camera.lookAt( eye2, center2, up2 );
+  camera.rotateUp( -40.0 );
+  camera.viewMatrix( m );
+  turn = ctMultiply( ctTranslate( 0.5, -1.0, 1.0 ),
+    ctMultiply( ctRotate( -40.0, view.m[0], view.m[4], view.m[8] ),
+                ctTranslate( -0.5, 1.0, -1.0 ) ) );
+  transformPoint( rotated, turn, eye2 );
+  Matrix4f upTurn = ctRotate( -40.0, view.m[0], view.m[4], view.m[8] );
+  // The camera's up axis, the second row of view, turned the same way.
+  for( int i = 0; i < 3; i++ ){
+    upRotated[i] = upTurn.m[i] * view.m[1] + upTurn.m[4 + i] * view.m[5] +
+                   upTurn.m[8 + i] * view.m[9];
+  }
+  rotatedView = ctLookAt( rotated[0], rotated[1], rotated[2],
+                          0.5, -1.0, 1.0,
+                          upRotated[0], upRotated[1], upRotated[2] );
+  for( int i = 0; i < 16; i++ ){
+    expected[i] = rotatedView.m[i];
+  }
+  checkMatrix( "rotateUp", m, expected );
+
+  // Halfway through a transition the camera is halfway round, and the
+  // transition ends exactly at the target.
+  camera.setTransitionTime( 1.0 );
+  camera.lookAt( eye, center, up );
+  camera.rotateLeft( 90.0 );
+  camera.viewMatrix( m );
+  checkMatrix( "transition start", m, ctLookAt( 0.0, 0.0, 5.0, 0.0, 0.0, 0.0,
+                                                0.0, 1.0, 0.0 ).m );
+  // Eased, t = 1 - sqrt(1/2) gives the midpoint, 45 degrees.
+  camera.update( 1.0 - sqrt(0.5) );
+  camera.viewMatrix( m );
+  double s = 5.0 * sqrt(0.5);
+  checkMatrix( "transition middle", m, ctLookAt( s, 0.0, s, 0.0, 0.0, 0.0,
+                                                 0.0, 1.0, 0.0 ).m );
+  camera.update( 1.0 );
+  camera.viewMatrix( m );
+  checkMatrix( "transition end", m, ctLookAt( 5.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+                                              0.0, 1.0, 0.0 ).m );
+
+  Quaternion a = quatFromAxisAngle( 170.0, 0.0, 1.0, 0.0 );
+  Quaternion b = quatFromAxisAngle( -170.0, 0.0, 1.0, 0.0 );
+  Quaternion h = quatSlerp( a, b, 0.5 );
+  if( checkTrue( fabs( fabs(h.y) - 1.0 ) <= CHECK_TOLERANCE,
+                 "quatSlerp: went the long way round" ) ){
+    printf( "%-22s ok\n", "slerp shorter arc" );
+  }
+}
+
+// The way the apps used to keep the camera: an eye position and an up
+// vector in floats, each rotated by a matrix built from sin and cos on
+// every key press.
+void rotateFloats( float degrees, const float *axis, float *eye, float *up ){
+  float r = degrees * float(M_PI) / 180.0f;
+  float c = cosf(r), s = sinf(r), t = 1.0f - c;
+  float length = sqrtf( axis[0] * axis[0] + axis[1] * axis[1] +
+                        axis[2] * axis[2] );
+  float x = axis[0] / length, y = axis[1] / length, z = axis[2] / length;
+  float m[9] = { x * x * t + c, y * x * t + z * s, x * z * t - y * s,
+                 x * y * t - z * s, y * y * t + c, y * z * t + x * s,
+                 x * z * t + y * s, y * z * t - x * s, z * z * t + c };
+  float e[3] = { eye[0], eye[1], eye[2] };
+  float u[3] = { up[0], up[1], up[2] };
+  for( int i = 0; i < 3; i++ ){
+    eye[i] = m[i] * e[0] + m[3 + i] * e[1] + m[6 + i] * e[2];
+    up[i] = m[i] * u[0] + m[3 + i] * u[1] + m[6 + i] * u[2];
+  }
+}
+
+void compareDrift( int n ){
+  OrbitCamera camera;
+  float eye[] = {0.0, 0.0, 5.0};
+  float center[] = {0.0, 0.0, 0.0};
+  float up[] = {0.0, 1.0, 0.0};
+  float m[16];
+  camera.setTransitionTime( 0.0 );
+  camera.lookAt( eye, center, up );
+  srand( 1 );
+  for( int i = 0; i < n; i++ ){
+    float degrees = 10.0 * randomUnit( );
+    if( i % 2 ){
+      camera.rotateLeft( degrees );
+      rotateFloats( degrees, up, eye, up );
+    }else{
+      float right[3] = { up[1] * eye[2] - up[2] * eye[1],
+                         up[2] * eye[0] - up[0] * eye[2],
+                         up[0] * eye[1] - up[1] * eye[0] };
+      camera.rotateUp( degrees );
+      rotateFloats( degrees, right, eye, up );
+    }
+  }
+  camera.viewMatrix( m );
+  double dot = (eye[0] * up[0] + eye[1] * up[1] + eye[2] * up[2]) / 5.0;
+  double upLength = sqrt( up[0] * up[0] + up[1] * up[1] + up[2] * up[2] );
+  double eyeLength = sqrt( eye[0] * eye[0] + eye[1] * eye[1] + eye[2] * eye[2] );
+  printf( "After %d rotations:\n", n );
+  printf( "  quaternion camera: axes off orthonormal by %.3g\n",
+          orthonormalError( m ) );
+  printf( "  float eye and up:  eye.up %.3g, |up| %.9g, |eye| %.9g\n",
+          dot, upLength, eyeLength );
+  checkTrue( orthonormalError( m ) <= CHECK_TOLERANCE,
+             "OrbitCamera drifted" );
+}
+
+// Keeps the compiler from dropping the work being timed.
+volatile float sink;
+
+void timeAll( int n ){
+  OrbitCamera camera;
+  float m[16];
+  clock_t start = clock( );
+  for( int i = 0; i < n; i++ ){
+    camera.rotateLeft( 5.0 );
+    camera.update( 0.016 );
+    camera.viewMatrix( m );
+    sink = m[14];
+  }
+  printf( "rotate, update and view %6.1f ns/frame\n",
+          double(clock( ) - start) / CLOCKS_PER_SEC * 1.0e9 / n );
+  start = clock( );
+  for( int i = 0; i < n; i++ ){
+    camera.update( 0.016 );
+    camera.viewMatrix( m );
+    sink = m[14];
+  }
+  printf( "update and view         %6.1f ns/frame\n",
+          double(clock( ) - start) / CLOCKS_PER_SEC * 1.0e9 / n );
+}
+
+int main( int argc, char* argv[] ){
+  int n = argc > 1 ? atoi( argv[1] ) : 1000000;
+  checkAll( );
+  compareDrift( n );
+  if( failures > 0 ){
+    fprintf( stderr, "%d checks failed\n", failures );
+    return( 1 );
+  }
+  timeAll( n );
+  return( 0 );
+}
@@ -0,0 +1,210 @@
+//
+// Michael Shafae
+// mshafae at fullerton.edu
+//
+// Checks the matrices built by transformations.cpp against the ones
+// OpenGL and GLU build and against the constexpr builders in
+// transformations_constexpr.h, then times each function.
+//
+// The reference matrices were read back with glGetFloatv( ) after the
+// matching glTranslatef( ), glScalef( ), glRotatef( ), gluLookAt( ),
+// glFrustum( ), gluPerspective( ) and glOrtho( ) calls. No GL context
+// is needed to run it. It is linked with an app's transformations.cpp,
+// so build and run it from texture_glfw or texture_glut:
+//
+//   c++ -std=c++11 -O2 -DNO_SOLUTION -I. -I../shared -o transformations_bench ../shared/transformations_bench.cpp transformations.cpp
+//   ./transformations_bench
+//
+// It exits with a non-zero status if any matrix is off by more than
+// the tolerance.
+//
+// $Id$
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "transformations.h"
+#include "transformations_constexpr.h"
+#include "bench_check.h"
+
+void checkAll( ){
+  GLfloat m[16];
+
+  const GLfloat translate[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0,
+                                  1.5, -2, 3.25, 1 };
+  myTranslatef( m, 1.5, -2.0, 3.25 );
+  checkMatrix( "translate", m, translate );
+
+  const GLfloat scale[16] = { 2, 0, 0, 0, 0, 0.5, 0, 0, 0, 0, -3, 0,
+                              0, 0, 0, 1 };
+  myScalef( m, 2.0, 0.5, -3.0 );
+  checkMatrix( "scale", m, scale );
+
+  const GLfloat rotate[16] = {
+    0.875594974, 0.420031071, -0.238552392, 0,
+    -0.38175261, 0.904303849, 0.191048309, 0,
+    0.295970082, -0.0762129277, 0.952151895, 0,
+    0, 0, 0, 1 };
+  myRotatef( m, 30.0, 1.0, 2.0, 3.0 );
+  checkMatrix( "rotate", m, rotate );
+
+  const GLfloat rotateZ[16] = {
+    0.258819073, -0.965925813, 0, 0,
+    0.965925813, 0.258819073, 0, 0,
+    0, 0, 1, 0,
+    0, 0, 0, 1 };
+  myRotatef( m, -75.0, 0.0, 0.0, 2.0 );
+  checkMatrix( "rotate z", m, rotateZ );
+
+  const GLfloat lookAt[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0,
+                               0, 0, -5, 1 };
+  myLookAt( m, 0.0, 0.0, 5.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0 );
+  checkMatrix( "lookAt", m, lookAt );
+
+  const GLfloat lookAt2[16] = {
+    -0.897067368, -0.199976623, 0.394055188, 0,
+    0.217859209, 0.575690329, 0.788110375, 0,
+    -0.384457409, 0.792836666, -0.472866237, 0,
+    1.05085051, -0.117158175, -5.28033972, 1 };
+  myLookAt( m, 3.0, 4.0, -2.0, 0.5, -1.0, 1.0, 0.2, 1.0, 0.1 );
+  checkMatrix( "lookAt oblique", m, lookAt2 );
+
+  const GLfloat frustum[16] = {
+    0.666666687, 0, 0, 0,
+    0, 1, 0, 0,
+    0.333333343, 0.5, -1.08333337, -1,
+    0, 0, -2.08333325, 0 };
+  myFrustum( m, -1.0, 2.0, -0.5, 1.5, 1.0, 25.0 );
+  checkMatrix( "frustum", m, frustum );
+
+  // The projection the texture apps use for a 4:3 window.
+  const GLfloat perspective[16] = {
+    0.75, 0, 0, 0,
+    0, 1, 0, 0,
+    0, 0, -1.08333337, -1,
+    0, 0, -2.08333325, 0 };
+  myPerspective( m, 90.0, 4.0 / 3.0, 1.0, 25.0 );
+  checkMatrix( "perspective", m, perspective );
+
+  const GLfloat perspective2[16] = {
+    2.41421366, 0, 0, 0,
+    0, 2.41421366, 0, 0,
+    0, 0, -1.002002, -1,
+    0, 0, -0.2002002, 0 };
+  myPerspective( m, 45.0, 1.0, 0.1, 100.0 );
+  checkMatrix( "perspective 45", m, perspective2 );
+
+  const GLfloat ortho[16] = {
+    0.142857149, 0, 0, 0,
+    0, 0.142857149, 0, 0,
+    0, 0, -0.0833333358, 0,
+    0, 0, -1.08333337, 1 };
+  myOrtho( m, -7.0, 7.0, -7.0, 7.0, 1.0, 25.0 );
+  checkMatrix( "ortho", m, ortho );
+
+  const GLfloat ortho2[16] = {
+    0.5, 0, 0, 0,
+    0, 0.800000012, 0, 0,
+    0, 0, -0.200000003, 0,
+    -0.5, 0.600000024, -0.200000003, 1 };
+  myOrtho( m, -1.0, 3.0, -2.0, 0.5, -4.0, 6.0 );
+  checkMatrix( "ortho off axis", m, ortho2 );
+}
+
+// The run-time functions use the C math library and the constexpr
+// builders their own series, so the two are compared over a sweep of
+// arguments, angles of several turns included.
+void checkConstexpr( ){
+  GLfloat m[16];
+  bool ok = true;
+  for( int i = -20; i <= 20 && ok; i++ ){
+    double a = 37.0 * i;
+    double x = 0.3 * i, y = 1.0 - 0.05 * i, z = 2.0;
+    myRotatef( m, a, x, y, z );
+    ok = checkElements( "rotate", m, ctRotate( a, x, y, z ).m, 16 );
+    myLookAt( m, x, y, z + 5.0, 0.1 * i, 0.0, 0.0, 0.0, 1.0, 0.0 );
+    ok = ok && checkElements( "lookAt", m,
+      ctLookAt( x, y, z + 5.0, 0.1 * i, 0.0, 0.0, 0.0, 1.0, 0.0 ).m, 16 );
+    myPerspective( m, 90.0 + 4.0 * i, 1.0 + 0.1 * i * i, 0.5, 50.0 );
+    ok = ok && checkElements( "perspective", m,
+      ctPerspective( 90.0 + 4.0 * i, 1.0 + 0.1 * i * i, 0.5, 50.0 ).m, 16 );
+  }
+  if( ok ){
+    printf( "%-22s ok\n", "same as constexpr" );
+  }
+}
+
+// Keeps the compiler from dropping the calls being timed.
+volatile GLfloat sink;
+
+void report( const char *name, clock_t start, int n ){
+  double ns = double(clock( ) - start) / CLOCKS_PER_SEC * 1.0e9 / n;
+  printf( "%-14s %8.1f ns/call\n", name, ns );
+}
+
+void timeAll( int n ){
+  GLfloat m[16];
+  clock_t start;
+
+  start = clock( );
+  for( int i = 0; i < n; i++ ){
+    myTranslatef( m, i, 2.0, 3.0 );
+    sink = m[12];
+  }
+  report( "myTranslatef", start, n );
+
+  start = clock( );
+  for( int i = 0; i < n; i++ ){
+    myScalef( m, i, 2.0, 3.0 );
+    sink = m[0];
+  }
+  report( "myScalef", start, n );
+
+  start = clock( );
+  for( int i = 0; i < n; i++ ){
+    myRotatef( m, i % 360, 1.0, 2.0, 3.0 );
+    sink = m[0];
+  }
+  report( "myRotatef", start, n );
+
+  start = clock( );
+  for( int i = 0; i < n; i++ ){
+    myLookAt( m, i % 7, 4.0, -2.0, 0.5, -1.0, 1.0, 0.0, 1.0, 0.0 );
+    sink = m[14];
+  }
+  report( "myLookAt", start, n );
+
+  start = clock( );
+  for( int i = 0; i < n; i++ ){
+    myFrustum( m, -1.0, 2.0, -0.5, 1.5, 1.0, 25.0 + i % 7 );
+    sink = m[14];
+  }
+  report( "myFrustum", start, n );
+
+  start = clock( );
+  for( int i = 0; i < n; i++ ){
+    myPerspective( m, 60.0 + i % 7, 4.0 / 3.0, 1.0, 25.0 );
+    sink = m[0];
+  }
+  report( "myPerspective", start, n );
+
+  start = clock( );
+  for( int i = 0; i < n; i++ ){
+    myOrtho( m, -7.0, 7.0, -7.0, 7.0, 1.0, 25.0 + i % 7 );
+    sink = m[14];
+  }
+  report( "myOrtho", start, n );
+}
+
+int main( int argc, char* argv[] ){
+  int n = argc > 1 ? atoi( argv[1] ) : 10000000;
+  checkAll( );
+  checkConstexpr( );
+  if( failures > 0 ){
+    fprintf( stderr, "%d matrices differ from OpenGL's\n", failures );
+    return( 1 );
+  }
+  timeAll( n );
+  return( 0 );
+}
@@ -0,0 +1,421 @@
+//
+// Michael Shafae
+// mshafae at fullerton.edu
+//
+// constexpr matrix builders for matrices whose arguments are constants.
+// The compiler evaluates them, so a fixed camera or projection becomes
+// a table of sixteen floats in the executable instead of a computation
+// at run time.
+//
+// The sine, cosine and square root here are a series and recursions
+// the compiler can evaluate; run, they are several times slower than
+// the C math library. For arguments known only at run time use the
+// my*( ) functions in transformations.cpp, which build the same
+// matrices with sin( ), cos( ) and sqrt( ); transformations_bench
+// checks that the two agree. ctMultiply( ), ctTranslate( ) and
+// ctScale( ) use no such functions and are cheap either way.
+//
+// The bodies are single return statements so that C++11 accepts them;
+// loops are written as recursion.
+//
+// $Id$
+//
+// STUDENTS DO NOT NEED TO MAKE ANY CHANGES TO THIS FILE.
+//
+
+#ifndef _TRANSFORMATIONS_CONSTEXPR_H_
+#define _TRANSFORMATIONS_CONSTEXPR_H_
+
+#include <limits>
+
+/*
+ * A 4x4 matrix in column major order, the way OpenGL stores it.
+ * Pass m to glLoadMatrixf( ) or glMultMatrixf( ).
+ */
+struct Matrix4f{
+  float m[16];
+};
+
+/*
+ * A vector used while building a viewing matrix.
+ */
+struct Vector3d{
+  double x, y, z;
+};
+
+#define CT_PI 3.14159265358979323846
+
+/*
+ * Helpers for the trigonometry. ctReduce( ) brings an angle in radians
+ * into [-pi, pi]. At 2^53 and beyond consecutive doubles are 2 or more
+ * apart, so a reduced angle would mean nothing; there, and for
+ * infinities and NaN, it returns NaN instead of overflowing the
+ * conversion to long long. ctTaylor( ) sums the series for sine or
+ * cosine from the given term onward; at |x| <= pi twenty terms reach
+ * double precision.
+ */
+#define CT_REDUCE_LIMIT 9007199254740992.0
+
+constexpr double ctReduce( double x ){
+  return !(x > -CT_REDUCE_LIMIT && x < CT_REDUCE_LIMIT) ?
+    std::numeric_limits<double>::quiet_NaN( ) :
+    x - 2.0 * CT_PI *
+      double((long long)((x + (x < 0.0 ? -CT_PI : CT_PI)) / (2.0 * CT_PI)));
+}
+
+constexpr double ctTaylor( double x2, double term, double sum, int n ){
+  return n > 40 ? sum :
+    ctTaylor( x2, -term * x2 / ((n + 1) * (n + 2)), sum + term, n + 2 );
+}
+
+constexpr double ctSinReduced( double r ){
+  return ctTaylor( r * r, r, 0.0, 1 );
+}
+
+constexpr double ctCosReduced( double r ){
+  return ctTaylor( r * r, 1.0, 0.0, 0 );
+}
+
+/*
+ * Sine, cosine and tangent of an angle in radians.
+ */
+constexpr double ctSin( double x ){
+  return ctSinReduced( ctReduce(x) );
+}
+
+constexpr double ctCos( double x ){
+  return ctCosReduced( ctReduce(x) );
+}
+
+constexpr double ctTan( double x ){
+  return ctSin(x) / ctCos(x);
+}
+
+constexpr double ctRadians( double degrees ){
+  return degrees * (CT_PI / 180.0);
+}
+
+/*
+ * Square root. Scaling x by powers of four, which is exact, brings it
+ * into [1, 4), so the root is in [1, 2) and is scaled back by the
+ * matching powers of two. From 2, Newton's method falls monotonically
+ * to the root and six steps reach double precision; eight are taken.
+ * Any positive finite double takes at most 32 scaling steps by 2^32
+ * and 16 by 4.
+ */
+constexpr double ctSqrtNewton( double x, double guess, int n ){
+  return n == 0 ? guess :
+    ctSqrtNewton( x, 0.5 * (guess + x / guess), n - 1 );
+}
+
+constexpr double ctSqrt( double x ){
+  return x <= 0.0 ? 0.0 :
+    x >= 4294967296.0 ? 65536.0 * ctSqrt( x / 4294967296.0 ) :
+    x >= 4.0 ? 2.0 * ctSqrt( x / 4.0 ) :
+    x < 1.0 / 4294967296.0 ? ctSqrt( x * 4294967296.0 ) / 65536.0 :
+    x < 1.0 ? ctSqrt( x * 4.0 ) / 2.0 :
+    ctSqrtNewton( x, 2.0, 8 );
+}
+
+/*
+ * Vector helpers for ctLookAt( ).
+ */
+constexpr Vector3d ctVector3( double x, double y, double z ){
+  return Vector3d{ x, y, z };
+}
+
+constexpr double ctDot( Vector3d a, Vector3d b ){
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+constexpr Vector3d ctCross( Vector3d a, Vector3d b ){
+  return Vector3d{ a.y * b.z - a.z * b.y,
+                   a.z * b.x - a.x * b.z,
+                   a.x * b.y - a.y * b.x };
+}
+
+constexpr Vector3d ctScaleVector( Vector3d a, double s ){
+  return Vector3d{ a.x * s, a.y * s, a.z * s };
+}
+
+constexpr Vector3d ctNormalize( Vector3d a ){
+  return ctScaleVector( a, 1.0 / ctSqrt( ctDot(a, a) ) );
+}
+
+/*
+ * ctMultiply( ) returns a * b, the matrix that applies b and then a,
+ * as glMultMatrixf( ) would leave it.
+ */
+constexpr float ctMultiplyElement( const Matrix4f& a, const Matrix4f& b,
+                                   int i, int j ){
+  return a.m[i] * b.m[4 * j] + a.m[4 + i] * b.m[4 * j + 1] +
+         a.m[8 + i] * b.m[4 * j + 2] + a.m[12 + i] * b.m[4 * j + 3];
+}
+
+constexpr Matrix4f ctMultiply( const Matrix4f& a, const Matrix4f& b ){
+  return Matrix4f{ {
+    ctMultiplyElement(a, b, 0, 0), ctMultiplyElement(a, b, 1, 0),
+    ctMultiplyElement(a, b, 2, 0), ctMultiplyElement(a, b, 3, 0),
+    ctMultiplyElement(a, b, 0, 1), ctMultiplyElement(a, b, 1, 1),
+    ctMultiplyElement(a, b, 2, 1), ctMultiplyElement(a, b, 3, 1),
+    ctMultiplyElement(a, b, 0, 2), ctMultiplyElement(a, b, 1, 2),
+    ctMultiplyElement(a, b, 2, 2), ctMultiplyElement(a, b, 3, 2),
+    ctMultiplyElement(a, b, 0, 3), ctMultiplyElement(a, b, 1, 3),
+    ctMultiplyElement(a, b, 2, 3), ctMultiplyElement(a, b, 3, 3) } };
+}
+
+/*
+ * ctTranslate( ) returns the matrix glTranslatef( ) multiplies by.
+ * x, y, z: Specify the x, y, and z coordinates of a translation vector.
+ */
+constexpr Matrix4f ctTranslate( double x, double y, double z ){
+  return Matrix4f{ { 1, 0, 0, 0,
+                     0, 1, 0, 0,
+                     0, 0, 1, 0,
+                     float(x), float(y), float(z), 1 } };
+}
+
+/*
+ * ctScale( ) returns the matrix glScalef( ) multiplies by.
+ * x, y, z: Specify scale factors along the x, y, and z axes, respectively.
+ */
+constexpr Matrix4f ctScale( double x, double y, double z ){
+  return Matrix4f{ { float(x), 0, 0, 0,
+                     0, float(y), 0, 0,
+                     0, 0, float(z), 0,
+                     0, 0, 0, 1 } };
+}
+
+/*
+ * ctRotate( ) returns the matrix glRotatef( ) multiplies by.
+ * angle: the amount of rotation in degrees
+ * x, y, z: the vector to rotate around; it need not be of unit length.
+ *          Like glRotatef( ), a zero vector gives the identity.
+ */
+constexpr Matrix4f ctRotateUnit( double c, double s, double x, double y,
+                                 double z ){
+  return Matrix4f{ {
+    float(x * x * (1 - c) + c), float(y * x * (1 - c) + z * s),
+    float(x * z * (1 - c) - y * s), 0,
+    float(x * y * (1 - c) - z * s), float(y * y * (1 - c) + c),
+    float(y * z * (1 - c) + x * s), 0,
+    float(x * z * (1 - c) + y * s), float(y * z * (1 - c) - x * s),
+    float(z * z * (1 - c) + c), 0,
+    0, 0, 0, 1 } };
+}
+
+constexpr Matrix4f ctRotateAxis( double radians, Vector3d axis ){
+  return ctRotateUnit( ctCos(radians), ctSin(radians),
+                       axis.x, axis.y, axis.z );
+}
+
+constexpr Matrix4f ctRotate( double angle, double x, double y, double z ){
+  return x == 0.0 && y == 0.0 && z == 0.0 ? ctScale( 1.0, 1.0, 1.0 ) :
+    ctRotateAxis( ctRadians(angle), ctNormalize( ctVector3(x, y, z) ) );
+}
+
+/*
+ * ctLookAt( ) returns the matrix gluLookAt( ) multiplies by.
+ * eyeX, eyeY, eyeZ: Specifies the position of the eye point.
+ * centerX, centerY, centerZ: Specifies the position of the
+ *                            reference point.
+ * upX, upY, upZ: Specifies the direction of the up vector.
+ */
+constexpr Matrix4f ctViewMatrix( Vector3d eye, Vector3d s, Vector3d u,
+                                 Vector3d f ){
+  return Matrix4f{ {
+    float(s.x), float(u.x), float(-f.x), 0,
+    float(s.y), float(u.y), float(-f.y), 0,
+    float(s.z), float(u.z), float(-f.z), 0,
+    float(-ctDot(s, eye)), float(-ctDot(u, eye)), float(ctDot(f, eye)), 1 } };
+}
+
+constexpr Matrix4f ctLookAtSide( Vector3d eye, Vector3d f, Vector3d s ){
+  return ctViewMatrix( eye, s, ctCross(s, f), f );
+}
+
+constexpr Matrix4f ctLookAtForward( Vector3d eye, Vector3d f, Vector3d up ){
+  return ctLookAtSide( eye, f, ctNormalize( ctCross(f, up) ) );
+}
+
+constexpr Matrix4f ctLookAt( double eyeX, double eyeY, double eyeZ,
+                             double centerX, double centerY, double centerZ,
+                             double upX, double upY, double upZ ){
+  return ctLookAtForward( ctVector3(eyeX, eyeY, eyeZ),
+    ctNormalize( ctVector3(centerX - eyeX, centerY - eyeY, centerZ - eyeZ) ),
+    ctVector3(upX, upY, upZ) );
+}
+
+/*
+ * ctFrustum( ) returns the matrix glFrustum( ) multiplies by.
+ * left, right: Specify the coordinates for the left and right vertical
+ *              clipping planes.
+ * bottom, top: Specify the coordinates for the bottom and top
+ *              horizontal clipping planes.
+ * zNear, zFar: Specify the distances to the near and far depth
+ *              clipping planes.  Both distances must be positive.
+ */
+constexpr Matrix4f ctFrustum( double left, double right, double bottom,
+                              double top, double zNear, double zFar ){
+  return Matrix4f{ {
+    float(2 * zNear / (right - left)), 0, 0, 0,
+    0, float(2 * zNear / (top - bottom)), 0, 0,
+    float((right + left) / (right - left)),
+    float((top + bottom) / (top - bottom)),
+    float((zFar + zNear) / (zNear - zFar)), -1,
+    0, 0, float(2 * zFar * zNear / (zNear - zFar)), 0 } };
+}
+
+/*
+ * ctPerspective( ) returns the matrix gluPerspective( ) multiplies by.
+ * fovy: Specifies the field of view angle, in degrees, in the y direction.
+ * aspect: Specifies the aspect ratio, x (width) to y (height).
+ * zNear, zFar: Specify the distances to the near and far clipping
+ *              planes (always positive).
+ */
+constexpr Matrix4f ctPerspectiveFocal( double f, double aspect,
+                                       double zNear, double zFar ){
+  return Matrix4f{ {
+    float(f / aspect), 0, 0, 0,
+    0, float(f), 0, 0,
+    0, 0, float((zFar + zNear) / (zNear - zFar)), -1,
+    0, 0, float(2 * zFar * zNear / (zNear - zFar)), 0 } };
+}
+
+constexpr Matrix4f ctPerspective( double fovy, double aspect,
+                                  double zNear, double zFar ){
+  return ctPerspectiveFocal( 1.0 / ctTan( ctRadians(fovy) / 2.0 ), aspect,
+                             zNear, zFar );
+}
+
+/*
+ * ctOrtho( ) returns the matrix glOrtho( ) multiplies by.
+ * left, right: Specify the coordinates for the left and right vertical
+ *              clipping planes.
+ * bottom, top: Specify the coordinates for the bottom and top horizontal
+ *              clipping planes.
+ * zNear, zFar: Specify the distances to the nearer and farther depth
+ *              clipping planes.
+ */
+constexpr Matrix4f ctOrtho( double left, double right, double bottom,
+                            double top, double zNear, double zFar ){
+  return Matrix4f{ {
+    float(2 / (right - left)), 0, 0, 0,
+    0, float(2 / (top - bottom)), 0, 0,
+    0, 0, float(-2 / (zFar - zNear)), 0,
+    float(-(right + left) / (right - left)),
+    float(-(top + bottom) / (top - bottom)),
+    float(-(zFar + zNear) / (zFar - zNear)), 1 } };
+}
+
+/*
+ * Compile-time checks. Each matrix is compared with the one OpenGL and
+ * GLU build for the same arguments, the values transformations_bench
+ * checks the run-time versions against, so a mistake in the builders
+ * or the trigonometry stops the build.
+ */
+constexpr bool ctNear( double a, double b ){
+  return (a - b < 0 ? b - a : a - b) <= 1.0e-5 * (b < -1 ? -b : b > 1 ? b : 1);
+}
+
+constexpr bool ctMatrixNear( const Matrix4f& a, const Matrix4f& b, int i ){
+  return i == 16 || (ctNear( a.m[i], b.m[i] ) && ctMatrixNear( a, b, i + 1 ));
+}
+
+constexpr bool ctMatrixNear( const Matrix4f& a, const Matrix4f& b ){
+  return ctMatrixNear( a, b, 0 );
+}
+
+static_assert( ctNear( ctSin( ctRadians(30.0) ), 0.5 ) &&
+               ctNear( ctCos( ctRadians(-420.0) ), 0.5 ) &&
+               ctNear( ctTan( ctRadians(45.0) ), 1.0 ) &&
+               ctNear( ctSqrt(2.0), 1.41421356 ),
+               "ctSin, ctCos, ctTan or ctSqrt is inaccurate" );
+
+// NaN is the only value that differs from itself.
+static_assert( ctSin(1.0e300) != ctSin(1.0e300) &&
+               ctCos(-1.0e17) != ctCos(-1.0e17) &&
+               ctNear( ctSin(1000.0), 0.826879540532 ),
+               "ctReduce mishandles huge angles" );
+
+// ctNear( ) is absolute below 1, so tiny roots are compared as ratios.
+static_assert( ctSqrt(4.0) == 2.0 && ctSqrt(0.25) == 0.5 &&
+               ctNear( ctSqrt(3.4e38) / 1.84390889e19, 1.0 ) &&
+               ctNear( ctSqrt(1.0e-38) / 1.0e-19, 1.0 ) &&
+               ctNear( ctSqrt(1.0e-6) / 1.0e-3, 1.0 ) &&
+               ctNear( ctSqrt(1.0e300) / 1.0e150, 1.0 ) &&
+               ctNear( ctSqrt(5.0e-324) / 2.22275875e-162, 1.0 ),
+               "ctSqrt is inaccurate away from 1" );
+
+static_assert( ctMatrixNear( ctTranslate(1.5, -2.0, 3.25),
+                 Matrix4f{ { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0,
+                             1.5, -2, 3.25, 1 } } ),
+               "ctTranslate differs from glTranslatef" );
+
+static_assert( ctMatrixNear( ctScale(2.0, 0.5, -3.0),
+                 Matrix4f{ { 2, 0, 0, 0, 0, 0.5, 0, 0, 0, 0, -3, 0,
+                             0, 0, 0, 1 } } ),
+               "ctScale differs from glScalef" );
+
+static_assert( ctMatrixNear( ctRotate(30.0, 1.0, 2.0, 3.0),
+                 Matrix4f{ { 0.875594974f, 0.420031071f, -0.238552392f, 0,
+                             -0.38175261f, 0.904303849f, 0.191048309f, 0,
+                             0.295970082f, -0.0762129277f, 0.952151895f, 0,
+                             0, 0, 0, 1 } } ) &&
+               ctMatrixNear( ctRotate(-75.0, 0.0, 0.0, 2.0),
+                 Matrix4f{ { 0.258819073f, -0.965925813f, 0, 0,
+                             0.965925813f, 0.258819073f, 0, 0,
+                             0, 0, 1, 0,
+                             0, 0, 0, 1 } } ),
+               "ctRotate differs from glRotatef" );
+
+static_assert( ctMatrixNear( ctLookAt(3.0, 4.0, -2.0, 0.5, -1.0, 1.0,
+                                      0.2, 1.0, 0.1),
+                 Matrix4f{ { -0.897067368f, -0.199976623f, 0.394055188f, 0,
+                             0.217859209f, 0.575690329f, 0.788110375f, 0,
+                             -0.384457409f, 0.792836666f, -0.472866237f, 0,
+                             1.05085051f, -0.117158175f, -5.28033972f, 1 } } ),
+               "ctLookAt differs from gluLookAt" );
+
+static_assert( ctMatrixNear( ctFrustum(-1.0, 2.0, -0.5, 1.5, 1.0, 25.0),
+                 Matrix4f{ { 0.666666687f, 0, 0, 0,
+                             0, 1, 0, 0,
+                             0.333333343f, 0.5, -1.08333337f, -1,
+                             0, 0, -2.08333325f, 0 } } ),
+               "ctFrustum differs from glFrustum" );
+
+static_assert( ctMatrixNear( ctPerspective(90.0, 4.0 / 3.0, 1.0, 25.0),
+                 Matrix4f{ { 0.75, 0, 0, 0,
+                             0, 1, 0, 0,
+                             0, 0, -1.08333337f, -1,
+                             0, 0, -2.08333325f, 0 } } ) &&
+               ctMatrixNear( ctPerspective(45.0, 1.0, 0.1, 100.0),
+                 Matrix4f{ { 2.41421366f, 0, 0, 0,
+                             0, 2.41421366f, 0, 0,
+                             0, 0, -1.002002f, -1,
+                             0, 0, -0.2002002f, 0 } } ),
+               "ctPerspective differs from gluPerspective" );
+
+static_assert( ctMatrixNear( ctOrtho(-7.0, 7.0, -7.0, 7.0, 1.0, 25.0),
+                 Matrix4f{ { 0.142857149f, 0, 0, 0,
+                             0, 0.142857149f, 0, 0,
+                             0, 0, -0.0833333358f, 0,
+                             0, 0, -1.08333337f, 1 } } ) &&
+               ctMatrixNear( ctOrtho(-1.0, 3.0, -2.0, 0.5, -4.0, 6.0),
+                 Matrix4f{ { 0.5, 0, 0, 0,
+                             0, 0.800000012f, 0, 0,
+                             0, 0, -0.200000003f, 0,
+                             -0.5, 0.600000024f, -0.200000003f, 1 } } ),
+               "ctOrtho differs from glOrtho" );
+
+static_assert( ctMatrixNear( ctMultiply( ctTranslate(1.0, 2.0, 3.0),
+                                         ctScale(2.0, 3.0, 4.0) ),
+                 Matrix4f{ { 2, 0, 0, 0, 0, 3, 0, 0, 0, 0, 4, 0,
+                             1, 2, 3, 1 } } ) &&
+               ctMatrixNear( ctMultiply( ctScale(2.0, 3.0, 4.0),
+                                         ctTranslate(1.0, 2.0, 3.0) ),
+                 Matrix4f{ { 2, 0, 0, 0, 0, 3, 0, 0, 0, 0, 4, 0,
+                             2, 6, 12, 1 } } ),
+               "ctMultiply multiplies in the wrong order" );
+
+#endif
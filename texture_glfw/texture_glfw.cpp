@@ -28,6 +28,9 @@
 #include "GLSLShader.h"
 #include "Texture.h"
 #include "transformations.h"
+#include "matrix_simd.h"
+#include "transformations_constexpr.h"
+#include "orbit_camera.h"
 #include "glut_teapot.h"
 
 /***
@@ -43,14 +46,16 @@ float teapotScale_A[3];
 float teapotTranslation_A[3];
 float teapotTranslation_B[3];
 
-float eyePosition[3];
-float upVector[3];
+OrbitCamera camera;
 
-// When true, use glLookAt. When false, use user defined lookAt.
-bool useGLLookAt;
 bool useGLPerspective;
 bool isPerspective;
 
+// The orthographic projection never changes, so it is built by the
+// compiler; the perspective one depends on the window's aspect ratio
+// and is built by myPerspective( ) in updateProjection( ).
+constexpr Matrix4f orthographicProjection = ctOrtho(-7.0, 7.0, -7.0, 7.0, 1.0, 25.0);
+
 GLSLProgram *shaderProgram_A;
 GLSLProgram *shaderProgram_B;
 
@@ -112,7 +117,6 @@ void printHelpMessage() {
   puts("Press 'a'/'d' to move the left teapot along it's positive/negative y-axis");
   puts("Press 'w'/'s' to move the left teapot along it's positive/negative x-axis");
   puts("Press 'v'/'b' to positively/negatively scale the right teapot");
-  puts("Press 'g' to toggle between using glLookAt( ) or your own Look At.");
   puts("Press 'o' to toggle between perspective projection and orthographic projection modes");
   puts("Press 'p' to toggle between OpenGL's gluPerspective( ) or glOrtho( ) and your own implementation");
   puts("Press '+' or '-' to increase/decrease the amount of rotation that occurs with each arrow press.");
@@ -136,16 +140,11 @@ void initFreeImage( ){
   FreeImage_SetOutputMessage(FreeImageErrorHandler);
 }
 
-void initEyePosition( ){
-  eyePosition[0] = 0.0;
-  eyePosition[1] = 0.0;
-  eyePosition[2] = 5.0;  
-}
-
-void initUpVector( ){
-  upVector[0] = 0.0;
-  upVector[1] = 1.0;
-  upVector[2] = 0.0;  
+void initCamera( ){
+  float eyePosition[] = {0.0, 0.0, 5.0};
+  float centerPosition[] = {0.0, 0.0, 0.0};
+  float upVector[] = {0.0, 1.0, 0.0};
+  camera.lookAt(eyePosition, centerPosition, upVector);
 }
 
 void initDeltas( ){
@@ -154,7 +153,6 @@ void initDeltas( ){
 }
 
 void initToggles( ){
-  useGLLookAt = true;
   useGLPerspective = true;
   isPerspective = true;
 }
@@ -212,8 +210,7 @@ void activateUniforms_B( ){
 }
 
 void init() {
-  initEyePosition( );
-  initUpVector( );
+  initCamera( );
   initDeltas( );
   initToggles( );
   initTeapotTransforms( );
@@ -256,20 +253,8 @@ void init() {
   initUniforms_B( );
 }
 
-void vecCopy4f(float *dest, float *src){
-  int i;
-  for(i = 0; i < 4; i++){
-    dest[i] = src[i];
-  }
-}
-
 void matMultVec4f(float* vout, float* v, float* m){
-  float c[4];
-  vecCopy4f(c, v);
-  vout[0] = m[0] * c[0] + m[4] * c[1] + m[8]  * c[2] + m[12] * c[3];
-  vout[1] = m[1] * c[0] + m[5] * c[1] + m[9]  * c[2] + m[13] * c[3];
-  vout[2] = m[2] * c[0] + m[6] * c[1] + m[10] * c[2] + m[14] * c[3];
-  vout[3] = m[3] * c[0] + m[7] * c[1] + m[11] * c[2] + m[15] * c[3];
+  mat4TransformVec4(vout, m, v);
 }
 
 void transformVecByModelView(float outVec[4], float inVec[4]){
@@ -302,7 +287,9 @@ void updateProjection(int width, int height){
     glPopMatrix( );
   }else if( !isPerspective && !useGLPerspective ){
     // orthographic and do not use OpenGL
-    myOrtho(projectionTransform, -7.0, 7.0, -7.0, 7.0, 1.0, 25.0);
+    for( int i = 0; i < 16; i++ ){
+      projectionTransform[i] = orthographicProjection.m[i];
+    }
   }
   glLoadMatrixf(projectionTransform);
 }
@@ -316,7 +303,6 @@ void reshapeCallback( GLFWwindow* window, int width, int height ){
 
 static void keyboardCallback(GLFWwindow* window, int key, int scancode,
 int action, int mods){
-  float centerPosition[] = {0.0, 0.0, 0.0};
   int w, h;
   if( action == GLFW_PRESS || action == GLFW_REPEAT ){
     switch( key ){
@@ -371,37 +357,27 @@ int action, int mods){
         rotationDelta -= 1.0;
         printf( "Rotation delta set to %g\n", rotationDelta );
         break;
-      case GLFW_KEY_G:
-        useGLLookAt = !useGLLookAt;
-        printf("Using OpenGL's gluLookAt? %s\n",
-               (useGLLookAt ? "Yes" : "No"));
-        break;
       case GLFW_KEY_H:
         printHelpMessage( );
         break;
       case GLFW_KEY_R:
-        initEyePosition( );
-        initUpVector( );
+        initCamera( );
         initDeltas( );
         initToggles( );
         initTeapotTransforms( );
         printf("Eye position, up vector and rotation delta reset.\n");
         break;
       case GLFW_KEY_LEFT:
-        rotateCameraLeft(-rotationDelta, eyePosition,
-                         centerPosition, upVector);
+        camera.rotateLeft(-rotationDelta);
         break;
       case GLFW_KEY_RIGHT:
-        rotateCameraLeft(rotationDelta, eyePosition,
-                         centerPosition, upVector);
+        camera.rotateLeft(rotationDelta);
         break;
       case GLFW_KEY_UP:
-        rotateCameraUp(-rotationDelta, eyePosition,
-                       centerPosition, upVector);
+        camera.rotateUp(-rotationDelta);
         break;
       case GLFW_KEY_DOWN:
-        rotateCameraUp(rotationDelta, eyePosition,
-                       centerPosition, upVector);
+        camera.rotateUp(rotationDelta);
         break;
       default:
         fprintf( stderr, "You pushed '%c' (%d).\n", key, key );
@@ -412,20 +388,14 @@ int action, int mods){
 
 
 void display( ){
-  const float centerPosition[] = {0.0, 0.0, 0.0};
-  
   float viewingTransform[16];
-  float modelingTransform[16];
+  Matrix4f modelingTransform;
 
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   glMatrixMode(GL_MODELVIEW);
 
-  myLookAt( viewingTransform,
-    eyePosition[0], eyePosition[1], eyePosition[2],
-    centerPosition[0], centerPosition[1], centerPosition[2],
-    upVector[0], upVector[1], upVector[2]
-  );
+  camera.viewMatrix( viewingTransform );
 
   // Set light & material properties for the teapot;
   // lights are transformed by current modelview matrix
@@ -442,14 +412,14 @@ void display( ){
   activateUniforms_A( );
   glLoadIdentity( );
   glMultMatrixf(viewingTransform);
-  myScalef(modelingTransform,
-           teapotScale_A[0], teapotScale_A[1], teapotScale_A[2]);
-  glMultMatrixf(modelingTransform);         
-  myTranslatef(modelingTransform,
-               teapotTranslation_A[0],
-               teapotTranslation_A[1],
-               teapotTranslation_A[2]);
-  glMultMatrixf(modelingTransform);
+  // The keys change the teapot transforms, so they are built each
+  // frame, but scale and translation go to GL as one matrix.
+  modelingTransform = ctMultiply(
+    ctScale(teapotScale_A[0], teapotScale_A[1], teapotScale_A[2]),
+    ctTranslate(teapotTranslation_A[0],
+                teapotTranslation_A[1],
+                teapotTranslation_A[2]));
+  glMultMatrixf(modelingTransform.m);
   _glutSolidTeapot(1.3);
 
   // The teapot on the left (pinkish)
@@ -458,11 +428,10 @@ void display( ){
   activateUniforms_B( );
   glLoadIdentity( );
   glMultMatrixf(viewingTransform);
-  myTranslatef(modelingTransform,
-               teapotTranslation_B[0],
-               teapotTranslation_B[1],
-               teapotTranslation_B[2]);
-  glMultMatrixf(modelingTransform);
+  modelingTransform = ctTranslate(teapotTranslation_B[0],
+                                  teapotTranslation_B[1],
+                                  teapotTranslation_B[2]);
+  glMultMatrixf(modelingTransform.m);
   _glutSolidTeapot(1.3);
 }
 
@@ -514,7 +483,11 @@ int main( int argc, char* argv[] ){
   
   puts("Press 'h' to see a help message at any time.");
   
+  double lastTime = glfwGetTime( );
   while( !glfwWindowShouldClose(gWindow) ){
+    double now = glfwGetTime( );
+    camera.update( now - lastTime );
+    lastTime = now;
 
     display( );
     
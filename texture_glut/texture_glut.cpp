@@ -34,6 +34,9 @@
 #include "GLSLShader.h"
 #include "Texture.h"
 #include "transformations.h"
+#include "matrix_simd.h"
+#include "transformations_constexpr.h"
+#include "orbit_camera.h"
 #include "glut_teapot.h"
 
 /***
@@ -48,14 +51,16 @@ float teapotScale_A[3];
 float teapotTranslation_A[3];
 float teapotTranslation_B[3];
 
-float eyePosition[3];
-float upVector[3];
+OrbitCamera camera;
 
-// When true, use glLookAt. When false, use user defined lookAt.
-bool useGLLookAt;
 bool useGLPerspective;
 bool isPerspective;
 
+// The orthographic projection never changes, so it is built by the
+// compiler; the perspective one depends on the window's aspect ratio
+// and is built by myPerspective( ) in updateProjection( ).
+constexpr Matrix4f orthographicProjection = ctOrtho(-7.0, 7.0, -7.0, 7.0, 1.0, 25.0);
+
 GLSLProgram *shaderProgram_A;
 GLSLProgram *shaderProgram_B;
 
@@ -113,7 +118,6 @@ void printHelpMessage() {
   puts("Press 'a'/'d' to move the left teapot along it's positive/negative y-axis");
   puts("Press 'w'/'s' to move the left teapot along it's positive/negative x-axis");
   puts("Press 'v'/'b' to positively/negatively scale the right teapot");
-  puts("Press 'g' to toggle between using glLookAt( ) or your own Look At.");
   puts("Press 'o' to toggle between perspective projection and orthographic projection modes");
   puts("Press 'p' to toggle between OpenGL's gluPerspective( ) or glOrtho( ) and your own implementation");
   puts("Press '+' or '-' to increase/decrease the amount of rotation that occurs with each arrow press.");
@@ -137,16 +141,11 @@ void initFreeImage( ){
   FreeImage_SetOutputMessage(FreeImageErrorHandler);
 }
 
-void initEyePosition( ){
-  eyePosition[0] = 0.0;
-  eyePosition[1] = 0.0;
-  eyePosition[2] = 5.0;  
-}
-
-void initUpVector( ){
-  upVector[0] = 0.0;
-  upVector[1] = 1.0;
-  upVector[2] = 0.0;  
+void initCamera( ){
+  float eyePosition[] = {0.0, 0.0, 5.0};
+  float centerPosition[] = {0.0, 0.0, 0.0};
+  float upVector[] = {0.0, 1.0, 0.0};
+  camera.lookAt(eyePosition, centerPosition, upVector);
 }
 
 void initDeltas( ){
@@ -155,7 +154,6 @@ void initDeltas( ){
 }
 
 void initToggles( ){
-  useGLLookAt = true;
   useGLPerspective = true;
   isPerspective = true;
 }
@@ -213,8 +211,7 @@ void activateUniforms_B( ){
 }
 
 void init() {
-  initEyePosition( );
-  initUpVector( );
+  initCamera( );
   initDeltas( );
   initToggles( );
   initTeapotTransforms( );
@@ -257,20 +254,8 @@ void init() {
   initUniforms_B( );
 }
 
-void vecCopy4f(float *dest, float *src){
-  int i;
-  for(i = 0; i < 4; i++){
-    dest[i] = src[i];
-  }
-}
-
 void matMultVec4f(float* vout, float* v, float* m){
-  float c[4];
-  vecCopy4f(c, v);
-  vout[0] = m[0] * c[0] + m[4] * c[1] + m[8]  * c[2] + m[12] * c[3];
-  vout[1] = m[1] * c[0] + m[5] * c[1] + m[9]  * c[2] + m[13] * c[3];
-  vout[2] = m[2] * c[0] + m[6] * c[1] + m[10] * c[2] + m[14] * c[3];
-  vout[3] = m[3] * c[0] + m[7] * c[1] + m[11] * c[2] + m[15] * c[3];
+  mat4TransformVec4(vout, m, v);
 }
 
 void transformVecByModelView(float outVec[4], float inVec[4]){
@@ -303,7 +288,9 @@ void updateProjection(int width, int height){
     glPopMatrix( );
   }else if( !isPerspective && !useGLPerspective ){
     // orthographic and do not use OpenGL
-    myOrtho(projectionTransform, -7.0, 7.0, -7.0, 7.0, 1.0, 25.0);
+    for( int i = 0; i < 16; i++ ){
+      projectionTransform[i] = orthographicProjection.m[i];
+    }
   }
   glLoadMatrixf(projectionTransform);
 }
@@ -375,17 +362,11 @@ void keyboardCallback( unsigned char key, int x, int y ){
       rotationDelta -= 1.0;
       printf( "Rotation delta set to %g\n", rotationDelta );
       break;
-    case 'g':
-      useGLLookAt = !useGLLookAt;
-      printf("Using OpenGL's gluLookAt? %s\n",
-             (useGLLookAt ? "Yes" : "No"));
-      break;
     case 'h':
       printHelpMessage( );
       break;
     case 'r':
-      initEyePosition( );
-      initUpVector( );
+      initCamera( );
       initDeltas( );
       initToggles( );
       initTeapotTransforms( );
@@ -399,43 +380,32 @@ void keyboardCallback( unsigned char key, int x, int y ){
 }
 
 void specialCallback( int key,int x,int y ){
-  float centerPosition[] = {0.0, 0.0, 0.0};
   switch( key ){
     case GLUT_KEY_LEFT:
-      rotateCameraLeft(rotationDelta, eyePosition,
-                       centerPosition, upVector);
+      camera.rotateLeft(rotationDelta);
       break;
     case GLUT_KEY_RIGHT:
-      rotateCameraLeft(-rotationDelta, eyePosition,
-                       centerPosition, upVector);
+      camera.rotateLeft(-rotationDelta);
       break;
     case GLUT_KEY_UP:
-      rotateCameraUp(rotationDelta, eyePosition,
-                     centerPosition, upVector);
+      camera.rotateUp(rotationDelta);
       break;
     case GLUT_KEY_DOWN:
-      rotateCameraUp(-rotationDelta, eyePosition,
-                     centerPosition, upVector);
+      camera.rotateUp(-rotationDelta);
       break;
   }
   glutPostRedisplay( );
 }
 
 void displayCallback( ){
-  const float centerPosition[] = {0.0, 0.0, 0.0};
-  
   float viewingTransform[16];
-  float modelingTransform[16];
+  Matrix4f modelingTransform;
 
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   glMatrixMode(GL_MODELVIEW);
 
-  myLookAt( viewingTransform,
-    eyePosition[0], eyePosition[1], eyePosition[2],
-    centerPosition[0], centerPosition[1], centerPosition[2],
-    upVector[0], upVector[1], upVector[2]
-  );
+  camera.viewMatrix( viewingTransform );
 
   // Set light & material properties for the teapot;
   // lights are transformed by current modelview matrix
@@ -452,14 +422,14 @@ void displayCallback( ){
   activateUniforms_A( );
   glLoadIdentity( );
   glMultMatrixf(viewingTransform);
-  myScalef(modelingTransform,
-           teapotScale_A[0], teapotScale_A[1], teapotScale_A[2]);
-  glMultMatrixf(modelingTransform);         
-  myTranslatef(modelingTransform,
-               teapotTranslation_A[0],
-               teapotTranslation_A[1],
-               teapotTranslation_A[2]);
-  glMultMatrixf(modelingTransform);
+  // The keys change the teapot transforms, so they are built each
+  // frame, but scale and translation go to GL as one matrix.
+  modelingTransform = ctMultiply(
+    ctScale(teapotScale_A[0], teapotScale_A[1], teapotScale_A[2]),
+    ctTranslate(teapotTranslation_A[0],
+                teapotTranslation_A[1],
+                teapotTranslation_A[2]));
+  glMultMatrixf(modelingTransform.m);
   _glutSolidTeapot(1.3);
 
   // The teapot on the left (pinkish)
@@ -468,17 +438,20 @@ void displayCallback( ){
   activateUniforms_B( );
   glLoadIdentity( );
   glMultMatrixf(viewingTransform);
-  myTranslatef(modelingTransform,
-               teapotTranslation_B[0],
-               teapotTranslation_B[1],
-               teapotTranslation_B[2]);
-  glMultMatrixf(modelingTransform);
+  modelingTransform = ctTranslate(teapotTranslation_B[0],
+                                  teapotTranslation_B[1],
+                                  teapotTranslation_B[2]);
+  glMultMatrixf(modelingTransform.m);
   _glutSolidTeapot(1.3);
 
   glutSwapBuffers();
 }
 
 void updateCallback( int x ){
+  static int lastTime = glutGet(GLUT_ELAPSED_TIME);
+  int now = glutGet(GLUT_ELAPSED_TIME);
+  camera.update( (now - lastTime) / 1000.0 );
+  lastTime = now;
   glutPostRedisplay( );
   glutTimerFunc( 16, updateCallback, 0 );
 }
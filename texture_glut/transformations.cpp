@@ -42,149 +42,144 @@
 #endif
 
 
-#ifndef __SOLUTION__
+#ifdef __SOLUTION__
+#include "transformations_solution.cpp"
+#endif
 
-void rotateCameraLeft(float degrees, float *eyePosition, float *centerPosition, float *upVector){
-  // Please implement this function.
-}
 
-void rotateCameraUp(float degrees, float *eyePosition, float *centerPosition, float *upVector){
-  // Please implement this function.
+// All of the matrices below are computed on the CPU and stored in
+// column major order, the order glLoadMatrixf( ) expects. None of them
+// touches the GL state, so they need no current context and cost no
+// pipeline round trip. transformations_constexpr.h builds the same
+// matrices for constant arguments at compile time; these are the ones
+// to call with values known only at run time.
+
+static void zeroMatrix(GLfloat *m){
+  for(int i = 0; i < 16; i++){
+    m[i] = 0.0;
+  }
 }
-#else
-#include "transformations_solution.cpp"
-#endif
 
+static void identityMatrix(GLfloat *m){
+  zeroMatrix( m );
+  m[0] = m[5] = m[10] = m[15] = 1.0;
+}
 
 void myTranslatef( GLfloat *matrix, GLfloat x, GLfloat y, GLfloat z ){
-  // Please implement this function.
-  
-  // This code is just a placeholder to demonstrate how this procedure
-  // returns the LookAt matrix by reference.
-  // YOU MUST REMOVE THE CODE BELOW AND WRITE YOUR OWN ROUTINE.
-  int mode;
-  glGetIntegerv(GL_MATRIX_MODE, &mode);
-  glPushMatrix( );
-  glLoadIdentity( );
-  glTranslatef(x, y, z);
-  glGetFloatv(mode == GL_MODELVIEW ?
-              GL_MODELVIEW_MATRIX : GL_PROJECTION_MATRIX,
-              matrix);
-  glPopMatrix( ); 
+  identityMatrix( matrix );
+  matrix[12] = x;
+  matrix[13] = y;
+  matrix[14] = z;
 }
 
 void myScalef( GLfloat *matrix, GLfloat x, GLfloat y, GLfloat z ){
-  // Please implement this function.
-
-  // This code is just a placeholder to demonstrate how this procedure
-  // returns the LookAt matrix by reference.
-  // YOU MUST REMOVE THE CODE BELOW AND WRITE YOUR OWN ROUTINE.
-  int mode;
-  glGetIntegerv(GL_MATRIX_MODE, &mode);
-  glPushMatrix( );
-  glLoadIdentity( );
-  glScalef(x, y, z);
-  glGetFloatv(mode == GL_MODELVIEW ?
-              GL_MODELVIEW_MATRIX : GL_PROJECTION_MATRIX,
-              matrix);
-  glPopMatrix( );
+  zeroMatrix( matrix );
+  matrix[0] = x;
+  matrix[5] = y;
+  matrix[10] = z;
+  matrix[15] = 1.0;
 }
 
 void myRotatef( GLfloat *matrix,
                 GLfloat angle, GLfloat x, GLfloat y, GLfloat z ){
-  // Remember the Rodrigues' rotation formula?
-
-  // This code is just a placeholder to demonstrate how this procedure
-  // returns the LookAt matrix by reference.
-  // YOU MUST REMOVE THE CODE BELOW AND WRITE YOUR OWN ROUTINE.
-  int mode;
-  glGetIntegerv(GL_MATRIX_MODE, &mode);
-  glPushMatrix( );
-  glLoadIdentity( );
-  glRotatef(angle, x, y, z);
-  glGetFloatv(mode == GL_MODELVIEW ?
-              GL_MODELVIEW_MATRIX : GL_PROJECTION_MATRIX,
-              matrix);
-  glPopMatrix( );
+  // Rodrigues' rotation formula about the unit vector (x, y, z), as
+  // given on the glRotate( ) manual page.
+  identityMatrix( matrix );
+  double length = sqrt( SQR(double(x)) + SQR(double(y)) + SQR(double(z)) );
+  if( length == 0.0 ){
+    // Like glRotatef( ), a zero axis leaves the identity.
+    return;
+  }
+  double ux = x / length;
+  double uy = y / length;
+  double uz = z / length;
+  double radians = DEG2RAD(double(angle));
+  double c = cos(radians);
+  double s = sin(radians);
+  double t = 1.0 - c;
+  matrix[0] = ux * ux * t + c;
+  matrix[1] = uy * ux * t + uz * s;
+  matrix[2] = ux * uz * t - uy * s;
+  matrix[4] = ux * uy * t - uz * s;
+  matrix[5] = uy * uy * t + c;
+  matrix[6] = uy * uz * t + ux * s;
+  matrix[8] = ux * uz * t + uy * s;
+  matrix[9] = uy * uz * t - ux * s;
+  matrix[10] = uz * uz * t + c;
 }
 
 void myLookAt( GLfloat *matrix,
                GLdouble eyeX, GLdouble eyeY, GLdouble eyeZ,
                GLdouble centerX, GLdouble centerY, GLdouble centerZ,
                GLdouble upX, GLdouble upY, GLdouble upZ ){
-  // Please implement this function.
-
-  // This code is just a placeholder to demonstrate how this procedure
-  // returns the LookAt matrix by reference.
-  // YOU MUST REMOVE THE CODE BELOW AND WRITE YOUR OWN ROUTINE.
-  int mode;
-  glGetIntegerv(GL_MATRIX_MODE, &mode);
-  glPushMatrix( );
-  glLoadIdentity( );
-  gluLookAt(
-    eyeX, eyeY, eyeZ,
-    centerX, centerY, centerZ,
-    upX, upY, upZ
-  );
-  glGetFloatv(mode == GL_MODELVIEW ?
-              GL_MODELVIEW_MATRIX : GL_PROJECTION_MATRIX,
-              matrix);
-  glPopMatrix( );
+  // f points from the eye to the center, s to the right and u up; the
+  // rows of the rotation are s, u and -f, as in gluLookAt( ).
+  double f[3] = { centerX - eyeX, centerY - eyeY, centerZ - eyeZ };
+  double fLength = sqrt( SQR(f[0]) + SQR(f[1]) + SQR(f[2]) );
+  for( int i = 0; i < 3; i++ ){
+    f[i] /= fLength;
+  }
+  double s[3] = {
+    f[1] * upZ - f[2] * upY,
+    f[2] * upX - f[0] * upZ,
+    f[0] * upY - f[1] * upX
+  };
+  double sLength = sqrt( SQR(s[0]) + SQR(s[1]) + SQR(s[2]) );
+  for( int i = 0; i < 3; i++ ){
+    s[i] /= sLength;
+  }
+  double u[3] = {
+    s[1] * f[2] - s[2] * f[1],
+    s[2] * f[0] - s[0] * f[2],
+    s[0] * f[1] - s[1] * f[0]
+  };
+  identityMatrix( matrix );
+  for( int i = 0; i < 3; i++ ){
+    matrix[4 * i] = s[i];
+    matrix[4 * i + 1] = u[i];
+    matrix[4 * i + 2] = -f[i];
+  }
+  // Followed by a translation by -eye.
+  matrix[12] = -(s[0] * eyeX + s[1] * eyeY + s[2] * eyeZ);
+  matrix[13] = -(u[0] * eyeX + u[1] * eyeY + u[2] * eyeZ);
+  matrix[14] = f[0] * eyeX + f[1] * eyeY + f[2] * eyeZ;
 }
 
 void myFrustum( GLfloat *matrix,
                 GLdouble left, GLdouble right, GLdouble bottom,
                 GLdouble top, GLdouble zNear, GLdouble zFar ){
-  // Please implement this function.
-
-  // This code is just a placeholder to demonstrate how this procedure
-  // returns the LookAt matrix by reference.
-  // YOU MUST REMOVE THE CODE BELOW AND WRITE YOUR OWN ROUTINE.
-  int mode;
-  glGetIntegerv(GL_MATRIX_MODE, &mode);
-  glPushMatrix( );
-  glLoadIdentity( );
-  glFrustum(left, right, bottom, top, zNear, zFar);
-  glGetFloatv(mode == GL_MODELVIEW ?
-              GL_MODELVIEW_MATRIX : GL_PROJECTION_MATRIX,
-              matrix);
-  glPopMatrix( );
-}
-
-void zeroMatrix(GLfloat *m){
-  for(int i = 0; i < 16; i++){
-    m[i] = 0.0;
-  }
+  zeroMatrix( matrix );
+  matrix[0] = 2.0 * zNear / (right - left);
+  matrix[5] = 2.0 * zNear / (top - bottom);
+  matrix[8] = (right + left) / (right - left);
+  matrix[9] = (top + bottom) / (top - bottom);
+  matrix[10] = -(zFar + zNear) / (zFar - zNear);
+  matrix[11] = -1.0;
+  matrix[14] = -2.0 * zFar * zNear / (zFar - zNear);
 }
 
 void myPerspective( GLfloat *matrix,
                     GLdouble fovy, GLdouble aspect,
                     GLdouble zNear, GLdouble zFar ){
-  float radians = DEG2RAD(fovy);
-  float f = cos(radians) / sin(radians);
+  // f is the cotangent of half the field of view.
+  double radians = DEG2RAD(fovy / 2.0);
+  double f = cos(radians) / sin(radians);
   zeroMatrix( matrix );
   matrix[0] = f / aspect;
   matrix[5] = f;
-  matrix[10] = zFar + zNear  / zNear - zFar;
+  matrix[10] = (zFar + zNear) / (zNear - zFar);
   matrix[11] = -1.0;
-  matrix[14] = 2 * zFar * zNear / zNear - zFar;
+  matrix[14] = 2.0 * zFar * zNear / (zNear - zFar);
 }
 
 void myOrtho( GLfloat *matrix,
               GLdouble left, GLdouble right, GLdouble bottom,
               GLdouble top, GLdouble zNear, GLdouble zFar ){
-  // Please implement this function.
-
-  // This code is just a placeholder to demonstrate how this procedure
-  // returns the LookAt matrix by reference.
-  // YOU MUST REMOVE THE CODE BELOW AND WRITE YOUR OWN ROUTINE.
-  int mode;
-  glGetIntegerv(GL_MATRIX_MODE, &mode);
-  glPushMatrix( );
-  glLoadIdentity( );
-  glOrtho(left, right, bottom, top, zNear, zFar);
-  glGetFloatv(mode == GL_MODELVIEW ?
-              GL_MODELVIEW_MATRIX : GL_PROJECTION_MATRIX,
-              matrix);
-  glPopMatrix( );
+  identityMatrix( matrix );
+  matrix[0] = 2.0 / (right - left);
+  matrix[5] = 2.0 / (top - bottom);
+  matrix[10] = -2.0 / (zFar - zNear);
+  matrix[12] = -(right + left) / (right - left);
+  matrix[13] = -(top + bottom) / (top - bottom);
+  matrix[14] = -(zFar + zNear) / (zFar - zNear);
 }
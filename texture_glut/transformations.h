@@ -13,8 +13,11 @@
 #ifndef _TRANSFORMATIONS_H_
 #define _TRANSFORMATIONS_H_
 
-// This is for testing, just ignore it.
+// This is for testing, just ignore it. Building with -DNO_SOLUTION
+// compiles the stubs below instead, as transformations_bench does.
+#ifndef NO_SOLUTION
 #define __SOLUTION__
+#endif
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -38,28 +41,6 @@
 
 #include <cmath>
 
-/*
- * rotateCameraLeft( ) rotates the coordinate system defined by
- * the eyePosition and upVector by degrees around the upVector.
- * eyePosition and upVector are passed and returned by reference.
- * degrees: The number of degrees to rotate by.
- * eyePosition: Specifies the position of the eye point.
- * centerPosition: Specifies the position of the reference point.
- * upVector: Specifies the direction of the up vector.
- */
-void rotateCameraLeft(float degrees, float *eyePosition, float *centerPosition, float *upVector);
-
-/*
- * rotateCameraUp( ) rotates the coordinate system defined by
- * the eyePosition and upVector by degrees around the right vector.
- * eyePosition and upVector are passed and returned by reference.
- * degrees: The number of degrees to rotate by.
- * eyePosition: Specifies the position of the eye point.
- * centerPosition: Specifies the position of the reference point.
- * upVector: Specifies the direction of the up vector.
- */
-void rotateCameraUp(float degrees, float *eyePosition, float *centerPosition, float *upVector);
-
 /*
  * myTranslatef( ) is similar to glTranslate( ) except that the resulting
  * matrix is returned.